@@ -16,6 +16,13 @@
 #define POWER_LOGIC_VOLTAGE     3.3  /* 3.3V logic level */
 #define LDO_ENABLE_DELAY_MS     10   /* LDO startup delay */
 
+/* ===== GPIO CONFIGURATION ===== */
+#define GPIO_CHIP_PATH    "/dev/gpiochip0"  /* H618 main PIO (banks PC..PI) */
+#define GPIO_CONSUMER     "loki"    /* Label shown by gpioinfo for held lines */
+#define GPIO_MEM_PATH     "/dev/gpiomem"    /* PIO block only; /dev/mem is the fallback */
+#define GPIO_PIO_BASE     0x0300B000    /* H618 PIO physical address */
+#define GPIO_MMIO_DEFAULT 0     /* 1: gpio_init() tries the mapped-register backend */
+
 /* ===== TFT DISPLAY CONFIGURATION ===== */
 #define TFT_WIDTH         480   /* Pixels */
 #define TFT_HEIGHT        320   /* Pixels */
@@ -44,14 +51,29 @@
 #define EEPROM_PAGE_SIZE  8     /* Bytes */
 #define EEPROM_I2C_ADDR   0x50  /* I2C 7-bit address */
 #define EEPROM_I2C_FREQ   100000    /* 100 kHz standard mode */
+#define EEPROM_RECORD_BASE 0x80     /* Settings record from here to the end; raw writes stay below */
 
 /* ===== UART FLIPPER CONFIGURATION ===== */
+#define UART1_DEVICE_PATH "/dev/ttyS1"
 #define UART1_BAUD_RATE  115200   /* Standard Flipper UART rate */
 #define UART1_DATA_BITS  8
 #define UART1_STOP_BITS  1
 #define UART1_PARITY     UART_PARITY_NONE
-#define UART1_RX_BUFFER_SIZE  256
+#define UART1_RX_BUFFER_SIZE  16384   /* Power of two; ~1.4 s at 115200 baud */
 #define UART1_TX_BUFFER_SIZE  256
+#define FLIPPER_HELLO_TIMEOUT_MS  200   /* Wait for the HELLO reply before assuming a v1 peer */
+#define FLIPPER_BAUD_MAX          921600   /* Highest rate offered in HELLO (8x UART1_BAUD_RATE) */
+#define FLIPPER_BAUD_SETTLE_MS        10   /* Quiet time after both sides switch rate */
+#define FLIPPER_BAUD_FALLBACK_MS     250   /* Peer reverts an uncommitted rate change after this */
+#define FLIPPER_LINK_TEST_ROUNDS       4   /* Echoed test frames required at a new rate */
+#define FLIPPER_LINK_TEST_TIMEOUT_MS  50   /* Per-echo wait during the link test */
+#define FLIPPER_LINK_ERROR_LIMIT       8   /* Frame errors per window before stepping the rate down */
+#define FLIPPER_LINK_ERROR_WINDOW    256   /* Valid frames after which the error count restarts */
+#define FLIPPER_BULK_WINDOW          8     /* Default frames in flight for bulk transfers */
+#define FLIPPER_BULK_ACK_TIMEOUT_MS  100   /* Resend the oldest frame after this much silence */
+#define FLIPPER_BULK_MAX_RETRIES     5     /* Consecutive timeouts before giving up */
+#define FLIPPER_COMPRESS_MIN_LENGTH  512   /* Smaller bulk transfers are sent uncompressed */
+#define FLIPPER_TX_FLUSH_MS          2     /* Longest a queued message waits for batching */
 
 /* ===== DECOUPLING CAPACITOR VALUES ===== */
 #define DECAP_BULK_UF     10    /* 10 µF bulk capacitors */
@@ -64,9 +86,25 @@
 #define ENABLE_ERROR_LOGGING  1
 #define ERROR_LOG_BUFFER_SIZE 256
 
+/* ===== LOGGING ===== */
+#define LOG_RING_SLOTS    256   /* Messages queued for the writer thread (power of two) */
+#define LOG_LINE_MAX      256   /* Longest message text; longer ones are truncated */
+#define LOG_MAX_SITES     2048  /* LOG_* call sites binary mode can register (multiple of 8) */
+#define LOG_RATE_BURST    20    /* Messages a call site may emit back to back */
+#define LOG_RATE_PER_SEC  10    /* Sustained messages/s per call site (0 = unlimited, max 1000) */
+#define LOG_REPEAT_REPORT_MS 2000   /* "last message repeated N times" at least this often */
+#define LOG_FILE_MAX_BYTES (1024u * 1024u)  /* Rotate the file sink at this size */
+#define LOG_FILE_KEEP     3     /* Rotated files kept (loki.log.1 .. .3) */
+
+/* ===== MEMORY ===== */
+#define MEMORY_TRACK_MAX  256   /* Live allocations tracked in DEBUG builds */
+#define MEMORY_ARENA_ALIGN 16   /* Default arena alignment (max_align_t on aarch64) */
+#define MEMORY_THREAD_ARENA_SIZE (64u * 1024u)  /* Per-thread scratch arena */
+
 /* ===== TIMING CONSTANTS (ms) ===== */
 #define INIT_DELAY_TFT    100   /* TFT initialization delay */
 #define INIT_DELAY_FLASH  10    /* Flash initialization delay */
 #define INIT_DELAY_EEPROM 5     /* EEPROM initialization delay */
+#define EEPROM_WRITE_TIMEOUT_MS 10  /* Give up ACK polling after this (tWR max is 5) */
 
 #endif /* BOARD_CONFIG_H */
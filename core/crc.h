@@ -0,0 +1,42 @@
+#ifndef CRC_H
+#define CRC_H
+
+/**
+ * CRC routines shared by the storage and link layers
+ */
+
+#include <stdint.h>
+
+/* ===== CRC-16/CCITT-FALSE (poly 0x1021, MSB first) ===== */
+
+#define CRC16_CCITT_INIT    0xFFFF
+
+/**
+ * Update a CRC-16/CCITT over a buffer
+ * @param[in] crc Running value (CRC16_CCITT_INIT to start)
+ * @param[in] data Data buffer
+ * @param[in] length Number of bytes
+ * @return Updated CRC
+ */
+uint16_t crc16_ccitt(uint16_t crc, const uint8_t *data, uint32_t length);
+
+/* ===== CRC-32 (IEEE 802.3, poly 0x04C11DB7 reflected) ===== */
+
+#define CRC32_INIT          0x00000000
+
+/**
+ * Update a CRC-32 over a buffer
+ *
+ * zlib-compatible: start from CRC32_INIT and pass the previous result to
+ * continue. Uses the ARMv8 CRC32 instructions when the compiler targets
+ * them (__ARM_FEATURE_CRC32), slicing-by-8 tables otherwise. Named apart
+ * from zlib's crc32() so both can be linked into one program.
+ *
+ * @param[in] crc Running value (CRC32_INIT to start)
+ * @param[in] data Data buffer
+ * @param[in] length Number of bytes
+ * @return Updated CRC
+ */
+uint32_t crc32_ieee(uint32_t crc, const uint8_t *data, uint32_t length);
+
+#endif /* CRC_H */
@@ -4,20 +4,135 @@
  */
 
 #include "eeprom_driver.h"
+#include "eeprom_record.h"
 #include "i2c.h"
 #include "pinout.h"
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+#define EEPROM_PAGE_COUNT   (EEPROM_CAPACITY / EEPROM_PAGE_SIZE)
+#define EEPROM_ACK_POLL_US  100     /* Back-off between address probes */
+
 /* ===== EEPROM STATE ===== */
 typedef struct {
     uint8_t initialized;
+    uint32_t dirty_pages;               /* One bit per page touched since last flush */
+    uint8_t shadow[EEPROM_CAPACITY];    /* Contents as seen by readers/writers */
+    uint8_t device[EEPROM_CAPACITY];    /* Contents last committed to the chip */
+    eeprom_write_stats_t stats;
 } eeprom_context_t;
 
 static eeprom_context_t eeprom_ctx = {
     .initialized = 0,
+    .dirty_pages = 0,
 };
 
+/* ===== LOCAL HELPER FUNCTIONS ===== */
+
+static uint64_t eeprom_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static void eeprom_record_cycle(uint32_t elapsed_us)
+{
+    eeprom_write_stats_t *stats = &eeprom_ctx.stats;
+
+    if (stats->count == 0 || elapsed_us < stats->min_us) {
+        stats->min_us = elapsed_us;
+    }
+    if (elapsed_us > stats->max_us) {
+        stats->max_us = elapsed_us;
+    }
+    stats->count++;
+    stats->total_us += elapsed_us;
+
+    uint32_t bucket = elapsed_us / EEPROM_WCYCLE_HIST_WIDTH_US;
+    if (bucket >= EEPROM_WCYCLE_HIST_BUCKETS) {
+        bucket = EEPROM_WCYCLE_HIST_BUCKETS - 1;
+    }
+    stats->histogram[bucket]++;
+}
+
+/**
+ * Wait for the internal write cycle to finish
+ *
+ * The FT24C02A does not ACK its address while programming, so the device
+ * is polled instead of sleeping for the worst-case tWR.
+ */
+static hal_status_t eeprom_wait_write_cycle(void)
+{
+    uint64_t start = eeprom_now_us();
+
+    for (;;) {
+        hal_status_t status = i2c_probe(I2C_BUS_0, EEPROM_ADDR);
+        uint32_t elapsed_us = (uint32_t)(eeprom_now_us() - start);
+
+        if (status == HAL_OK) {
+            eeprom_record_cycle(elapsed_us);
+            return HAL_OK;
+        }
+        if (status != HAL_BUSY) {
+            return status;  /* Bus error, not a busy device */
+        }
+        if (elapsed_us >= EEPROM_WRITE_TIMEOUT_MS * 1000u) {
+            eeprom_ctx.stats.timeouts++;
+            return HAL_TIMEOUT;
+        }
+
+        usleep(EEPROM_ACK_POLL_US);
+    }
+}
+
+/**
+ * Commit the changed span of one page to the device
+ */
+static hal_status_t eeprom_flush_page(uint8_t page)
+{
+    uint16_t base = (uint16_t)page * EEPROM_PAGE_SIZE;
+    const uint8_t *want = &eeprom_ctx.shadow[base];
+    const uint8_t *have = &eeprom_ctx.device[base];
+
+    /* Only bytes that actually differ are sent; an unchanged page costs nothing */
+    int8_t first = -1;
+    int8_t last = -1;
+    for (uint8_t i = 0; i < EEPROM_PAGE_SIZE; i++) {
+        if (want[i] != have[i]) {
+            if (first < 0) {
+                first = i;
+            }
+            last = i;
+        }
+    }
+
+    if (first < 0) {
+        return HAL_OK;
+    }
+
+    /* Prepare write packet: [address, data...] */
+    uint8_t chunk_size = (uint8_t)(last - first + 1);
+    uint8_t write_packet[1 + EEPROM_PAGE_SIZE];
+    write_packet[0] = (uint8_t)(base + first);
+    memcpy(&write_packet[1], &want[first], chunk_size);
+
+    hal_status_t status = i2c_write(I2C_BUS_0, EEPROM_ADDR,
+                                    write_packet, 1 + chunk_size);
+    if (status != HAL_OK) {
+        return status;
+    }
+
+    status = eeprom_wait_write_cycle();
+    if (status != HAL_OK) {
+        return status;
+    }
+
+    memcpy(&eeprom_ctx.device[base + first], &want[first], chunk_size);
+    return HAL_OK;
+}
+
 /* ===== PUBLIC IMPLEMENTATION ===== */
 
 hal_status_t eeprom_init(void)
@@ -36,7 +151,20 @@ hal_status_t eeprom_init(void)
         return HAL_ERROR;
     }
 
+    /* Load the whole device into the shadow in a single sequential read */
+    uint8_t addr[1] = {0x00};
+    hal_status_t status = i2c_write_read(I2C_BUS_0, EEPROM_ADDR,
+                                         addr, 1,
+                                         eeprom_ctx.shadow, EEPROM_CAPACITY);
+    if (status != HAL_OK) {
+        i2c_deinit(I2C_BUS_0);
+        return status;
+    }
+
+    memcpy(eeprom_ctx.device, eeprom_ctx.shadow, EEPROM_CAPACITY);
+    eeprom_ctx.dirty_pages = 0;
     eeprom_ctx.initialized = 1;
+    eeprom_record_reset();
     return HAL_OK;
 }
 
@@ -54,12 +182,29 @@ hal_status_t eeprom_read(uint8_t address, uint8_t *buffer, uint16_t length)
         return HAL_NOT_READY;
     }
 
-    /* Send address byte, then read data */
-    uint8_t addr[1] = {address};
-    
-    return i2c_write_read(I2C_BUS_0, EEPROM_ADDR,
-                         addr, 1,
-                         buffer, length);
+    /* Served from the shadow, including writes not yet flushed */
+    memcpy(buffer, &eeprom_ctx.shadow[address], length);
+    return HAL_OK;
+}
+
+/**
+ * Update the shadow; pages are only marked when a byte really changes
+ */
+static hal_status_t eeprom_write_shadow(uint8_t address, const uint8_t *buffer, uint16_t length)
+{
+    if (!eeprom_ctx.initialized) {
+        return HAL_NOT_READY;
+    }
+
+    for (uint16_t i = 0; i < length; i++) {
+        uint16_t offset = address + i;
+        if (eeprom_ctx.shadow[offset] != buffer[i]) {
+            eeprom_ctx.shadow[offset] = buffer[i];
+            eeprom_ctx.dirty_pages |= (uint32_t)1 << (offset / EEPROM_PAGE_SIZE);
+        }
+    }
+
+    return HAL_OK;
 }
 
 hal_status_t eeprom_write(uint8_t address, const uint8_t *buffer, uint16_t length)
@@ -68,58 +213,76 @@ hal_status_t eeprom_write(uint8_t address, const uint8_t *buffer, uint16_t lengt
         return HAL_INVALID_PARAM;
     }
 
-    if (address + length > EEPROM_CAPACITY) {
+    /* The record area is eeprom_record.c's: a raw write there could tear the committed slot */
+    if (address + length > EEPROM_RECORD_BASE) {
+        return HAL_INVALID_PARAM;
+    }
+
+    return eeprom_write_shadow(address, buffer, length);
+}
+
+hal_status_t eeprom_write_record_area(uint8_t address, const uint8_t *buffer, uint16_t length)
+{
+    if (buffer == NULL || length == 0) {
+        return HAL_INVALID_PARAM;
+    }
+
+    if (address < EEPROM_RECORD_BASE || address + length > EEPROM_CAPACITY) {
         return HAL_INVALID_PARAM;
     }
 
+    return eeprom_write_shadow(address, buffer, length);
+}
+
+hal_status_t eeprom_flush(void)
+{
     if (!eeprom_ctx.initialized) {
         return HAL_NOT_READY;
     }
 
-    /* FT24C02A page size is 8 bytes */
-    /* Must write in page-aligned chunks */
-    
-    uint16_t bytes_written = 0;
-    while (bytes_written < length) {
-        uint16_t chunk_size = EEPROM_PAGE_SIZE;
-        if (bytes_written + chunk_size > length) {
-            chunk_size = length - bytes_written;
+    /* FT24C02A page size is 8 bytes; each dirty page is one write cycle */
+    for (uint8_t page = 0; page < EEPROM_PAGE_COUNT; page++) {
+        uint32_t mask = (uint32_t)1 << page;
+        if (!(eeprom_ctx.dirty_pages & mask)) {
+            continue;
         }
 
-        /* Check page boundary */
-        if ((address + bytes_written) % EEPROM_PAGE_SIZE != 0) {
-            /* Adjust for page boundary */
-            chunk_size = EEPROM_PAGE_SIZE - ((address + bytes_written) % EEPROM_PAGE_SIZE);
-        }
-
-        /* Prepare write packet: [address, data...] */
-        uint8_t write_packet[1 + 8];
-        write_packet[0] = address + bytes_written;
-        memcpy(&write_packet[1], &buffer[bytes_written], chunk_size);
-
-        /* Send address + data */
-        hal_status_t status = i2c_write(I2C_BUS_0, EEPROM_ADDR, 
-                                       write_packet, 1 + chunk_size);
+        hal_status_t status = eeprom_flush_page(page);
         if (status != HAL_OK) {
-            return status;
+            return status;  /* Page stays dirty for the next flush */
         }
 
-        /* Wait for EEPROM write cycle (~5ms) */
-        usleep(5000);
+        eeprom_ctx.dirty_pages &= ~mask;
+    }
+
+    return HAL_OK;
+}
 
-        bytes_written += chunk_size;
+hal_status_t eeprom_get_write_stats(eeprom_write_stats_t *stats)
+{
+    if (stats == NULL) {
+        return HAL_INVALID_PARAM;
     }
 
+    *stats = eeprom_ctx.stats;
     return HAL_OK;
 }
 
+uint8_t eeprom_is_dirty(void)
+{
+    return eeprom_ctx.dirty_pages != 0;
+}
+
 hal_status_t eeprom_deinit(void)
 {
     if (!eeprom_ctx.initialized) {
         return HAL_OK;
     }
 
+    hal_status_t status = eeprom_flush();
+
     i2c_deinit(I2C_BUS_0);
     eeprom_ctx.initialized = 0;
-    return HAL_OK;
+    eeprom_record_reset();
+    return status;
 }
@@ -5,14 +5,70 @@
 #include "hal.h"
 #include "board_config.h"
 
+/* ===== WRITE-CYCLE STATISTICS ===== */
+
+#define EEPROM_WCYCLE_HIST_BUCKETS   12    /* Last bucket collects everything slower */
+#define EEPROM_WCYCLE_HIST_WIDTH_US  500
+
+typedef struct {
+    uint32_t count;                                 /* Completed write cycles */
+    uint32_t timeouts;                              /* Cycles that never ACKed */
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t histogram[EEPROM_WCYCLE_HIST_BUCKETS]; /* Observed tWR per 500 us bucket */
+} eeprom_write_stats_t;
+
 /* ===== EEPROM INTERFACE ===== */
 
+/*
+ * The whole FT24C02A is mirrored in a RAM shadow loaded by eeprom_init().
+ * eeprom_read() is served from the shadow, eeprom_write() only updates the
+ * shadow and marks pages dirty; eeprom_flush() commits the pages whose bytes
+ * actually differ from the device.
+ */
+
 hal_status_t eeprom_init(void);
 
 hal_status_t eeprom_read(uint8_t address, uint8_t *buffer, uint16_t length);
 
+/**
+ * Update the shadow below EEPROM_RECORD_BASE
+ * @return HAL_OK on success, HAL_INVALID_PARAM if the range reaches the record area
+ */
 hal_status_t eeprom_write(uint8_t address, const uint8_t *buffer, uint16_t length);
 
+/**
+ * Update the shadow inside the record area (EEPROM_RECORD_BASE and up)
+ *
+ * For eeprom_record.c only: it alone knows which slot may be rewritten.
+ * @return HAL_OK on success
+ */
+hal_status_t eeprom_write_record_area(uint8_t address, const uint8_t *buffer, uint16_t length);
+
+/**
+ * Write all dirty pages back to the device
+ * @return HAL_OK on success (also when nothing is dirty)
+ */
+hal_status_t eeprom_flush(void);
+
+/**
+ * Check for writes not yet committed by eeprom_flush()
+ * @return 1 if the shadow holds unflushed changes, 0 otherwise
+ */
+uint8_t eeprom_is_dirty(void);
+
+/**
+ * Get observed write-cycle latency (ACK polling after each page write)
+ * @param[out] stats Receives a snapshot of the counters
+ * @return HAL_OK on success
+ */
+hal_status_t eeprom_get_write_stats(eeprom_write_stats_t *stats);
+
+/**
+ * Flush pending writes and release the I2C bus
+ * @return HAL_OK on success
+ */
 hal_status_t eeprom_deinit(void);
 
 #endif /* EEPROM_DRIVER_H */
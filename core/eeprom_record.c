@@ -0,0 +1,196 @@
+/**
+ * A/B Settings Record Implementation
+ * Built on the shadowed FT24C02A driver
+ */
+
+#include "eeprom_record.h"
+#include "eeprom_driver.h"
+#include "crc.h"
+#include <string.h>
+
+/* ===== SLOT FIELD OFFSETS ===== */
+#define REC_OFF_MAGIC       0
+#define REC_OFF_VERSION     2
+#define REC_OFF_LENGTH      3
+#define REC_OFF_SEQ         4
+#define REC_OFF_PAYLOAD     EEPROM_RECORD_HEADER_SIZE
+#define REC_OFF_CRC         (EEPROM_RECORD_SLOT_SIZE - EEPROM_RECORD_CRC_SIZE)
+
+/* ===== COMMITTED RECORD STATE ===== */
+/*
+ * The shadow also holds records whose flush failed, so it cannot say
+ * which slot is safely on the chip. The committed slot is tracked here
+ * instead: stores always target the other one, and loads only return it.
+ */
+typedef struct {
+    uint8_t known;          /* Set once the slots have been scanned */
+    int slot;               /* Committed slot, -1 if none */
+    uint32_t seq;
+} record_state_t;
+
+static record_state_t record_state = {
+    .known = 0,
+    .slot = -1,
+    .seq = 0,
+};
+
+/* ===== LOCAL HELPER FUNCTIONS ===== */
+
+/**
+ * Validate one slot image
+ * @return 1 if the slot holds a complete record, 0 otherwise
+ */
+static uint8_t record_slot_valid(const uint8_t *slot, uint32_t *seq)
+{
+    uint16_t magic = ((uint16_t)slot[REC_OFF_MAGIC] << 8) | slot[REC_OFF_MAGIC + 1];
+    if (magic != EEPROM_RECORD_MAGIC || slot[REC_OFF_VERSION] != EEPROM_RECORD_VERSION) {
+        return 0;
+    }
+
+    uint8_t length = slot[REC_OFF_LENGTH];
+    if (length > EEPROM_RECORD_MAX_PAYLOAD) {
+        return 0;
+    }
+
+    uint16_t crc = crc16_ccitt(CRC16_CCITT_INIT, slot, EEPROM_RECORD_HEADER_SIZE + length);
+    uint16_t stored = ((uint16_t)slot[REC_OFF_CRC] << 8) | slot[REC_OFF_CRC + 1];
+    if (crc != stored) {
+        return 0;
+    }
+
+    *seq = ((uint32_t)slot[REC_OFF_SEQ] << 24) | ((uint32_t)slot[REC_OFF_SEQ + 1] << 16) |
+           ((uint32_t)slot[REC_OFF_SEQ + 2] << 8) | slot[REC_OFF_SEQ + 3];
+    return 1;
+}
+
+/**
+ * Find the slot holding the newest valid record
+ * @return Slot index, or -1 if none is valid
+ */
+static int record_find_newest(uint8_t slots[EEPROM_RECORD_SLOT_COUNT][EEPROM_RECORD_SLOT_SIZE],
+                              uint32_t *seq)
+{
+    int newest = -1;
+    uint32_t newest_seq = 0;
+
+    for (int i = 0; i < EEPROM_RECORD_SLOT_COUNT; i++) {
+        uint32_t slot_seq;
+        if (!record_slot_valid(slots[i], &slot_seq)) {
+            continue;
+        }
+        /* Serial-number comparison so the counter may wrap */
+        if (newest < 0 || (int32_t)(slot_seq - newest_seq) > 0) {
+            newest = i;
+            newest_seq = slot_seq;
+        }
+    }
+
+    *seq = newest_seq;
+    return newest;
+}
+
+/**
+ * Learn the committed slot from the first scan of the slots
+ *
+ * Only a clean shadow is trusted; with unflushed writes the scan is
+ * retried on the next call.
+ */
+static void record_sync_state(uint8_t slots[EEPROM_RECORD_SLOT_COUNT][EEPROM_RECORD_SLOT_SIZE])
+{
+    if (record_state.known) {
+        return;
+    }
+
+    record_state.slot = record_find_newest(slots, &record_state.seq);
+    record_state.known = !eeprom_is_dirty();
+}
+
+/* ===== PUBLIC IMPLEMENTATION ===== */
+
+hal_status_t eeprom_record_load(uint8_t *buffer, uint16_t capacity, uint16_t *length)
+{
+    if (buffer == NULL || length == NULL) {
+        return HAL_INVALID_PARAM;
+    }
+
+    uint8_t slots[EEPROM_RECORD_SLOT_COUNT][EEPROM_RECORD_SLOT_SIZE];
+    hal_status_t status = eeprom_read(EEPROM_RECORD_BASE, &slots[0][0], EEPROM_RECORD_AREA_SIZE);
+    if (status != HAL_OK) {
+        return status;
+    }
+
+    record_sync_state(slots);
+    int newest = record_state.slot;
+    if (newest < 0) {
+        return HAL_ERROR;  /* Blank or corrupt EEPROM */
+    }
+
+    uint8_t record_length = slots[newest][REC_OFF_LENGTH];
+    if (record_length > capacity) {
+        return HAL_INVALID_PARAM;
+    }
+
+    memcpy(buffer, &slots[newest][REC_OFF_PAYLOAD], record_length);
+    *length = record_length;
+    return HAL_OK;
+}
+
+hal_status_t eeprom_record_store(const uint8_t *buffer, uint16_t length)
+{
+    if ((buffer == NULL && length > 0) || length > EEPROM_RECORD_MAX_PAYLOAD) {
+        return HAL_INVALID_PARAM;
+    }
+
+    uint8_t slots[EEPROM_RECORD_SLOT_COUNT][EEPROM_RECORD_SLOT_SIZE];
+    hal_status_t status = eeprom_read(EEPROM_RECORD_BASE, &slots[0][0], EEPROM_RECORD_AREA_SIZE);
+    if (status != HAL_OK) {
+        return status;
+    }
+
+    /* Never the committed slot, even if an earlier store to the other one failed */
+    record_sync_state(slots);
+    int target = (record_state.slot == 0) ? 1 : 0;
+    uint32_t seq = (record_state.slot < 0) ? 1 : record_state.seq + 1;
+
+    /* Rewrite the target slot in place; unchanged bytes cost no write cycles */
+    uint8_t *slot = slots[target];
+    slot[REC_OFF_MAGIC] = (EEPROM_RECORD_MAGIC >> 8) & 0xFF;
+    slot[REC_OFF_MAGIC + 1] = EEPROM_RECORD_MAGIC & 0xFF;
+    slot[REC_OFF_VERSION] = EEPROM_RECORD_VERSION;
+    slot[REC_OFF_LENGTH] = (uint8_t)length;
+    slot[REC_OFF_SEQ] = (seq >> 24) & 0xFF;
+    slot[REC_OFF_SEQ + 1] = (seq >> 16) & 0xFF;
+    slot[REC_OFF_SEQ + 2] = (seq >> 8) & 0xFF;
+    slot[REC_OFF_SEQ + 3] = seq & 0xFF;
+    if (length > 0) {
+        memcpy(&slot[REC_OFF_PAYLOAD], buffer, length);
+    }
+
+    uint16_t crc = crc16_ccitt(CRC16_CCITT_INIT, slot, EEPROM_RECORD_HEADER_SIZE + length);
+    slot[REC_OFF_CRC] = (crc >> 8) & 0xFF;
+    slot[REC_OFF_CRC + 1] = crc & 0xFF;
+
+    status = eeprom_write_record_area((uint8_t)(EEPROM_RECORD_BASE + target * EEPROM_RECORD_SLOT_SIZE),
+                                      slot, EEPROM_RECORD_SLOT_SIZE);
+    if (status != HAL_OK) {
+        return status;
+    }
+
+    /* The record only counts as stored once it is on the chip */
+    status = eeprom_flush();
+    if (status != HAL_OK) {
+        return status;
+    }
+
+    record_state.known = 1;
+    record_state.slot = target;
+    record_state.seq = seq;
+    return HAL_OK;
+}
+
+void eeprom_record_reset(void)
+{
+    record_state.known = 0;
+    record_state.slot = -1;
+    record_state.seq = 0;
+}
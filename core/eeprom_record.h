@@ -0,0 +1,63 @@
+#ifndef EEPROM_RECORD_H
+#define EEPROM_RECORD_H
+
+/**
+ * Crash-safe A/B settings record stored in the FT24C02A
+ *
+ * The record area (EEPROM_RECORD_BASE to the end of the chip) is split
+ * into two 64-byte slots; eeprom_write() refuses it, so raw writes below
+ * it cannot tear a record. Each store goes to the
+ * slot not holding the last committed record and carries a higher
+ * sequence number plus a CRC-16, so a write torn by power loss (or a
+ * failed flush) leaves the previous record intact. Loading picks the
+ * newest slot whose CRC verifies.
+ */
+
+#include <stdint.h>
+#include "hal.h"
+#include "board_config.h"
+
+/* ===== RECORD LAYOUT ===== */
+
+#define EEPROM_RECORD_AREA_SIZE     (EEPROM_CAPACITY - EEPROM_RECORD_BASE)
+#define EEPROM_RECORD_SLOT_COUNT    2
+#define EEPROM_RECORD_SLOT_SIZE     (EEPROM_RECORD_AREA_SIZE / EEPROM_RECORD_SLOT_COUNT)
+#define EEPROM_RECORD_HEADER_SIZE   8   /* magic(2) version(1) length(1) seq(4) */
+#define EEPROM_RECORD_CRC_SIZE      2
+#define EEPROM_RECORD_MAX_PAYLOAD   (EEPROM_RECORD_SLOT_SIZE - EEPROM_RECORD_HEADER_SIZE - EEPROM_RECORD_CRC_SIZE)
+
+#define EEPROM_RECORD_MAGIC         0x4C4B  /* "LK" */
+#define EEPROM_RECORD_VERSION       1
+
+/* ===== RECORD INTERFACE ===== */
+
+/**
+ * Load the newest valid record
+ *
+ * Served from the EEPROM shadow, so this costs no bus traffic beyond the
+ * single bulk read done by eeprom_init().
+ *
+ * @param[out] buffer Receives the payload
+ * @param[in] capacity Size of buffer
+ * @param[out] length Payload length
+ * @return HAL_OK on success, HAL_ERROR if neither slot holds a valid record
+ */
+hal_status_t eeprom_record_load(uint8_t *buffer, uint16_t capacity, uint16_t *length);
+
+/**
+ * Store a new record in the inactive slot and commit it
+ * @param[in] buffer Payload
+ * @param[in] length Payload length (max EEPROM_RECORD_MAX_PAYLOAD)
+ * @return HAL_OK once the record is on the device
+ */
+hal_status_t eeprom_record_store(const uint8_t *buffer, uint16_t length);
+
+/**
+ * Forget which slot is committed, so the next call rescans the shadow
+ *
+ * Called by eeprom_init() and eeprom_deinit(): the state describes the
+ * chip as last loaded, and is stale once the shadow is dropped or reloaded.
+ */
+void eeprom_record_reset(void);
+
+#endif /* EEPROM_RECORD_H */
@@ -1,6 +1,7 @@
 #include <stdint.h>
 #include "hal.h"
 #include "spi.h"
+#include "pinout.h"
 #include "flash_driver.h"
 #include "flash_defs.h"
 
@@ -1,11 +1,18 @@
 #ifndef HAL_H
 #define HAL_H
 
+/**
+ * HAL status codes shared by loki_app and loki_core.so
+ */
+
 typedef enum {
     HAL_OK = 0,
     HAL_ERROR = -1,
     HAL_NOT_READY = -2,
-    HAL_INVALID_PARAM = -3
+    HAL_INVALID_PARAM = -3,
+    HAL_TIMEOUT = -4,           /* Operation did not complete in time */
+    HAL_BUSY = -5,              /* Device busy (e.g. I2C NACK during a write cycle) */
+    HAL_NOT_SUPPORTED = -6      /* Not available on this hardware/kernel */
 } hal_status_t;
 
 #endif
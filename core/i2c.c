@@ -1,23 +1,273 @@
+/**
+ * I2C HAL Implementation - Linux i2c-dev backend
+ *
+ * Every transfer goes through one ioctl(I2C_RDWR), so a register read is a
+ * single repeated-start transaction instead of separate write()/read()
+ * syscalls, and no I2C_SLAVE ioctl is needed when the address changes.
+ */
+
 #include "i2c.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
 
-hal_status_t i2c_init(int bus, const i2c_config_t *cfg) {
-    return HAL_OK;
+#define I2C_DEV_PATH_FMT    "/dev/i2c-%d"
+#define I2C_OF_CLOCK_FMT    "/sys/class/i2c-dev/i2c-%d/device/of_node/clock-frequency"
+
+/* ===== I2C BUS STATE ===== */
+typedef struct {
+    int fd;                 /* Cached /dev/i2c-N handle, -1 when closed */
+    uint8_t users;          /* Drivers sharing this bus */
+    uint32_t frequency;     /* Effective bus clock */
+    unsigned long funcs;    /* Adapter functionality mask */
+} i2c_bus_state_t;
+
+static i2c_bus_state_t i2c_buses[I2C_BUS_COUNT] = {
+    { .fd = -1 },
+    { .fd = -1 },
+};
+
+/* ===== LOCAL HELPER FUNCTIONS ===== */
+
+static i2c_bus_state_t *i2c_get_bus(i2c_bus_t bus)
+{
+    if ((int)bus < 0 || bus >= I2C_BUS_COUNT || i2c_buses[bus].fd < 0) {
+        return NULL;
+    }
+    return &i2c_buses[bus];
 }
 
-hal_status_t i2c_deinit(int bus) {
-    return HAL_OK;
+/**
+ * Read the adapter clock from the device tree (big-endian u32)
+ * @return Clock in Hz, 0 if not exposed
+ */
+static uint32_t i2c_adapter_clock(i2c_bus_t bus)
+{
+    char path[96];
+    snprintf(path, sizeof(path), I2C_OF_CLOCK_FMT, (int)bus);
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return 0;
+    }
+
+    uint8_t raw[4];
+    size_t n = fread(raw, 1, sizeof(raw), f);
+    fclose(f);
+    if (n != sizeof(raw)) {
+        return 0;
+    }
+
+    return ((uint32_t)raw[0] << 24) | ((uint32_t)raw[1] << 16) |
+           ((uint32_t)raw[2] << 8) | raw[3];
 }
 
-hal_status_t i2c_read(int bus, uint8_t addr, uint8_t *buf, uint16_t len) {
+static hal_status_t i2c_rdwr(i2c_bus_state_t *state, struct i2c_msg *msgs, uint32_t count)
+{
+    struct i2c_rdwr_ioctl_data data = {
+        .msgs = msgs,
+        .nmsgs = count,
+    };
+
+    if (ioctl(state->fd, I2C_RDWR, &data) < 0) {
+        switch (errno) {
+            case ENXIO:
+            case EREMOTEIO:
+                return HAL_BUSY;        /* Address not acknowledged */
+            case ETIMEDOUT:
+                return HAL_TIMEOUT;
+            default:
+                return HAL_ERROR;
+        }
+    }
+
     return HAL_OK;
 }
 
-hal_status_t i2c_write(int bus, uint8_t addr, const uint8_t *buf, uint16_t len) {
+/* ===== PUBLIC IMPLEMENTATION ===== */
+
+hal_status_t i2c_init(i2c_bus_t bus, const i2c_config_t *config)
+{
+    if ((int)bus < 0 || bus >= I2C_BUS_COUNT || config == NULL) {
+        return HAL_INVALID_PARAM;
+    }
+
+    if (config->address_bits != 7) {
+        return HAL_INVALID_PARAM;
+    }
+
+    switch (config->frequency) {
+        case I2C_STANDARD_MODE:
+        case I2C_FAST_MODE:
+        case I2C_FAST_PLUS_MODE:
+            break;
+        default:
+            return HAL_INVALID_PARAM;
+    }
+
+    i2c_bus_state_t *state = &i2c_buses[bus];
+
+    /* One fd per bus, shared by every driver on it */
+    if (state->fd < 0) {
+        char path[32];
+        snprintf(path, sizeof(path), I2C_DEV_PATH_FMT, (int)bus);
+
+        int fd = open(path, O_RDWR | O_CLOEXEC);
+        if (fd < 0) {
+            return HAL_ERROR;
+        }
+
+        unsigned long funcs = 0;
+        if (ioctl(fd, I2C_FUNCS, &funcs) < 0 || !(funcs & I2C_FUNC_I2C)) {
+            close(fd);  /* SMBus-only adapters cannot do I2C_RDWR */
+            return HAL_ERROR;
+        }
+
+        state->fd = fd;
+        state->funcs = funcs;
+        state->frequency = 0;
+    }
+
+    /*
+     * i2c-dev cannot retune the controller; 400 kHz / 1 MHz are available
+     * when the device tree sets clock-frequency accordingly. Keep the
+     * fastest rate every user of the bus supports.
+     */
+    uint32_t frequency = config->frequency;
+    uint32_t adapter = i2c_adapter_clock(bus);
+    if (adapter != 0 && adapter < frequency) {
+        frequency = adapter;
+    }
+    if (state->frequency == 0 || frequency < state->frequency) {
+        state->frequency = frequency;
+    }
+
+    state->users++;
     return HAL_OK;
 }
 
-hal_status_t i2c_write_read(int bus, uint8_t addr,
-                            const uint8_t *tx, uint16_t tx_len,
-                            uint8_t *rx, uint16_t rx_len) {
+hal_status_t i2c_deinit(i2c_bus_t bus)
+{
+    i2c_bus_state_t *state = i2c_get_bus(bus);
+    if (state == NULL) {
+        return HAL_OK;
+    }
+
+    if (state->users > 1) {
+        state->users--;
+        return HAL_OK;
+    }
+
+    close(state->fd);
+    state->fd = -1;
+    state->users = 0;
+    state->frequency = 0;
+    state->funcs = 0;
     return HAL_OK;
 }
+
+hal_status_t i2c_read(i2c_bus_t bus, uint8_t device_addr, uint8_t *data, uint32_t length)
+{
+    if (data == NULL || length == 0 || length > I2C_XFER_MAX_LEN) {
+        return HAL_INVALID_PARAM;
+    }
+
+    i2c_bus_state_t *state = i2c_get_bus(bus);
+    if (state == NULL) {
+        return HAL_NOT_READY;
+    }
+
+    struct i2c_msg msg = { .addr = device_addr, .flags = I2C_M_RD, .len = (uint16_t)length, .buf = data };
+    return i2c_rdwr(state, &msg, 1);
+}
+
+hal_status_t i2c_write(i2c_bus_t bus, uint8_t device_addr, const uint8_t *data, uint32_t length)
+{
+    if (data == NULL || length == 0 || length > I2C_XFER_MAX_LEN) {
+        return HAL_INVALID_PARAM;
+    }
+
+    i2c_bus_state_t *state = i2c_get_bus(bus);
+    if (state == NULL) {
+        return HAL_NOT_READY;
+    }
+
+    struct i2c_msg msg = { .addr = device_addr, .flags = 0, .len = (uint16_t)length, .buf = (uint8_t *)data };
+    return i2c_rdwr(state, &msg, 1);
+}
+
+hal_status_t i2c_write_read(i2c_bus_t bus, uint8_t device_addr,
+                           const uint8_t *tx_data, uint32_t tx_length,
+                           uint8_t *rx_data, uint32_t rx_length)
+{
+    if (tx_data == NULL || tx_length == 0 || tx_length > I2C_XFER_MAX_LEN ||
+        rx_data == NULL || rx_length == 0 || rx_length > I2C_XFER_MAX_LEN) {
+        return HAL_INVALID_PARAM;
+    }
+
+    i2c_bus_state_t *state = i2c_get_bus(bus);
+    if (state == NULL) {
+        return HAL_NOT_READY;
+    }
+
+    /* Repeated start between the two messages, one STOP at the end */
+    struct i2c_msg msgs[2] = {
+        { .addr = device_addr, .flags = 0,        .len = (uint16_t)tx_length, .buf = (uint8_t *)tx_data },
+        { .addr = device_addr, .flags = I2C_M_RD, .len = (uint16_t)rx_length, .buf = rx_data },
+    };
+    return i2c_rdwr(state, msgs, 2);
+}
+
+hal_status_t i2c_transfer(i2c_bus_t bus, i2c_xfer_t *xfers, uint8_t count)
+{
+    if (xfers == NULL || count == 0 || count > I2C_XFER_MAX) {
+        return HAL_INVALID_PARAM;
+    }
+
+    i2c_bus_state_t *state = i2c_get_bus(bus);
+    if (state == NULL) {
+        return HAL_NOT_READY;
+    }
+
+    struct i2c_msg msgs[I2C_XFER_MAX];
+    for (uint8_t i = 0; i < count; i++) {
+        if (xfers[i].buf == NULL || xfers[i].len == 0 || xfers[i].len > I2C_XFER_MAX_LEN) {
+            return HAL_INVALID_PARAM;
+        }
+        msgs[i].addr = xfers[i].addr;
+        msgs[i].flags = (xfers[i].flags & I2C_XFER_READ) ? I2C_M_RD : 0;
+        msgs[i].len = xfers[i].len;
+        msgs[i].buf = xfers[i].buf;
+    }
+
+    return i2c_rdwr(state, msgs, count);
+}
+
+hal_status_t i2c_probe(i2c_bus_t bus, uint8_t device_addr)
+{
+    i2c_bus_state_t *state = i2c_get_bus(bus);
+    if (state == NULL) {
+        return HAL_NOT_READY;
+    }
+
+    /* Address + W with no data when the adapter allows it (SMBus quick) */
+    if (state->funcs & I2C_FUNC_SMBUS_QUICK) {
+        struct i2c_msg msg = { .addr = device_addr, .flags = 0, .len = 0, .buf = NULL };
+        return i2c_rdwr(state, &msg, 1);
+    }
+
+    /* Otherwise a one-byte current-address read still yields the ACK */
+    uint8_t dummy;
+    struct i2c_msg msg = { .addr = device_addr, .flags = I2C_M_RD, .len = 1, .buf = &dummy };
+    return i2c_rdwr(state, &msg, 1);
+}
+
+uint32_t i2c_get_frequency(i2c_bus_t bus)
+{
+    i2c_bus_state_t *state = i2c_get_bus(bus);
+    return state == NULL ? 0 : state->frequency;
+}
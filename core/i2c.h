@@ -1,26 +1,115 @@
 #ifndef I2C_H
 #define I2C_H
 
-#include <stdint.h>
-#include "hal.h"
+/**
+ * I2C Hardware Abstraction Layer for Orange Pi Zero 2W
+ * Supports I2C0 for EEPROM communication
+ *
+ * Linux i2c-dev backend: one cached descriptor per bus and one
+ * ioctl(I2C_RDWR) per transaction.
+ */
 
+#include "types.h"
+
+/* ===== I2C BUS DEFINITIONS ===== */
+typedef enum {
+    I2C_BUS_0 = 0,  /* EEPROM, and optional sensors */
+    I2C_BUS_1 = 1,
+    I2C_BUS_COUNT = 2,
+} i2c_bus_t;
+
+/* ===== COMBINED TRANSACTIONS ===== */
+#define I2C_XFER_WRITE  0
+#define I2C_XFER_READ   1
+#define I2C_XFER_MAX    42      /* Kernel limit for one I2C_RDWR call */
+#define I2C_XFER_MAX_LEN 8192   /* i2c-dev rejects longer I2C_RDWR segments (EINVAL) */
+
+/* One segment of a combined transaction (repeated start between segments) */
 typedef struct {
-    uint32_t frequency;
-    uint8_t address_bits;
-} i2c_config_t;
+    uint8_t addr;       /* 7-bit device address */
+    uint8_t flags;      /* I2C_XFER_WRITE or I2C_XFER_READ */
+    uint16_t len;
+    uint8_t *buf;
+} i2c_xfer_t;
+
+/* ===== PUBLIC API ===== */
+
+/**
+ * Initialize I2C bus
+ *
+ * config->frequency must be an i2c_speed_t value. i2c-dev cannot retune the
+ * controller, so the bus runs at the lower of that and the adapter's
+ * device-tree clock-frequency.
+ *
+ * @param[in] bus I2C bus number
+ * @param[in] config I2C configuration
+ * @return HAL_OK on success
+ */
+hal_status_t i2c_init(i2c_bus_t bus, const i2c_config_t *config);
+
+/**
+ * Write data to I2C device
+ * @param[in] bus I2C bus number
+ * @param[in] device_addr 7-bit I2C device address
+ * @param[in] data Pointer to data buffer
+ * @param[in] length Number of bytes to write
+ * @return HAL_OK on success, HAL_BUSY if the device did not ACK
+ */
+hal_status_t i2c_write(i2c_bus_t bus, uint8_t device_addr, const uint8_t *data, uint32_t length);
+
+/**
+ * Read data from I2C device
+ * @param[in] bus I2C bus number
+ * @param[in] device_addr 7-bit I2C device address
+ * @param[out] data Pointer to receive buffer
+ * @param[in] length Number of bytes to read
+ * @return HAL_OK on success, HAL_BUSY if the device did not ACK
+ */
+hal_status_t i2c_read(i2c_bus_t bus, uint8_t device_addr, uint8_t *data, uint32_t length);
+
+/**
+ * Write then read from I2C device (repeated start, single transaction)
+ * @param[in] bus I2C bus number
+ * @param[in] device_addr 7-bit I2C device address
+ * @param[in] tx_data Transmit buffer
+ * @param[in] tx_length Transmit length
+ * @param[out] rx_data Receive buffer
+ * @param[in] rx_length Receive length
+ * @return HAL_OK on success
+ */
+hal_status_t i2c_write_read(i2c_bus_t bus, uint8_t device_addr,
+                           const uint8_t *tx_data, uint32_t tx_length,
+                           uint8_t *rx_data, uint32_t rx_length);
 
-#define I2C_BUS_0 0
-#define I2C_BUS_1 1
+/**
+ * Run several segments as one bus transaction and one syscall
+ * @param[in] bus I2C bus number
+ * @param[in,out] xfers Segments (read buffers are filled in)
+ * @param[in] count Number of segments (max I2C_XFER_MAX)
+ * @return HAL_OK on success
+ */
+hal_status_t i2c_transfer(i2c_bus_t bus, i2c_xfer_t *xfers, uint8_t count);
 
-hal_status_t i2c_init(int bus, const i2c_config_t *cfg);
-hal_status_t i2c_deinit(int bus);
+/**
+ * Address-only transaction (ACK polling)
+ * @param[in] bus I2C bus number
+ * @param[in] device_addr 7-bit I2C device address
+ * @return HAL_OK on ACK, HAL_BUSY on NACK
+ */
+hal_status_t i2c_probe(i2c_bus_t bus, uint8_t device_addr);
 
-hal_status_t i2c_read(int bus, uint8_t addr, uint8_t *buf, uint16_t len);
-hal_status_t i2c_write(int bus, uint8_t addr, const uint8_t *buf, uint16_t len);
+/**
+ * Get the effective bus clock
+ * @param[in] bus I2C bus number
+ * @return Frequency in Hz, 0 if the bus is not open
+ */
+uint32_t i2c_get_frequency(i2c_bus_t bus);
 
-/* write register, then read */
-hal_status_t i2c_write_read(int bus, uint8_t addr,
-                            const uint8_t *tx, uint16_t tx_len,
-                            uint8_t *rx, uint16_t rx_len);
+/**
+ * Deinitialize I2C bus
+ * @param[in] bus I2C bus number
+ * @return HAL_OK on success
+ */
+hal_status_t i2c_deinit(i2c_bus_t bus);
 
-#endif
+#endif /* I2C_H */
@@ -2,9 +2,23 @@
 #include "eeprom_driver.h"
 
 int loki_eeprom_read(uint8_t address, uint8_t *buffer, uint16_t length) {
+    // eeprom_init() is a no-op once the shadow is loaded
+    int status = eeprom_init();
+    if (status != HAL_OK) {
+        return status;
+    }
     return eeprom_read(address, buffer, length);
 }
 
 int loki_eeprom_write(uint8_t address, const uint8_t *buffer, uint16_t length) {
-    return eeprom_write(address, buffer, length);
+    int status = eeprom_init();
+    if (status != HAL_OK) {
+        return status;
+    }
+    // Python callers expect the data on the chip when this returns
+    status = eeprom_write(address, buffer, length);
+    if (status != HAL_OK) {
+        return status;
+    }
+    return eeprom_flush();
 }
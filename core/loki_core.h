@@ -9,6 +9,7 @@ extern "C" {
 
 // Minimal hardware API we expose to Python
 int loki_eeprom_read(uint8_t address, uint8_t *buffer, uint16_t length);
+// Writes must end below EEPROM_RECORD_BASE (0x80); the rest holds the settings record
 int loki_eeprom_write(uint8_t address, const uint8_t *buffer, uint16_t length);
 
 // You’ll later add: wifi_scan, wifi_sniff, etc.
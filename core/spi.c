@@ -1,24 +1,50 @@
+/**
+ * SPI HAL Implementation - no backend yet
+ *
+ * The drivers on top (sdcard, flash, tft) split one chip-select cycle
+ * across several calls, which spidev's per-message chip select cannot
+ * honour. Until a backend can hold CS, every call reports
+ * HAL_NOT_SUPPORTED so they fail their init instead of running on
+ * invented data.
+ */
+
 #include "spi.h"
-#include <string.h>
 
-int spi_init(int bus, spi_config_t *cfg) {
-    return 0;
+hal_status_t spi_init(spi_bus_t bus, const spi_config_t *config) {
+    (void)bus;
+    (void)config;
+    return HAL_NOT_SUPPORTED;
+}
+
+hal_status_t spi_write(spi_bus_t bus, uint32_t cs_pin, const uint8_t *data, uint32_t length) {
+    (void)bus;
+    (void)cs_pin;
+    (void)data;
+    (void)length;
+    return HAL_NOT_SUPPORTED;
 }
 
-int spi_write(int bus, int cs, const uint8_t *data, uint32_t len) {
-    return 0;
+hal_status_t spi_read(spi_bus_t bus, uint32_t cs_pin, uint8_t *data, uint32_t length) {
+    (void)bus;
+    (void)cs_pin;
+    (void)data;
+    (void)length;
+    return HAL_NOT_SUPPORTED;
 }
 
-int spi_transfer(int bus, int cs,
-                 const uint8_t *tx, uint32_t tx_len,
-                 uint8_t *rx, uint32_t rx_len) {
-    if (rx && tx) {
-        uint32_t n = tx_len < rx_len ? tx_len : rx_len;
-        memcpy(rx, tx, n);  // simple echo stub
-    }
-    return 0;
+hal_status_t spi_transfer(spi_bus_t bus, uint32_t cs_pin,
+                         const uint8_t *tx_data, uint32_t tx_length,
+                         uint8_t *rx_data, uint32_t rx_length) {
+    (void)bus;
+    (void)cs_pin;
+    (void)tx_data;
+    (void)tx_length;
+    (void)rx_data;
+    (void)rx_length;
+    return HAL_NOT_SUPPORTED;
 }
 
-int spi_deinit(int bus) {
-    return 0;
+hal_status_t spi_deinit(spi_bus_t bus) {
+    (void)bus;
+    return HAL_OK;
 }
@@ -8,6 +8,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include "hal.h"
 
 /* ===== I2C CONFIGURATION ===== */
 typedef enum {
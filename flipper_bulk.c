@@ -0,0 +1,399 @@
+/**
+ * @file flipper_bulk.c
+ * @brief Windowed bulk transfers over the Flipper link
+ */
+
+#include "flipper_bulk.h"
+#include "flipper_frame.h"
+#include "flipper_lzss.h"
+#include "config.h"
+#include <string.h>
+#include <time.h>
+
+/* ===== SENDER STATE ===== */
+typedef struct {
+    flipper_message_t msg;      /* Pooled SEND_DATA frame, kept for retransmission */
+    uint64_t sent_ms;
+    bool nack_served;           /* Already resent for a NACK; further ones wait for the timer */
+} flipper_bulk_slot_t;
+
+/* ===== LOCAL HELPER FUNCTIONS ===== */
+
+static uint64_t flipper_bulk_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static uint32_t flipper_bulk_seq(const flipper_message_t *message)
+{
+    return ((uint32_t)message->payload[0] << 8) | message->payload[1];
+}
+
+/**
+ * Send ACK or NACK carrying a sequence number
+ */
+static hal_status_t flipper_bulk_reply(uint8_t cmd, uint32_t seq)
+{
+    uint8_t payload[2] = { (seq >> 8) & 0xFF, seq & 0xFF };
+    flipper_message_t reply = {
+        .cmd = cmd,
+        .length = sizeof(payload),
+        .payload = payload,
+        .id = 0,
+        .buf = NULL,
+    };
+    return flipper_send_message(&reply);
+}
+
+static hal_status_t flipper_bulk_transmit(flipper_bulk_slot_t *slot)
+{
+    slot->sent_ms = flipper_bulk_now_ms();
+    return flipper_send_message(&slot->msg);
+}
+
+static void flipper_bulk_resolve_config(const flipper_bulk_config_t *config, flipper_bulk_config_t *out)
+{
+    if (config != NULL) {
+        *out = *config;
+    } else {
+        flipper_bulk_default_config(out);
+    }
+
+    if (out->window == 0) {
+        out->window = 1;
+    } else if (out->window > FLIPPER_BULK_WINDOW_MAX) {
+        out->window = FLIPPER_BULK_WINDOW_MAX;
+    }
+    if (out->ack_timeout_ms == 0) {
+        out->ack_timeout_ms = FLIPPER_BULK_ACK_TIMEOUT_MS;
+    }
+}
+
+/* ===== PUBLIC IMPLEMENTATION ===== */
+
+void flipper_bulk_default_config(flipper_bulk_config_t *config)
+{
+    if (config == NULL) {
+        return;
+    }
+
+    config->window = FLIPPER_BULK_WINDOW;
+    config->ack_timeout_ms = FLIPPER_BULK_ACK_TIMEOUT_MS;
+    config->max_retries = FLIPPER_BULK_MAX_RETRIES;
+    config->compress = true;
+}
+
+hal_status_t flipper_bulk_send(const uint8_t *data, uint32_t length,
+                               const flipper_bulk_config_t *config,
+                               flipper_bulk_stats_t *stats)
+{
+    if (length > 0 && data == NULL) {
+        return HAL_INVALID_PARAM;
+    }
+    if (length > FLIPPER_BULK_MAX_LENGTH) {
+        return HAL_INVALID_PARAM;
+    }
+
+    flipper_bulk_config_t cfg;
+    flipper_bulk_resolve_config(config, &cfg);
+
+    flipper_bulk_stats_t local = {0};
+    flipper_bulk_slot_t slots[FLIPPER_BULK_WINDOW_MAX];
+
+    /* Offsets let chunks carry varying amounts of data; cap so 16-bit sequences suffice */
+    bool compress = cfg.compress && length >= FLIPPER_COMPRESS_MIN_LENGTH &&
+                    (flipper_get_peer_caps() & FLIPPER_CAP_COMPRESS) &&
+                    length <= (uint32_t)FLIPPER_BULK_MAX_CHUNKS * (FLIPPER_BULK_CHUNK_SIZE - FLIPPER_BULK_OFFSET_SIZE);
+
+    /*
+     * A chunk's timer starts when it is queued to the UART, not when it
+     * leaves the wire, so allow for a full window draining ahead of it.
+     */
+    uint32_t baud = flipper_get_baud_rate();
+    uint32_t ack_timeout = cfg.ack_timeout_ms +
+        (uint32_t)((uint64_t)cfg.window * FLIPPER_FRAME_MAX_SIZE * 10u * 1000u / baud) + 1;
+
+    uint32_t base = 0;          /* Oldest unacknowledged chunk */
+    uint32_t next = 0;          /* Next chunk to send for the first time */
+    uint32_t position = 0;      /* Data bytes already placed in chunks */
+    bool built_all = false;
+    uint8_t retries = 0;
+    hal_status_t status = HAL_OK;
+
+    while (!built_all || base < next) {
+        /* Fill the window */
+        while (!built_all && next - base < cfg.window) {
+            flipper_bulk_slot_t *slot = &slots[next % FLIPPER_BULK_WINDOW_MAX];
+            if (flipper_message_alloc(&slot->msg, FLIPPER_CMD_SEND_DATA) != HAL_OK) {
+                if (next == base) {
+                    status = HAL_BUSY;
+                    goto done;
+                }
+                break;  /* Pool is tight: run with a smaller window for now */
+            }
+
+            uint8_t *p = slot->msg.payload;
+            uint8_t flags = 0;
+            uint32_t remaining = length - position;
+            uint32_t consumed;
+            uint32_t n;
+
+            p[0] = (next >> 8) & 0xFF;
+            p[1] = next & 0xFF;
+
+            if (compress) {
+                uint8_t *body = &p[FLIPPER_BULK_HEADER_SIZE + FLIPPER_BULK_OFFSET_SIZE];
+                uint32_t room = FLIPPER_BULK_CHUNK_SIZE - FLIPPER_BULK_OFFSET_SIZE;
+                uint32_t span = (remaining < FLIPPER_LZSS_WINDOW) ? remaining : FLIPPER_LZSS_WINDOW;
+
+                flags |= FLIPPER_BULK_FLAG_OFFSET;
+                p[3] = (position >> 24) & 0xFF;
+                p[4] = (position >> 16) & 0xFF;
+                p[5] = (position >> 8) & 0xFF;
+                p[6] = position & 0xFF;
+
+                n = flipper_lzss_compress(&data[position], span, body, room, &consumed);
+                if (consumed > room) {
+                    flags |= FLIPPER_BULK_FLAG_COMPRESSED;
+                    local.compressed++;
+                } else {
+                    /* Incompressible: raw carries more */
+                    consumed = (remaining < room) ? remaining : room;
+                    memcpy(body, &data[position], consumed);
+                    n = consumed;
+                }
+                n += FLIPPER_BULK_OFFSET_SIZE;
+            } else {
+                consumed = (remaining < FLIPPER_BULK_CHUNK_SIZE) ? remaining : FLIPPER_BULK_CHUNK_SIZE;
+                if (consumed > 0) {
+                    memcpy(&p[FLIPPER_BULK_HEADER_SIZE], &data[position], consumed);
+                }
+                n = consumed;
+            }
+
+            position += consumed;
+            if (position >= length) {
+                flags |= FLIPPER_BULK_FLAG_LAST;
+                built_all = true;
+            }
+            p[2] = flags;
+            slot->msg.length = (uint16_t)(FLIPPER_BULK_HEADER_SIZE + n);
+            slot->nack_served = false;
+
+            next++;
+            local.chunks++;
+            status = flipper_bulk_transmit(slot);
+            if (status != HAL_OK) {
+                goto done;
+            }
+        }
+
+        /* Wait for feedback until the oldest chunk's timer runs out */
+        flipper_bulk_slot_t *oldest = &slots[base % FLIPPER_BULK_WINDOW_MAX];
+        uint64_t deadline = oldest->sent_ms + ack_timeout;
+        uint64_t now = flipper_bulk_now_ms();
+
+        if (now >= deadline) {
+            local.timeouts++;
+            if (++retries > cfg.max_retries) {
+                status = HAL_TIMEOUT;
+                goto done;
+            }
+            local.retransmits++;
+            status = flipper_bulk_transmit(oldest);
+            if (status != HAL_OK) {
+                goto done;
+            }
+            continue;
+        }
+
+        flipper_message_t reply;
+        status = flipper_receive_message(&reply, (uint32_t)(deadline - now));
+        if (status == HAL_TIMEOUT) {
+            status = HAL_OK;
+            continue;
+        }
+        if (status != HAL_OK) {
+            goto done;
+        }
+
+        if (reply.length >= 2 && reply.cmd == FLIPPER_CMD_ACK) {
+            uint32_t acked = flipper_bulk_seq(&reply);
+            if (acked > base && acked <= next) {
+                while (base < acked) {
+                    flipper_message_release(&slots[base % FLIPPER_BULK_WINDOW_MAX].msg);
+                    base++;
+                }
+                retries = 0;
+            }
+        } else if (reply.length >= 2 && reply.cmd == FLIPPER_CMD_NACK) {
+            uint32_t lost = flipper_bulk_seq(&reply);
+            local.nacks++;
+            flipper_bulk_slot_t *slot = &slots[lost % FLIPPER_BULK_WINDOW_MAX];
+            if (lost >= base && lost < next && !slot->nack_served) {
+                slot->nack_served = true;
+                local.retransmits++;
+                status = flipper_bulk_transmit(slot);
+            }
+        }
+        flipper_message_release(&reply);
+
+        if (status != HAL_OK) {
+            goto done;
+        }
+    }
+
+done:
+    while (base < next) {
+        flipper_message_release(&slots[base % FLIPPER_BULK_WINDOW_MAX].msg);
+        base++;
+    }
+
+    if (stats != NULL) {
+        *stats = local;
+    }
+    return status;
+}
+
+hal_status_t flipper_bulk_receive(uint8_t *buffer, uint32_t capacity, uint32_t *length,
+                                  const flipper_bulk_config_t *config,
+                                  flipper_bulk_stats_t *stats)
+{
+    if (buffer == NULL || length == NULL) {
+        return HAL_INVALID_PARAM;
+    }
+
+    flipper_bulk_config_t cfg;
+    flipper_bulk_resolve_config(config, &cfg);
+
+    flipper_bulk_stats_t local = {0};
+    uint32_t expected = 0;              /* Next chunk needed in order */
+    uint32_t received = 0;              /* Bit i: chunk expected + i already stored */
+    uint32_t last = UINT32_MAX;         /* Sequence of the LAST chunk once seen */
+    uint32_t nacked = UINT32_MAX;       /* Gap already reported */
+    uint8_t idle = 0;
+    hal_status_t status = HAL_OK;
+
+    *length = 0;
+
+    while (last == UINT32_MAX || expected <= last) {
+        flipper_message_t chunk;
+        status = flipper_receive_message(&chunk, cfg.ack_timeout_ms);
+        if (status == HAL_TIMEOUT) {
+            /* Sender may have lost our feedback: repeat where we stand */
+            local.timeouts++;
+            if (++idle > cfg.max_retries) {
+                goto done;
+            }
+            status = flipper_bulk_reply(FLIPPER_CMD_ACK, expected);
+            if (status != HAL_OK) {
+                goto done;
+            }
+            continue;
+        }
+        if (status != HAL_OK) {
+            goto done;
+        }
+
+        if (chunk.cmd != FLIPPER_CMD_SEND_DATA || chunk.length < FLIPPER_BULK_HEADER_SIZE) {
+            flipper_message_release(&chunk);
+            continue;
+        }
+        idle = 0;
+
+        uint32_t seq = flipper_bulk_seq(&chunk);
+        uint8_t flags = chunk.payload[2];
+        const uint8_t *body = &chunk.payload[FLIPPER_BULK_HEADER_SIZE];
+        uint32_t n = chunk.length - FLIPPER_BULK_HEADER_SIZE;
+        uint32_t offset = seq * FLIPPER_BULK_CHUNK_SIZE;
+        bool well_formed = (flags & FLIPPER_BULK_FLAG_LAST) || n == FLIPPER_BULK_CHUNK_SIZE;
+
+        if (flags & FLIPPER_BULK_FLAG_OFFSET) {
+            well_formed = n >= FLIPPER_BULK_OFFSET_SIZE;
+            if (well_formed) {
+                offset = ((uint32_t)body[0] << 24) | ((uint32_t)body[1] << 16) |
+                         ((uint32_t)body[2] << 8) | body[3];
+                body += FLIPPER_BULK_OFFSET_SIZE;
+                n -= FLIPPER_BULK_OFFSET_SIZE;
+            }
+        }
+
+        if (seq < expected || (seq - expected < 32 && (received & (1u << (seq - expected))))) {
+            local.duplicates++;
+        } else if (seq - expected < FLIPPER_BULK_WINDOW_MAX && well_formed) {
+            if (offset > capacity) {
+                flipper_message_release(&chunk);
+                status = HAL_ERROR;
+                goto done;
+            }
+
+            if (flags & FLIPPER_BULK_FLAG_COMPRESSED) {
+                uint32_t produced;
+                if (flipper_lzss_decompress(body, n, &buffer[offset], capacity - offset, &produced) != HAL_OK) {
+                    flipper_message_release(&chunk);
+                    status = HAL_ERROR;
+                    goto done;
+                }
+                n = produced;
+                local.compressed++;
+            } else if (n > capacity - offset) {
+                flipper_message_release(&chunk);
+                status = HAL_ERROR;
+                goto done;
+            } else {
+                memcpy(&buffer[offset], body, n);
+            }
+
+            received |= 1u << (seq - expected);
+            local.chunks++;
+            if (flags & FLIPPER_BULK_FLAG_LAST) {
+                last = seq;
+                *length = offset + n;
+            }
+
+            while (received & 1u) {
+                received >>= 1;
+                expected++;
+            }
+        }
+        flipper_message_release(&chunk);
+
+        /* A chunk past a hole means the hole was lost or corrupted */
+        if (received != 0 && nacked != expected) {
+            nacked = expected;
+            local.nacks++;
+            status = flipper_bulk_reply(FLIPPER_CMD_NACK, expected);
+            if (status != HAL_OK) {
+                goto done;
+            }
+        }
+
+        status = flipper_bulk_reply(FLIPPER_CMD_ACK, expected);
+        if (status != HAL_OK) {
+            goto done;
+        }
+    }
+
+    /* Linger so a retransmitted final chunk (our ACK lost) still gets answered */
+    for (uint8_t i = 0; i <= cfg.max_retries; i++) {
+        flipper_message_t chunk;
+        if (flipper_receive_message(&chunk, cfg.ack_timeout_ms) != HAL_OK) {
+            break;
+        }
+        uint8_t cmd = chunk.cmd;
+        flipper_message_release(&chunk);
+        if (cmd == FLIPPER_CMD_SEND_DATA) {
+            local.duplicates++;
+            flipper_bulk_reply(FLIPPER_CMD_ACK, expected);
+        }
+    }
+    status = HAL_OK;
+
+done:
+    if (stats != NULL) {
+        *stats = local;
+    }
+    return status;
+}
@@ -0,0 +1,102 @@
+#ifndef FLIPPER_BULK_H
+#define FLIPPER_BULK_H
+
+/**
+ * Windowed bulk transfers over the Flipper link
+ *
+ * Large REQUEST_DATA / SEND_DATA exchanges are split into SEND_DATA
+ * chunks carrying [SEQ_HI, SEQ_LO, FLAGS, DATA...]. Up to `window`
+ * chunks are in flight at once instead of waiting a round trip for each.
+ *
+ * The receiver answers with ACK [SEQ_HI, SEQ_LO] naming the next
+ * sequence number it needs (cumulative), and with NACK [SEQ_HI, SEQ_LO]
+ * when a gap shows that chunk was lost or failed its checksum. The
+ * sender resends only the NACKed chunk, or the oldest unacknowledged one
+ * after FLIPPER_BULK_ACK_TIMEOUT_MS of silence.
+ *
+ * When both sides advertise FLIPPER_CAP_COMPRESS, transfers of at least
+ * FLIPPER_COMPRESS_MIN_LENGTH bytes add FLIPPER_BULK_FLAG_OFFSET and a
+ * 4-byte big-endian offset into the data after FLAGS, because chunks no
+ * longer carry a fixed amount of it. Chunks that also set
+ * FLIPPER_BULK_FLAG_COMPRESSED hold one self-contained LZSS block
+ * (flipper_lzss.h) covering up to FLIPPER_LZSS_WINDOW bytes. A chunk
+ * that does not compress is sent raw.
+ *
+ * A transfer owns the link while it runs: unrelated frames that arrive
+ * meanwhile are discarded.
+ */
+
+#include "types.h"
+#include "flipper_uart.h"
+
+/* ===== CHUNK LAYOUT ===== */
+#define FLIPPER_BULK_HEADER_SIZE    3       /* SEQ_HI, SEQ_LO, FLAGS */
+#define FLIPPER_BULK_CHUNK_SIZE     (FLIPPER_MSG_MAX_PAYLOAD - FLIPPER_BULK_HEADER_SIZE)
+#define FLIPPER_BULK_OFFSET_SIZE    4       /* Data offset, with FLIPPER_BULK_FLAG_OFFSET */
+#define FLIPPER_BULK_FLAG_LAST      0x01    /* Final chunk of the transfer */
+#define FLIPPER_BULK_FLAG_COMPRESSED 0x02   /* Data is an LZSS block */
+#define FLIPPER_BULK_FLAG_OFFSET    0x04    /* Offset field present */
+
+#define FLIPPER_BULK_WINDOW_MAX     16      /* Bounded by the message pool */
+#define FLIPPER_BULK_MAX_CHUNKS     65535   /* 16-bit sequence numbers (and final ACK), no wrap */
+#define FLIPPER_BULK_MAX_LENGTH     ((uint32_t)FLIPPER_BULK_MAX_CHUNKS * FLIPPER_BULK_CHUNK_SIZE)
+
+typedef struct {
+    uint8_t window;             /* Chunks in flight (1..FLIPPER_BULK_WINDOW_MAX) */
+    uint32_t ack_timeout_ms;    /* Silence before resending / re-acknowledging */
+    uint8_t max_retries;        /* Consecutive timeouts before HAL_TIMEOUT */
+    bool compress;              /* Compress when the peer supports it (sender) */
+} flipper_bulk_config_t;
+
+typedef struct {
+    uint32_t chunks;            /* Distinct chunks sent or accepted */
+    uint32_t retransmits;       /* Chunks sent again (sender) */
+    uint32_t nacks;             /* NACKs received (sender) or sent (receiver) */
+    uint32_t timeouts;          /* Silent periods that triggered recovery */
+    uint32_t duplicates;        /* Chunks received twice (receiver) */
+    uint32_t compressed;        /* Chunks carrying an LZSS block */
+} flipper_bulk_stats_t;
+
+/* ===== PUBLIC API ===== */
+
+/**
+ * Fill a config with the board defaults
+ * @param[out] config Config to initialize
+ */
+void flipper_bulk_default_config(flipper_bulk_config_t *config);
+
+/**
+ * Send a buffer as a windowed SEND_DATA transfer
+ * @param[in] data Data to send
+ * @param[in] length Bytes to send (max FLIPPER_BULK_MAX_LENGTH, 0 sends one empty chunk)
+ * @param[in] config Transfer settings (NULL for defaults)
+ * @param[out] stats Transfer counters (may be NULL)
+ * @return HAL_OK once every chunk is acknowledged, HAL_TIMEOUT if the
+ *         peer stops responding, HAL_BUSY if the message pool is exhausted
+ */
+hal_status_t flipper_bulk_send(const uint8_t *data, uint32_t length,
+                               const flipper_bulk_config_t *config,
+                               flipper_bulk_stats_t *stats);
+
+/**
+ * Receive a windowed SEND_DATA transfer (e.g. after sending REQUEST_DATA)
+ *
+ * Chunks are written straight to their offset in buffer, so out-of-order
+ * arrivals need no staging; anything up to FLIPPER_BULK_WINDOW_MAX ahead
+ * of the next expected chunk is accepted whatever window the sender uses.
+ * After the last chunk the call lingers for one ack_timeout_ms to
+ * re-acknowledge any retransmission of it.
+ *
+ * @param[out] buffer Destination
+ * @param[in] capacity Size of buffer
+ * @param[out] length Bytes received
+ * @param[in] config Transfer settings (NULL for defaults; window is unused)
+ * @param[out] stats Transfer counters (may be NULL)
+ * @return HAL_OK on a complete transfer, HAL_TIMEOUT if the sender goes
+ *         silent, HAL_ERROR if the data does not fit in buffer
+ */
+hal_status_t flipper_bulk_receive(uint8_t *buffer, uint32_t capacity, uint32_t *length,
+                                  const flipper_bulk_config_t *config,
+                                  flipper_bulk_stats_t *stats);
+
+#endif /* FLIPPER_BULK_H */
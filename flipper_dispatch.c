@@ -0,0 +1,386 @@
+/**
+ * @file flipper_dispatch.c
+ * @brief Event-driven Flipper message dispatcher
+ */
+
+#include "flipper_dispatch.h"
+#include "flipper_pool.h"
+#include <pthread.h>
+#include <time.h>
+
+/* ===== DISPATCHER STATE ===== */
+typedef struct {
+    uint8_t id;                 /* 0: slot free */
+    uint8_t reply_cmd;          /* Response command accepted besides ACK/NACK */
+    uint64_t deadline_ms;
+    flipper_response_cb_t callback;
+    void *context;
+} flipper_pending_t;
+
+typedef struct {
+    flipper_handler_t handler;
+    void *context;
+} flipper_handler_entry_t;
+
+typedef struct {
+    uint8_t running;
+    pthread_mutex_t lock;
+    pthread_cond_t timer_wake;          /* Pending set changed or stopping */
+    pthread_t timer;
+
+    flipper_handler_entry_t handlers[256];
+    flipper_pending_t pending[FLIPPER_DISPATCH_MAX_PENDING];
+    uint8_t next_id;
+
+    flipper_dispatch_stats_t stats;
+} flipper_dispatch_context_t;
+
+static flipper_dispatch_context_t dispatch_ctx = {
+    .running = 0,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .next_id = 1,
+};
+
+/* Blocking request bookkeeping (lives on the caller's stack) */
+typedef struct {
+    pthread_cond_t done_cond;
+    uint8_t done;
+    hal_status_t status;
+    flipper_message_t *response;
+} flipper_sync_request_t;
+
+/* ===== LOCAL HELPER FUNCTIONS ===== */
+
+static uint64_t flipper_dispatch_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+/**
+ * Command a request is answered with, other than ACK/NACK
+ *
+ * Peer-initiated frames carry IDs from the peer's own sequence, so an ID
+ * alone does not make a frame the reply to our request.
+ */
+static uint8_t flipper_reply_cmd(uint8_t request_cmd)
+{
+    switch (request_cmd) {
+    case FLIPPER_CMD_REQUEST_STATE:
+        return FLIPPER_CMD_STATE_UPDATE;
+    case FLIPPER_CMD_REQUEST_DATA:
+        return FLIPPER_CMD_SEND_DATA;
+    case FLIPPER_CMD_SET_BAUD:
+    case FLIPPER_CMD_LINK_TEST:
+        return request_cmd;     /* Echoed */
+    default:
+        return FLIPPER_CMD_ACK;
+    }
+}
+
+/**
+ * Remove a pending request by ID (lock held)
+ * @param[in] reply_cmd Command of the frame answering it, or -1 to match the ID alone
+ * @return true if found; callback/context receive its completion
+ */
+static bool flipper_pending_take(uint8_t id, int reply_cmd, flipper_response_cb_t *callback, void **context)
+{
+    for (int i = 0; i < FLIPPER_DISPATCH_MAX_PENDING; i++) {
+        flipper_pending_t *p = &dispatch_ctx.pending[i];
+        bool answers = reply_cmd < 0 || reply_cmd == FLIPPER_CMD_ACK || reply_cmd == FLIPPER_CMD_NACK ||
+                       reply_cmd == p->reply_cmd;
+        if (p->id == id && answers) {
+            *callback = p->callback;
+            *context = p->context;
+            p->id = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool flipper_id_in_use(uint8_t id)
+{
+    for (int i = 0; i < FLIPPER_DISPATCH_MAX_PENDING; i++) {
+        if (dispatch_ctx.pending[i].id == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Reader-thread hook: complete requests, run handlers, pass on the rest
+ */
+static bool flipper_dispatch_hook(flipper_message_t *message, void *context)
+{
+    (void)context;
+
+    pthread_mutex_lock(&dispatch_ctx.lock);
+
+    if (message->id != 0) {
+        flipper_response_cb_t callback;
+        void *cb_context;
+        if (flipper_pending_take(message->id, message->cmd, &callback, &cb_context)) {
+            dispatch_ctx.stats.responses++;
+            pthread_cond_signal(&dispatch_ctx.timer_wake);
+            pthread_mutex_unlock(&dispatch_ctx.lock);
+
+            callback(message, HAL_OK, cb_context);
+            flipper_message_release(message);
+            return true;
+        }
+        dispatch_ctx.stats.unmatched++;
+    }
+
+    flipper_handler_entry_t entry = dispatch_ctx.handlers[message->cmd];
+    if (entry.handler == NULL) {
+        pthread_mutex_unlock(&dispatch_ctx.lock);
+        return false;
+    }
+    dispatch_ctx.stats.dispatched++;
+    pthread_mutex_unlock(&dispatch_ctx.lock);
+
+    entry.handler(message, entry.context);
+    flipper_message_release(message);
+    return true;
+}
+
+/**
+ * Timer thread: sleep until the earliest deadline, expire requests
+ */
+static void *flipper_dispatch_timer(void *arg)
+{
+    (void)arg;
+
+    pthread_mutex_lock(&dispatch_ctx.lock);
+    while (dispatch_ctx.running) {
+        flipper_pending_t *earliest = NULL;
+        for (int i = 0; i < FLIPPER_DISPATCH_MAX_PENDING; i++) {
+            flipper_pending_t *p = &dispatch_ctx.pending[i];
+            if (p->id != 0 && (earliest == NULL || p->deadline_ms < earliest->deadline_ms)) {
+                earliest = p;
+            }
+        }
+
+        if (earliest == NULL) {
+            pthread_cond_wait(&dispatch_ctx.timer_wake, &dispatch_ctx.lock);
+            continue;
+        }
+
+        uint64_t now = flipper_dispatch_now_ms();
+        if (now < earliest->deadline_ms) {
+            struct timespec wake = {
+                .tv_sec = (time_t)(earliest->deadline_ms / 1000u),
+                .tv_nsec = (long)(earliest->deadline_ms % 1000u) * 1000000L,
+            };
+            pthread_cond_timedwait(&dispatch_ctx.timer_wake, &dispatch_ctx.lock, &wake);
+            continue;
+        }
+
+        flipper_response_cb_t callback = earliest->callback;
+        void *cb_context = earliest->context;
+        earliest->id = 0;
+        dispatch_ctx.stats.timeouts++;
+
+        pthread_mutex_unlock(&dispatch_ctx.lock);
+        callback(NULL, HAL_TIMEOUT, cb_context);
+        pthread_mutex_lock(&dispatch_ctx.lock);
+    }
+    pthread_mutex_unlock(&dispatch_ctx.lock);
+    return NULL;
+}
+
+static void flipper_sync_complete(const flipper_message_t *response, hal_status_t status, void *context)
+{
+    flipper_sync_request_t *sync = context;
+
+    pthread_mutex_lock(&dispatch_ctx.lock);
+    sync->status = status;
+    if (status == HAL_OK) {
+        /* Keep the buffer past the hook's release */
+        flipper_pool_retain(response->buf);
+        *sync->response = *response;
+    }
+    sync->done = 1;
+    pthread_cond_signal(&sync->done_cond);
+    pthread_mutex_unlock(&dispatch_ctx.lock);
+}
+
+/* ===== PUBLIC IMPLEMENTATION ===== */
+
+hal_status_t flipper_dispatch_start(void)
+{
+    pthread_mutex_lock(&dispatch_ctx.lock);
+    if (dispatch_ctx.running) {
+        pthread_mutex_unlock(&dispatch_ctx.lock);
+        return HAL_OK;
+    }
+
+    /* Deadlines are CLOCK_MONOTONIC milliseconds */
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&dispatch_ctx.timer_wake, &attr);
+    pthread_condattr_destroy(&attr);
+
+    dispatch_ctx.running = 1;
+    if (pthread_create(&dispatch_ctx.timer, NULL, flipper_dispatch_timer, NULL) != 0) {
+        dispatch_ctx.running = 0;
+        pthread_cond_destroy(&dispatch_ctx.timer_wake);
+        pthread_mutex_unlock(&dispatch_ctx.lock);
+        return HAL_ERROR;
+    }
+    pthread_mutex_unlock(&dispatch_ctx.lock);
+
+    hal_status_t status = flipper_set_rx_hook(flipper_dispatch_hook, NULL);
+    if (status != HAL_OK) {
+        flipper_dispatch_stop();
+    }
+    return status;
+}
+
+hal_status_t flipper_dispatch_stop(void)
+{
+    pthread_mutex_lock(&dispatch_ctx.lock);
+    if (!dispatch_ctx.running) {
+        pthread_mutex_unlock(&dispatch_ctx.lock);
+        return HAL_OK;
+    }
+    pthread_mutex_unlock(&dispatch_ctx.lock);
+
+    flipper_set_rx_hook(NULL, NULL);
+
+    pthread_mutex_lock(&dispatch_ctx.lock);
+    dispatch_ctx.running = 0;
+    pthread_cond_signal(&dispatch_ctx.timer_wake);
+    pthread_mutex_unlock(&dispatch_ctx.lock);
+    pthread_join(dispatch_ctx.timer, NULL);
+
+    /* Nothing will answer the rest */
+    for (int i = 0; i < FLIPPER_DISPATCH_MAX_PENDING; i++) {
+        pthread_mutex_lock(&dispatch_ctx.lock);
+        flipper_pending_t p = dispatch_ctx.pending[i];
+        dispatch_ctx.pending[i].id = 0;
+        pthread_mutex_unlock(&dispatch_ctx.lock);
+
+        if (p.id != 0) {
+            p.callback(NULL, HAL_NOT_READY, p.context);
+        }
+    }
+
+    pthread_cond_destroy(&dispatch_ctx.timer_wake);
+    return HAL_OK;
+}
+
+hal_status_t flipper_dispatch_register(uint8_t cmd, flipper_handler_t handler, void *context)
+{
+    pthread_mutex_lock(&dispatch_ctx.lock);
+    dispatch_ctx.handlers[cmd].handler = handler;
+    dispatch_ctx.handlers[cmd].context = context;
+    pthread_mutex_unlock(&dispatch_ctx.lock);
+    return HAL_OK;
+}
+
+hal_status_t flipper_request_async(flipper_message_t *request, uint32_t timeout_ms,
+                                   flipper_response_cb_t callback, void *context)
+{
+    if (request == NULL || callback == NULL || timeout_ms == 0) {
+        return HAL_INVALID_PARAM;
+    }
+    if (flipper_get_protocol_version() < FLIPPER_PROTO_V3) {
+        return HAL_NOT_SUPPORTED;
+    }
+
+    pthread_mutex_lock(&dispatch_ctx.lock);
+    if (!dispatch_ctx.running) {
+        pthread_mutex_unlock(&dispatch_ctx.lock);
+        return HAL_NOT_READY;
+    }
+
+    flipper_pending_t *slot = NULL;
+    for (int i = 0; i < FLIPPER_DISPATCH_MAX_PENDING && slot == NULL; i++) {
+        if (dispatch_ctx.pending[i].id == 0) {
+            slot = &dispatch_ctx.pending[i];
+        }
+    }
+    if (slot == NULL) {
+        pthread_mutex_unlock(&dispatch_ctx.lock);
+        return HAL_BUSY;
+    }
+
+    /* IDs cycle through 1..255, skipping any still outstanding */
+    uint8_t id = dispatch_ctx.next_id;
+    while (id == 0 || flipper_id_in_use(id)) {
+        id++;
+    }
+    dispatch_ctx.next_id = (uint8_t)(id + 1);
+
+    /* Registered before sending: the response may beat uart_send() back */
+    slot->id = id;
+    slot->reply_cmd = flipper_reply_cmd(request->cmd);
+    slot->deadline_ms = flipper_dispatch_now_ms() + timeout_ms;
+    slot->callback = callback;
+    slot->context = context;
+    pthread_cond_signal(&dispatch_ctx.timer_wake);
+    pthread_mutex_unlock(&dispatch_ctx.lock);
+
+    request->id = id;
+    hal_status_t status = flipper_send_message(request);
+    if (status != HAL_OK) {
+        /*
+         * uart_send() may block past the deadline. If the timer (or a
+         * response) took the slot meanwhile, the callback has run or is
+         * about to: the completion is committed, so report success.
+         */
+        flipper_response_cb_t ignored_cb;
+        void *ignored_ctx;
+        pthread_mutex_lock(&dispatch_ctx.lock);
+        bool reclaimed = flipper_pending_take(id, -1, &ignored_cb, &ignored_ctx);
+        pthread_mutex_unlock(&dispatch_ctx.lock);
+        if (!reclaimed) {
+            status = HAL_OK;
+        }
+    }
+    return status;
+}
+
+hal_status_t flipper_request(flipper_message_t *request, flipper_message_t *response, uint32_t timeout_ms)
+{
+    if (response == NULL) {
+        return HAL_INVALID_PARAM;
+    }
+
+    flipper_sync_request_t sync = {
+        .done = 0,
+        .status = HAL_ERROR,
+        .response = response,
+    };
+    pthread_cond_init(&sync.done_cond, NULL);
+
+    hal_status_t status = flipper_request_async(request, timeout_ms, flipper_sync_complete, &sync);
+    if (status == HAL_OK) {
+        /* Exactly one completion is guaranteed: response, timeout or stop */
+        pthread_mutex_lock(&dispatch_ctx.lock);
+        while (!sync.done) {
+            pthread_cond_wait(&sync.done_cond, &dispatch_ctx.lock);
+        }
+        pthread_mutex_unlock(&dispatch_ctx.lock);
+        status = sync.status;
+    }
+
+    pthread_cond_destroy(&sync.done_cond);
+    return status;
+}
+
+void flipper_dispatch_get_stats(flipper_dispatch_stats_t *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&dispatch_ctx.lock);
+    *stats = dispatch_ctx.stats;
+    pthread_mutex_unlock(&dispatch_ctx.lock);
+}
@@ -0,0 +1,109 @@
+#ifndef FLIPPER_DISPATCH_H
+#define FLIPPER_DISPATCH_H
+
+/**
+ * Event-driven Flipper message dispatcher
+ *
+ * Incoming frames are parsed on the UART reader thread as they arrive and
+ * routed without any polling:
+ *   - a reply whose correlation ID matches an outstanding request
+ *     completes that request. Replies are ACK, NACK, or the request's
+ *     response command (STATE_UPDATE for REQUEST_STATE, SEND_DATA for
+ *     REQUEST_DATA, the echo for SET_BAUD and LINK_TEST); a
+ *     peer-initiated frame reusing the ID is not one;
+ *   - otherwise the handler registered for its command byte runs;
+ *   - frames nobody claims stay available to flipper_receive_message().
+ *
+ * Correlation IDs need FLIPPER_PROTO_V3: the peer echoes the request's ID
+ * in its response, so up to FLIPPER_DISPATCH_MAX_PENDING requests can be
+ * outstanding at once and complete in any order.
+ *
+ * Handlers and response callbacks run on the reader thread (timeouts on
+ * the dispatcher's timer thread). They should be short, and must not
+ * block waiting for another Flipper frame.
+ */
+
+#include "types.h"
+#include "flipper_uart.h"
+
+#define FLIPPER_DISPATCH_MAX_PENDING    16
+
+/**
+ * Command handler
+ *
+ * The message is only valid during the call; use flipper_pool_retain()
+ * on message->buf to keep the payload.
+ */
+typedef void (*flipper_handler_t)(const flipper_message_t *message, void *context);
+
+/**
+ * Request completion
+ * @param[in] response Response (NULL unless status is HAL_OK), valid during the call
+ * @param[in] status HAL_OK, HAL_TIMEOUT, or HAL_NOT_READY if the dispatcher stopped
+ * @param[in] context Caller context
+ */
+typedef void (*flipper_response_cb_t)(const flipper_message_t *response, hal_status_t status, void *context);
+
+typedef struct {
+    uint32_t dispatched;        /* Frames delivered to command handlers */
+    uint32_t responses;         /* Requests completed by a response */
+    uint32_t timeouts;          /* Requests that expired */
+    uint32_t unmatched;         /* Frames with an ID no request was waiting for */
+} flipper_dispatch_stats_t;
+
+/* ===== PUBLIC API ===== */
+
+/**
+ * Start dispatching on the reader thread (flipper_uart_init() first)
+ * @return HAL_OK on success
+ */
+hal_status_t flipper_dispatch_start(void);
+
+/**
+ * Stop dispatching; outstanding requests complete with HAL_NOT_READY
+ * @return HAL_OK on success
+ */
+hal_status_t flipper_dispatch_stop(void);
+
+/**
+ * Register the handler for a command byte
+ * @param[in] cmd Command byte
+ * @param[in] handler Handler (NULL to unregister)
+ * @param[in] context Passed to the handler
+ * @return HAL_OK on success
+ */
+hal_status_t flipper_dispatch_register(uint8_t cmd, flipper_handler_t handler, void *context);
+
+/**
+ * Send a request and get its response through a callback
+ *
+ * A correlation ID is assigned to request->id before sending.
+ *
+ * @param[in,out] request Request message
+ * @param[in] timeout_ms Time allowed for the response (must be > 0)
+ * @param[in] callback Completion callback, called exactly once on success
+ * @param[in] context Passed to the callback
+ * @return HAL_OK if the callback will run (including a send that failed
+ *         after the request had already timed out), HAL_NOT_SUPPORTED
+ *         before FLIPPER_PROTO_V3, HAL_BUSY if FLIPPER_DISPATCH_MAX_PENDING
+ *         requests are outstanding, or the send error (no callback)
+ */
+hal_status_t flipper_request_async(flipper_message_t *request, uint32_t timeout_ms,
+                                   flipper_response_cb_t callback, void *context);
+
+/**
+ * Send a request and wait for its response
+ * @param[in,out] request Request message (an ID is assigned)
+ * @param[out] response Response; release with flipper_message_release()
+ * @param[in] timeout_ms Time allowed for the response (must be > 0)
+ * @return HAL_OK with a response, HAL_TIMEOUT, or an error from sending
+ */
+hal_status_t flipper_request(flipper_message_t *request, flipper_message_t *response, uint32_t timeout_ms);
+
+/**
+ * Get dispatcher counters
+ * @param[out] stats Receives a snapshot
+ */
+void flipper_dispatch_get_stats(flipper_dispatch_stats_t *stats);
+
+#endif /* FLIPPER_DISPATCH_H */
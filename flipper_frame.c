@@ -0,0 +1,224 @@
+/**
+ * @file flipper_frame.c
+ * @brief Flipper UART frame encoder and streaming parser
+ */
+
+#include "flipper_frame.h"
+#include "flipper_pool.h"
+#include "crc.h"
+#include <string.h>
+
+/* ===== LOCAL HELPER FUNCTIONS ===== */
+
+/**
+ * XOR checksum over CMD, length and payload (SOF excluded)
+ */
+static uint8_t flipper_checksum(const uint8_t *data, uint16_t length)
+{
+    uint8_t checksum = 0;
+    for (uint16_t i = 0; i < length; i++) {
+        checksum ^= data[i];
+    }
+    return checksum;
+}
+
+/**
+ * Write the trailer after `length` bytes of CMD, length and payload
+ */
+static void flipper_trailer_write(uint8_t version, const uint8_t *body, uint16_t length, uint8_t *trailer)
+{
+    if (version >= FLIPPER_PROTO_V2) {
+        uint32_t crc = crc32_ieee(CRC32_INIT, body, length);
+        trailer[0] = (crc >> 24) & 0xFF;
+        trailer[1] = (crc >> 16) & 0xFF;
+        trailer[2] = (crc >> 8) & 0xFF;
+        trailer[3] = crc & 0xFF;
+    } else {
+        trailer[0] = flipper_checksum(body, length);
+    }
+}
+
+static bool flipper_trailer_valid(uint8_t version, const uint8_t *body, uint16_t length, const uint8_t *trailer)
+{
+    if (version >= FLIPPER_PROTO_V2) {
+        uint32_t crc = ((uint32_t)trailer[0] << 24) | ((uint32_t)trailer[1] << 16) |
+                       ((uint32_t)trailer[2] << 8) | trailer[3];
+        return crc32_ieee(CRC32_INIT, body, length) == crc;
+    }
+    return flipper_checksum(body, length) == trailer[0];
+}
+
+static void flipper_parser_emit(flipper_parser_t *parser, const uint8_t *frame,
+                                uint16_t header, uint16_t length)
+{
+    if (parser->q_count == FLIPPER_FRAME_QUEUE_DEPTH) {
+        parser->stats.queue_overflows++;
+        return;
+    }
+
+    flipper_msg_buf_t *out = flipper_pool_alloc();
+    if (out == NULL) {
+        parser->stats.pool_exhausted++;
+        return;
+    }
+
+    /* Payload lands where the pool expects it; no further copies */
+    out->cmd = frame[1];
+    out->id = (header == FLIPPER_FRAME_HEADER_V3) ? frame[2] : 0;
+    out->length = length;
+    memcpy(flipper_pool_payload(out), &frame[header], length);
+
+    uint8_t slot = (uint8_t)((parser->q_head + parser->q_count) % FLIPPER_FRAME_QUEUE_DEPTH);
+    parser->queue[slot] = out;
+    parser->q_count++;
+    parser->stats.frames++;
+}
+
+/**
+ * Extract every complete frame from the buffered input
+ */
+static void flipper_parser_scan(flipper_parser_t *parser)
+{
+    const uint8_t *buf = parser->buf;
+    uint16_t fill = parser->fill;
+    uint16_t start = 0;
+    uint16_t header = flipper_frame_header_size(parser->version);
+
+    while (start < fill) {
+        /* Hunt for the start-of-frame marker */
+        const uint8_t *sof = memchr(&buf[start], FLIPPER_FRAME_SOF, fill - start);
+        if (sof == NULL) {
+            parser->stats.dropped_bytes += fill - start;
+            start = fill;
+            break;
+        }
+        uint16_t at = (uint16_t)(sof - buf);
+        parser->stats.dropped_bytes += at - start;
+        start = at;
+
+        uint16_t avail = fill - start;
+        if (avail < header) {
+            break;  /* Need the rest of the header */
+        }
+
+        uint16_t length = ((uint16_t)buf[start + header - 2] << 8) | buf[start + header - 1];
+        if (length > FLIPPER_MSG_MAX_PAYLOAD) {
+            /* Not a real header: resume the hunt after this SOF */
+            parser->stats.length_errors++;
+            start++;
+            continue;
+        }
+
+        uint16_t body = header + length;
+        uint16_t frame_size = body + flipper_frame_trailer_size(parser->version);
+        if (avail < frame_size) {
+            break;  /* Need the rest of the frame */
+        }
+
+        if (!flipper_trailer_valid(parser->version, &buf[start + 1], body - 1, &buf[start + body])) {
+            parser->stats.checksum_errors++;
+            start++;
+            continue;
+        }
+
+        flipper_parser_emit(parser, &buf[start], header, length);
+        start += frame_size;
+    }
+
+    /* Keep only the incomplete tail (always shorter than one frame) */
+    if (start > 0) {
+        memmove(parser->buf, &parser->buf[start], fill - start);
+        parser->fill = fill - start;
+    }
+}
+
+/* ===== PUBLIC IMPLEMENTATION ===== */
+
+/**
+ * Write header and trailer around a payload already in place after the header
+ */
+static uint16_t flipper_frame_write(uint8_t *frame, uint8_t version, uint8_t cmd, uint8_t id, uint16_t length)
+{
+    uint16_t header = flipper_frame_header_size(version);
+
+    frame[0] = FLIPPER_FRAME_SOF;
+    frame[1] = cmd;
+    if (header == FLIPPER_FRAME_HEADER_V3) {
+        frame[2] = id;
+    }
+    frame[header - 2] = (length >> 8) & 0xFF;
+    frame[header - 1] = length & 0xFF;
+
+    uint16_t frame_length = header + length;
+    flipper_trailer_write(version, &frame[1], frame_length - 1, &frame[frame_length]);
+    return frame_length + flipper_frame_trailer_size(version);
+}
+
+uint16_t flipper_frame_seal(uint8_t *buf, uint8_t version, uint8_t cmd, uint8_t id,
+                            uint16_t length, const uint8_t **start)
+{
+    if (buf == NULL || start == NULL || length > FLIPPER_MSG_MAX_PAYLOAD) {
+        return 0;
+    }
+
+    uint8_t *frame = &buf[FLIPPER_FRAME_PAYLOAD_OFFSET - flipper_frame_header_size(version)];
+    *start = frame;
+    return flipper_frame_write(frame, version, cmd, id, length);
+}
+
+uint16_t flipper_frame_encode(uint8_t version, uint8_t cmd, uint8_t id, const uint8_t *payload,
+                              uint16_t length, uint8_t *out)
+{
+    if (out == NULL || length > FLIPPER_MSG_MAX_PAYLOAD || (length > 0 && payload == NULL)) {
+        return 0;
+    }
+
+    if (length > 0) {
+        memmove(&out[flipper_frame_header_size(version)], payload, length);
+    }
+    return flipper_frame_write(out, version, cmd, id, length);
+}
+
+void flipper_parser_init(flipper_parser_t *parser)
+{
+    flipper_msg_buf_t *buf;
+    while ((buf = flipper_parser_pop(parser)) != NULL) {
+        flipper_pool_release(buf);
+    }
+
+    memset(parser, 0, sizeof(*parser));
+    parser->version = FLIPPER_PROTO_V1;
+}
+
+void flipper_parser_set_version(flipper_parser_t *parser, uint8_t version)
+{
+    parser->version = version;
+}
+
+void flipper_parser_feed(flipper_parser_t *parser, const uint8_t *data, uint32_t length)
+{
+    while (length > 0) {
+        uint16_t space = (uint16_t)(sizeof(parser->buf) - parser->fill);
+        uint16_t take = (length < space) ? (uint16_t)length : space;
+
+        memcpy(&parser->buf[parser->fill], data, take);
+        parser->fill += take;
+        data += take;
+        length -= take;
+
+        flipper_parser_scan(parser);
+    }
+}
+
+flipper_msg_buf_t *flipper_parser_pop(flipper_parser_t *parser)
+{
+    if (parser->q_count == 0) {
+        return NULL;
+    }
+
+    flipper_msg_buf_t *buf = parser->queue[parser->q_head];
+    parser->queue[parser->q_head] = NULL;
+    parser->q_head = (uint8_t)((parser->q_head + 1) % FLIPPER_FRAME_QUEUE_DEPTH);
+    parser->q_count--;
+    return buf;
+}
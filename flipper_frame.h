@@ -0,0 +1,138 @@
+#ifndef FLIPPER_FRAME_H
+#define FLIPPER_FRAME_H
+
+/**
+ * Flipper UART Frame Encoder and Streaming Parser
+ *
+ * Wire format: [SOF, CMD, LEN_HI, LEN_LO, PAYLOAD..., TRAILER]
+ *        v3:   [SOF, CMD, ID, LEN_HI, LEN_LO, PAYLOAD..., TRAILER]
+ *
+ * The trailer depends on the negotiated protocol version and covers
+ * everything after SOF: FLIPPER_PROTO_V1 uses a 1-byte XOR checksum,
+ * FLIPPER_PROTO_V2 and later a big-endian CRC-32. FLIPPER_PROTO_V3 adds a
+ * correlation ID byte (0 = none).
+ *
+ * Frame buffers always keep the payload at FLIPPER_FRAME_PAYLOAD_OFFSET;
+ * shorter headers are written just in front of it.
+ *
+ * The parser accepts bytes in arbitrary chunks. A frame that fails its
+ * length or checksum check is abandoned and the search for the next SOF
+ * restarts one byte after the rejected one, so framing recovers after
+ * lost or corrupted bytes.
+ */
+
+#include "types.h"
+#include "flipper_uart.h"
+
+/* ===== FRAME LAYOUT ===== */
+#define FLIPPER_FRAME_SOF           0xA5
+#define FLIPPER_FRAME_HEADER_SIZE   4       /* SOF, CMD, LEN_HI, LEN_LO (v1, v2) */
+#define FLIPPER_FRAME_HEADER_V3     5       /* SOF, CMD, ID, LEN_HI, LEN_LO */
+#define FLIPPER_FRAME_HEADER_MAX    FLIPPER_FRAME_HEADER_V3
+#define FLIPPER_FRAME_PAYLOAD_OFFSET FLIPPER_FRAME_HEADER_MAX
+#define FLIPPER_FRAME_TRAILER_V1    1       /* XOR checksum */
+#define FLIPPER_FRAME_TRAILER_V2    4       /* CRC-32 */
+#define FLIPPER_FRAME_TRAILER_MAX   FLIPPER_FRAME_TRAILER_V2
+#define FLIPPER_FRAME_MIN_SIZE      (FLIPPER_FRAME_HEADER_SIZE + FLIPPER_FRAME_TRAILER_V1)
+#define FLIPPER_FRAME_MAX_SIZE      (FLIPPER_FRAME_HEADER_MAX + FLIPPER_MSG_MAX_PAYLOAD + FLIPPER_FRAME_TRAILER_MAX)
+
+#define FLIPPER_FRAME_QUEUE_DEPTH   8       /* Complete frames awaiting a reader */
+
+/* ===== PARSER STATE ===== */
+typedef struct {
+    uint8_t buf[2 * FLIPPER_FRAME_MAX_SIZE];    /* Unconsumed input */
+    uint16_t fill;
+
+    flipper_msg_buf_t *queue[FLIPPER_FRAME_QUEUE_DEPTH];   /* Pool buffers, one ref each */
+    uint8_t q_head;
+    uint8_t q_count;
+
+    uint8_t version;                            /* FLIPPER_PROTO_Vx framing expected */
+
+    flipper_link_stats_t stats;
+} flipper_parser_t;
+
+/* ===== PUBLIC API ===== */
+
+/**
+ * Header length for a protocol version
+ * @param[in] version FLIPPER_PROTO_Vx
+ * @return Header bytes, SOF included
+ */
+static inline uint16_t flipper_frame_header_size(uint8_t version)
+{
+    return (version >= FLIPPER_PROTO_V3) ? FLIPPER_FRAME_HEADER_V3 : FLIPPER_FRAME_HEADER_SIZE;
+}
+
+/**
+ * Trailer length for a protocol version
+ * @param[in] version FLIPPER_PROTO_Vx
+ * @return Trailer bytes
+ */
+static inline uint16_t flipper_frame_trailer_size(uint8_t version)
+{
+    return (version >= FLIPPER_PROTO_V2) ? FLIPPER_FRAME_TRAILER_V2 : FLIPPER_FRAME_TRAILER_V1;
+}
+
+/**
+ * Write header and trailer around a payload already at
+ * buf + FLIPPER_FRAME_PAYLOAD_OFFSET
+ * @param[in,out] buf Frame buffer of at least FLIPPER_FRAME_MAX_SIZE bytes
+ * @param[in] version Protocol version selecting header and trailer
+ * @param[in] cmd Command byte
+ * @param[in] id Correlation ID (ignored before FLIPPER_PROTO_V3)
+ * @param[in] length Payload length (max FLIPPER_MSG_MAX_PAYLOAD)
+ * @param[out] start Receives the first byte of the encoded frame
+ * @return Encoded frame length, 0 on invalid parameters
+ */
+uint16_t flipper_frame_seal(uint8_t *buf, uint8_t version, uint8_t cmd, uint8_t id,
+                            uint16_t length, const uint8_t **start);
+
+/**
+ * Encode a frame
+ * @param[in] version Protocol version selecting header and trailer
+ * @param[in] cmd Command byte
+ * @param[in] id Correlation ID (ignored before FLIPPER_PROTO_V3)
+ * @param[in] payload Payload (may be NULL when length is 0)
+ * @param[in] length Payload length (max FLIPPER_MSG_MAX_PAYLOAD)
+ * @param[out] out Buffer of at least FLIPPER_FRAME_MAX_SIZE bytes; the frame starts at out[0]
+ * @return Encoded frame length, 0 on invalid parameters
+ */
+uint16_t flipper_frame_encode(uint8_t version, uint8_t cmd, uint8_t id, const uint8_t *payload,
+                              uint16_t length, uint8_t *out);
+
+/**
+ * Reset parser state, discarding buffered input and releasing queued frames
+ *
+ * The parser starts out expecting FLIPPER_PROTO_V1 framing.
+ *
+ * @param[in,out] parser Parser instance (zeroed or previously initialized)
+ */
+void flipper_parser_init(flipper_parser_t *parser);
+
+/**
+ * Switch the framing expected for subsequent input
+ * @param[in,out] parser Parser instance
+ * @param[in] version FLIPPER_PROTO_Vx
+ */
+void flipper_parser_set_version(flipper_parser_t *parser, uint8_t version);
+
+/**
+ * Feed received bytes; complete frames are appended to the queue
+ * @param[in,out] parser Parser instance
+ * @param[in] data Received bytes
+ * @param[in] length Number of bytes
+ */
+void flipper_parser_feed(flipper_parser_t *parser, const uint8_t *data, uint32_t length);
+
+/**
+ * Take the oldest complete frame
+ *
+ * The caller inherits the queue's reference and must release the buffer.
+ *
+ * @param[in,out] parser Parser instance
+ * @return Pool buffer holding the frame, NULL if the queue is empty
+ */
+flipper_msg_buf_t *flipper_parser_pop(flipper_parser_t *parser);
+
+#endif /* FLIPPER_FRAME_H */
@@ -0,0 +1,139 @@
+/**
+ * @file flipper_lzss.c
+ * @brief LZSS codec for Flipper link payloads
+ */
+
+#include "flipper_lzss.h"
+#include <string.h>
+
+#define LZSS_HASH_BITS      10
+#define LZSS_HASH_SIZE      (1u << LZSS_HASH_BITS)
+#define LZSS_NO_POS         0xFFFFFFFFu
+
+/* ===== LOCAL HELPER FUNCTIONS ===== */
+
+static inline uint32_t lzss_hash(const uint8_t *p)
+{
+    uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+    return (v * 2654435761u) >> (32 - LZSS_HASH_BITS);
+}
+
+/* ===== PUBLIC IMPLEMENTATION ===== */
+
+uint32_t flipper_lzss_compress(const uint8_t *src, uint32_t src_length,
+                               uint8_t *dst, uint32_t dst_capacity, uint32_t *consumed)
+{
+    uint32_t head[LZSS_HASH_SIZE];
+    uint32_t in = 0;
+    uint32_t out = 0;
+    uint32_t flag_pos = 0;
+    uint8_t bit = 8;            /* Items under the current flag byte */
+
+    if (src == NULL || dst == NULL) {
+        if (consumed != NULL) {
+            *consumed = 0;
+        }
+        return 0;
+    }
+
+    memset(head, 0xFF, sizeof(head));
+
+    while (in < src_length) {
+        /* Longest match at the hashed candidate (greedy, single probe) */
+        uint32_t match_len = 0;
+        uint32_t match_off = 0;
+        if (in + FLIPPER_LZSS_MIN_MATCH <= src_length) {
+            uint32_t h = lzss_hash(&src[in]);
+            uint32_t cand = head[h];
+            head[h] = in;
+
+            if (cand != LZSS_NO_POS && in - cand <= FLIPPER_LZSS_WINDOW) {
+                uint32_t limit = src_length - in;
+                if (limit > FLIPPER_LZSS_MAX_MATCH) {
+                    limit = FLIPPER_LZSS_MAX_MATCH;
+                }
+                while (match_len < limit && src[cand + match_len] == src[in + match_len]) {
+                    match_len++;
+                }
+                match_off = in - cand;
+            }
+        }
+
+        uint32_t item_size = (match_len >= FLIPPER_LZSS_MIN_MATCH) ? 2 : 1;
+        uint32_t flag_size = (bit == 8) ? 1 : 0;
+        if (out + flag_size + item_size > dst_capacity) {
+            break;
+        }
+
+        if (flag_size) {
+            flag_pos = out++;
+            dst[flag_pos] = 0;
+            bit = 0;
+        }
+
+        if (item_size == 2) {
+            uint16_t word = (uint16_t)(((match_off - 1) << 6) | (match_len - FLIPPER_LZSS_MIN_MATCH));
+            dst[out++] = (word >> 8) & 0xFF;
+            dst[out++] = word & 0xFF;
+            dst[flag_pos] |= (uint8_t)(1u << bit);
+
+            /* Index the covered positions so later data can refer to them */
+            for (uint32_t i = in + 1; i < in + match_len && i + FLIPPER_LZSS_MIN_MATCH <= src_length; i++) {
+                head[lzss_hash(&src[i])] = i;
+            }
+            in += match_len;
+        } else {
+            dst[out++] = src[in++];
+        }
+        bit++;
+    }
+
+    if (consumed != NULL) {
+        *consumed = in;
+    }
+    return out;
+}
+
+hal_status_t flipper_lzss_decompress(const uint8_t *src, uint32_t src_length,
+                                     uint8_t *dst, uint32_t dst_capacity, uint32_t *produced)
+{
+    if (src == NULL || dst == NULL || produced == NULL) {
+        return HAL_INVALID_PARAM;
+    }
+
+    uint32_t in = 0;
+    uint32_t out = 0;
+
+    while (in < src_length) {
+        uint8_t flags = src[in++];
+
+        for (uint8_t bit = 0; bit < 8 && in < src_length; bit++) {
+            if (flags & (1u << bit)) {
+                if (in + 2 > src_length) {
+                    return HAL_ERROR;
+                }
+                uint16_t word = ((uint16_t)src[in] << 8) | src[in + 1];
+                in += 2;
+
+                uint32_t offset = (word >> 6) + 1u;
+                uint32_t length = (word & 0x3F) + FLIPPER_LZSS_MIN_MATCH;
+                if (offset > out || out + length > dst_capacity) {
+                    return HAL_ERROR;
+                }
+
+                /* Byte at a time: overlapping copies repeat the pattern */
+                for (uint32_t i = 0; i < length; i++, out++) {
+                    dst[out] = dst[out - offset];
+                }
+            } else {
+                if (out >= dst_capacity) {
+                    return HAL_ERROR;
+                }
+                dst[out++] = src[in++];
+            }
+        }
+    }
+
+    *produced = out;
+    return HAL_OK;
+}
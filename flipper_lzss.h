@@ -0,0 +1,48 @@
+#ifndef FLIPPER_LZSS_H
+#define FLIPPER_LZSS_H
+
+/**
+ * LZSS codec for Flipper link payloads
+ *
+ * Heatshrink-sized: no heap, a 1 KB window and a 4 KB encoder hash table
+ * on the stack, nothing at all for the decoder. Each call is a
+ * self-contained block, so blocks decode independently in any order.
+ *
+ * Stream: a flag byte precedes every 8 items, LSB first. A clear bit is
+ * one literal byte; a set bit is a 16-bit big-endian match
+ * ((offset - 1) << 6 | (length - 3)) copying `length` bytes from
+ * `offset` bytes back in the output.
+ */
+
+#include "types.h"
+
+#define FLIPPER_LZSS_WINDOW     1024    /* Max match offset */
+#define FLIPPER_LZSS_MIN_MATCH  3
+#define FLIPPER_LZSS_MAX_MATCH  66
+
+/**
+ * Compress as much of src as fits in dst
+ * @param[in] src Input data
+ * @param[in] src_length Bytes available in src
+ * @param[out] dst Output buffer
+ * @param[in] dst_capacity Size of dst
+ * @param[out] consumed Bytes of src represented by the output
+ * @return Bytes written to dst
+ */
+uint32_t flipper_lzss_compress(const uint8_t *src, uint32_t src_length,
+                               uint8_t *dst, uint32_t dst_capacity, uint32_t *consumed);
+
+/**
+ * Expand one block
+ * @param[in] src Compressed block
+ * @param[in] src_length Block length
+ * @param[out] dst Output buffer
+ * @param[in] dst_capacity Size of dst
+ * @param[out] produced Bytes written to dst
+ * @return HAL_OK on success, HAL_ERROR if the block is malformed or does
+ *         not fit in dst
+ */
+hal_status_t flipper_lzss_decompress(const uint8_t *src, uint32_t src_length,
+                                     uint8_t *dst, uint32_t dst_capacity, uint32_t *produced);
+
+#endif /* FLIPPER_LZSS_H */
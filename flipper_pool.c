@@ -0,0 +1,60 @@
+/**
+ * @file flipper_pool.c
+ * @brief Fixed-size Flipper message buffer pool
+ */
+
+#include "flipper_pool.h"
+#include "memory.h"
+#include <stddef.h>
+
+/* ===== POOL STATE ===== */
+MEMORY_POOL_DEFINE(flipper_msg_buf, flipper_msg_buf_t, FLIPPER_MSG_POOL_SIZE)
+
+/* ===== PUBLIC IMPLEMENTATION ===== */
+
+flipper_msg_buf_t *flipper_pool_alloc(void)
+{
+    flipper_msg_buf_t *buf = flipper_msg_buf_alloc();
+    if (buf == NULL) {
+        return NULL;
+    }
+
+    buf->cmd = 0;
+    buf->id = 0;
+    buf->length = 0;
+    atomic_store_explicit(&buf->refs, 1, memory_order_relaxed);
+    return buf;
+}
+
+void flipper_pool_retain(flipper_msg_buf_t *buf)
+{
+    if (buf != NULL) {
+        atomic_fetch_add_explicit(&buf->refs, 1, memory_order_relaxed);
+    }
+}
+
+void flipper_pool_release(flipper_msg_buf_t *buf)
+{
+    if (buf == NULL) {
+        return;
+    }
+
+    if (atomic_fetch_sub_explicit(&buf->refs, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    flipper_msg_buf_free(buf);
+}
+
+void flipper_pool_get_stats(flipper_pool_stats_t *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+
+    memory_pool_stats_t pool_stats;
+    memory_pool_get_stats(flipper_msg_buf_pool(), &pool_stats);
+    stats->in_use = pool_stats.in_use;
+    stats->high_water = pool_stats.high_water;
+    stats->alloc_failures = pool_stats.alloc_failures;
+}
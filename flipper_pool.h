@@ -0,0 +1,71 @@
+#ifndef FLIPPER_POOL_H
+#define FLIPPER_POOL_H
+
+/**
+ * Fixed-size Flipper message buffer pool
+ *
+ * Every buffer holds one complete frame with the payload at
+ * FLIPPER_FRAME_PAYLOAD_OFFSET, so received payloads are handed out without
+ * copying and outgoing messages are framed in place. Buffers are
+ * reference counted and return to the pool on the last release; the
+ * link never touches the heap. The buffers live in a static
+ * memory_pool_t, so alloc and release are lock-free and the pool shows
+ * up in memory_report().
+ */
+
+#include "types.h"
+#include "flipper_uart.h"
+#include "flipper_frame.h"
+#include <stdatomic.h>
+
+#define FLIPPER_MSG_POOL_SIZE   32
+
+struct flipper_msg_buf {
+    uint8_t frame[FLIPPER_FRAME_MAX_SIZE];
+    uint8_t cmd;
+    uint8_t id;                 /* Correlation ID, 0 if none */
+    uint16_t length;
+    atomic_uint refs;
+};
+
+typedef struct {
+    uint32_t in_use;
+    uint32_t high_water;
+    uint32_t alloc_failures;
+} flipper_pool_stats_t;
+
+/**
+ * Get a buffer with one reference
+ * @return Buffer, or NULL if the pool is exhausted
+ */
+flipper_msg_buf_t *flipper_pool_alloc(void);
+
+/**
+ * Add a reference (e.g. when queueing a buffer the caller also keeps)
+ * @param[in] buf Buffer
+ */
+void flipper_pool_retain(flipper_msg_buf_t *buf);
+
+/**
+ * Drop a reference; the buffer returns to the pool when none remain
+ * @param[in] buf Buffer (NULL is ignored)
+ */
+void flipper_pool_release(flipper_msg_buf_t *buf);
+
+/**
+ * Payload area of a buffer (FLIPPER_MSG_MAX_PAYLOAD bytes)
+ * @param[in] buf Buffer
+ * @return Pointer into the buffer's frame
+ */
+static inline uint8_t *flipper_pool_payload(flipper_msg_buf_t *buf)
+{
+    return &buf->frame[FLIPPER_FRAME_PAYLOAD_OFFSET];
+}
+
+/**
+ * Get pool usage counters
+ * @param[out] stats Receives a snapshot
+ */
+void flipper_pool_get_stats(flipper_pool_stats_t *stats);
+
+#endif /* FLIPPER_POOL_H */
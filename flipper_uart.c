@@ -1,36 +1,223 @@
-hal_status_t flipper_uart_init(void)
+/**
+ * Flipper Zero UART Communication Driver Implementation
+ * Orange Pi Zero 2W - UART1 Interface
+ */
+
+#include "flipper_uart.h"
+#include "flipper_frame.h"
+#include "flipper_pool.h"
+#include "uart.h"
+#include "config.h"
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FLIPPER_RX_CHUNK    256     /* Bytes moved from the UART ring per read */
+#define FLIPPER_TX_BATCH_SIZE   (4 * FLIPPER_FRAME_MAX_SIZE)    /* Frames coalesced per write */
+
+/* Rates tried during negotiation, fastest first */
+static const uint32_t flipper_baud_rates[] = {
+    3000000, 2000000, 1500000, 1000000, 921600, 460800, 230400, UART1_BAUD_RATE,
+};
+
+/* ===== FLIPPER UART STATE ===== */
+typedef struct {
+    uint8_t initialized;
+    uint8_t connected;
+    uint8_t version;            /* Negotiated FLIPPER_PROTO_Vx */
+    uint32_t baud_rate;         /* Current line rate */
+    uint32_t peer_max_baud;     /* From HELLO, 0 if the peer cannot change rate */
+    uint8_t caps;               /* FLIPPER_CAP_x both sides support */
+    uint8_t renegotiating;      /* Rate change in progress: no health checks (rx_lock) */
+    uint32_t error_mark;        /* Frame errors at the start of the health window (rx_lock) */
+    uint32_t frame_mark;        /* Valid frames at the start of the health window (rx_lock) */
+
+    /* Receive side; rx_lock serializes the parser and the inbox */
+    pthread_mutex_t rx_lock;
+    pthread_cond_t rx_ready;            /* Inbox gained a frame (hook mode) */
+    flipper_parser_t parser;
+    flipper_msg_buf_t *inbox[FLIPPER_FRAME_QUEUE_DEPTH];   /* Frames the hook passed on */
+    uint8_t inbox_head;
+    uint8_t inbox_count;
+    flipper_rx_hook_t rx_hook;          /* Set: frames are parsed on the reader thread */
+    void *rx_hook_context;
+
+    /* Transmit side; tx_lock serializes the batch and UART writes */
+    pthread_mutex_t tx_lock;
+    pthread_cond_t tx_kick;             /* Batch became non-empty, or stopping */
+    pthread_t tx_thread;
+    uint8_t tx_running;
+    uint8_t tx_step_down;               /* Reader asked for a lower rate (hook mode) */
+    uint8_t tx_batch[FLIPPER_TX_BATCH_SIZE];
+    uint16_t tx_used;
+    int32_t tx_state_offset;            /* Queued STATE_UPDATE frame, -1 if none */
+    uint16_t tx_state_length;
+    uint64_t tx_deadline_ms;            /* Oldest queued frame goes out by then */
+    flipper_tx_stats_t tx_stats;
+} flipper_uart_context_t;
+
+static flipper_uart_context_t flipper_ctx = {
+    .initialized = 0,
+    .connected = 0,
+    .version = FLIPPER_PROTO_V1,
+    .baud_rate = UART1_BAUD_RATE,
+    .rx_lock = PTHREAD_MUTEX_INITIALIZER,
+    .tx_lock = PTHREAD_MUTEX_INITIALIZER,
+    .tx_state_offset = -1,
+};
+
+/* ===== LOCAL HELPER FUNCTIONS ===== */
+
+static uint64_t flipper_now_ms(void)
 {
-    if (flipper_ctx.initialized) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static void flipper_put_be32(uint8_t *out, uint32_t value)
+{
+    out[0] = (value >> 24) & 0xFF;
+    out[1] = (value >> 16) & 0xFF;
+    out[2] = (value >> 8) & 0xFF;
+    out[3] = value & 0xFF;
+}
+
+static uint32_t flipper_get_be32(const uint8_t *in)
+{
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+/**
+ * Move buffered UART input into the parser (rx_lock held)
+ *
+ * Reads are sized so a burst of minimum-size frames cannot overflow the
+ * parser's queue; feeding stops once it is full.
+ *
+ * @return Number of bytes consumed
+ */
+static uint32_t flipper_pump_rx(void)
+{
+    uint8_t chunk[FLIPPER_RX_CHUNK];
+    uint32_t total = 0;
+
+    while (flipper_ctx.parser.q_count < FLIPPER_FRAME_QUEUE_DEPTH) {
+        uint32_t room = (uint32_t)(FLIPPER_FRAME_QUEUE_DEPTH - flipper_ctx.parser.q_count) * FLIPPER_FRAME_MIN_SIZE;
+        uint32_t n = uart_read(UART_PORT_1, chunk, (room < sizeof(chunk)) ? room : sizeof(chunk));
+        if (n == 0) {
+            break;
+        }
+        flipper_parser_feed(&flipper_ctx.parser, chunk, n);
+        total += n;
+    }
+    return total;
+}
+
+/**
+ * Write out the queued frames in one call (tx_lock held)
+ * @return HAL_OK on success; the batch is emptied either way
+ */
+static hal_status_t flipper_tx_flush_locked(void)
+{
+    if (flipper_ctx.tx_used == 0) {
         return HAL_OK;
     }
 
-    /* Initialize UART1 for Flipper */
-    uart_config_t uart_cfg = {
-        .baud_rate = UART1_BAUD_RATE,
-        .data_bits = UART_DATA_BITS_8,
-        .stop_bits = UART_STOP_BITS_1,
-        .parity = UART_PARITY_NONE,
-    };
-    
-    if (uart_init(UART_PORT_1, &uart_cfg) != HAL_OK) {
-        return HAL_ERROR;
+    hal_status_t status = uart_send(UART_PORT_1, flipper_ctx.tx_batch, flipper_ctx.tx_used);
+    flipper_ctx.tx_stats.writes++;
+    flipper_ctx.tx_used = 0;
+    flipper_ctx.tx_state_offset = -1;
+    return status;
+}
+
+/**
+ * Frame a message onto the end of the batch (tx_lock held)
+ *
+ * A queued STATE_UPDATE is dropped when a newer one arrives: only the
+ * latest state matters, and it goes out after everything queued before it.
+ *
+ * @return HAL_OK, or the error from flushing a full batch
+ */
+static hal_status_t flipper_tx_append_locked(const flipper_message_t *message)
+{
+    hal_status_t status = HAL_OK;
+
+    if (message->cmd == FLIPPER_CMD_STATE_UPDATE && flipper_ctx.tx_state_offset >= 0) {
+        uint16_t offset = (uint16_t)flipper_ctx.tx_state_offset;
+        uint16_t tail = (uint16_t)(offset + flipper_ctx.tx_state_length);
+        memmove(&flipper_ctx.tx_batch[offset], &flipper_ctx.tx_batch[tail], flipper_ctx.tx_used - tail);
+        flipper_ctx.tx_used = (uint16_t)(flipper_ctx.tx_used - flipper_ctx.tx_state_length);
+        flipper_ctx.tx_state_offset = -1;
+        flipper_ctx.tx_stats.superseded++;
     }
 
-    flipper_ctx.initialized = 1;
-    
-    /* Handshake: send HELLO message */
-    flipper_message_t hello = {
-        .cmd = FLIPPER_CMD_HELLO,
-        .length = 0,
-        .payload = NULL,
-    };
-    flipper_send_message(&hello);
+    uint16_t size = (uint16_t)(flipper_frame_header_size(flipper_ctx.version) + message->length +
+                               flipper_frame_trailer_size(flipper_ctx.version));
+    if (flipper_ctx.tx_used + size > FLIPPER_TX_BATCH_SIZE) {
+        status = flipper_tx_flush_locked();
+    }
 
-    flipper_ctx.connected = 1;
-    return HAL_OK;
+    if (flipper_ctx.tx_used == 0) {
+        flipper_ctx.tx_deadline_ms = flipper_now_ms() + FLIPPER_TX_FLUSH_MS;
+        pthread_cond_signal(&flipper_ctx.tx_kick);
+    }
+    if (message->cmd == FLIPPER_CMD_STATE_UPDATE) {
+        flipper_ctx.tx_state_offset = flipper_ctx.tx_used;
+        flipper_ctx.tx_state_length = size;
+    }
+
+    flipper_ctx.tx_used = (uint16_t)(flipper_ctx.tx_used +
+                                     flipper_frame_encode(flipper_ctx.version, message->cmd, message->id,
+                                                          message->payload, message->length,
+                                                          &flipper_ctx.tx_batch[flipper_ctx.tx_used]));
+    flipper_ctx.tx_stats.frames++;
+    return status;
 }
 
-hal_status_t flipper_send_message(const flipper_message_t *message)
+static void flipper_step_down(void);
+
+/**
+ * TX flusher: sleep until the oldest queued frame is due, then write
+ *
+ * Also runs rate step-downs the reader thread asks for: the link test
+ * waits for frames the reader delivers, so it cannot run there.
+ */
+static void *flipper_tx_thread(void *arg)
+{
+    (void)arg;
+
+    pthread_mutex_lock(&flipper_ctx.tx_lock);
+    while (flipper_ctx.tx_running) {
+        if (flipper_ctx.tx_step_down) {
+            flipper_ctx.tx_step_down = 0;
+            pthread_mutex_unlock(&flipper_ctx.tx_lock);
+            flipper_step_down();
+            pthread_mutex_lock(&flipper_ctx.tx_lock);
+            continue;
+        }
+
+        if (flipper_ctx.tx_used == 0) {
+            pthread_cond_wait(&flipper_ctx.tx_kick, &flipper_ctx.tx_lock);
+            continue;
+        }
+
+        if (flipper_now_ms() < flipper_ctx.tx_deadline_ms) {
+            struct timespec wake = {
+                .tv_sec = (time_t)(flipper_ctx.tx_deadline_ms / 1000u),
+                .tv_nsec = (long)(flipper_ctx.tx_deadline_ms % 1000u) * 1000000L,
+            };
+            pthread_cond_timedwait(&flipper_ctx.tx_kick, &flipper_ctx.tx_lock, &wake);
+            continue;
+        }
+
+        flipper_tx_flush_locked();
+    }
+    pthread_mutex_unlock(&flipper_ctx.tx_lock);
+    return NULL;
+}
+
+static hal_status_t flipper_check_message(const flipper_message_t *message)
 {
     if (message == NULL) {
         return HAL_INVALID_PARAM;
@@ -45,151 +232,381 @@ hal_status_t flipper_send_message(const flipper_message_t *message)
     if (!flipper_ctx.initialized) {
         return HAL_NOT_READY;
     }
+    return HAL_OK;
+}
 
-    /* Build packet: [CMD, LEN_HI, LEN_LO, PAYLOAD..., CHECKSUM] */
-    uint8_t packet[FLIPPER_MSG_MAX_PAYLOAD + 4];
-    
-    packet[0] = message->cmd;
-    packet[1] = (message->length >> 8) & 0xFF;
-    packet[2] = message->length & 0xFF;
+static void flipper_message_from_buf(flipper_message_t *message, flipper_msg_buf_t *buf)
+{
+    message->cmd = buf->cmd;
+    message->id = buf->id;
+    message->length = buf->length;
+    message->payload = flipper_pool_payload(buf);
+    message->buf = buf;
+}
 
-    if (message->payload != NULL && message->length > 0) {
-        memcpy(&packet[3], message->payload, message->length);
+static flipper_msg_buf_t *flipper_inbox_pop(void)
+{
+    if (flipper_ctx.inbox_count == 0) {
+        return NULL;
     }
 
-    uint16_t packet_length = 3 + message->length;
-    packet[packet_length] = flipper_checksum(packet, packet_length);
-    packet_length++;
-
-    /* Send packet */
-    return uart_send(UART_PORT_1, packet, packet_length);
+    flipper_msg_buf_t *buf = flipper_ctx.inbox[flipper_ctx.inbox_head];
+    flipper_ctx.inbox_head = (uint8_t)((flipper_ctx.inbox_head + 1) % FLIPPER_FRAME_QUEUE_DEPTH);
+    flipper_ctx.inbox_count--;
+    return buf;
 }
 
-hal_status_t flipper_receive_message(flipper_message_t *message, uint32_t timeout_ms)
+/**
+ * Step the rate down when too many frames arrive damaged (rx_lock held)
+ *
+ * Claims the renegotiation when it fires, so it is reported only once;
+ * the caller then runs flipper_step_down() off the reader thread.
+ *
+ * @return 1 if the rate should step down
+ */
+static uint8_t flipper_link_degraded_locked(void)
 {
-    if (message == NULL) {
-        return HAL_INVALID_PARAM;
+    if (flipper_ctx.renegotiating || flipper_ctx.baud_rate <= UART1_BAUD_RATE) {
+        return 0;
     }
 
-    if (!flipper_ctx.initialized) {
-        return HAL_NOT_READY;
+    const flipper_link_stats_t *stats = &flipper_ctx.parser.stats;
+    uint32_t errors = stats->checksum_errors + stats->length_errors;
+
+    if (stats->frames - flipper_ctx.frame_mark >= FLIPPER_LINK_ERROR_WINDOW) {
+        flipper_ctx.frame_mark = stats->frames;
+        flipper_ctx.error_mark = errors;
+        return 0;
     }
 
-    /* Read header: [CMD, LEN_HI, LEN_LO] */
-    uint8_t header[3];
-    hal_status_t status = uart_receive(UART_PORT_1, header, 3, timeout_ms);
-    if (status != HAL_OK) {
-        return status;
+    if (errors - flipper_ctx.error_mark < FLIPPER_LINK_ERROR_LIMIT) {
+        return 0;
     }
 
-    message->cmd = header[0];
-    uint16_t payload_length = ((uint16_t)header[1] << 8) | header[2];
+    flipper_ctx.renegotiating = 1;
+    return 1;
+}
 
-    if (payload_length > 0 && payload_length <= FLIPPER_MSG_MAX_PAYLOAD) {
-        /* Read payload + checksum */
-        uint8_t payload_and_sum[FLIPPER_MSG_MAX_PAYLOAD + 1];
-        status = uart_receive(UART_PORT_1, payload_and_sum, payload_length + 1, timeout_ms);
-        if (status != HAL_OK) {
-            return status;
-        }
+/**
+ * Reader-thread wakeup in hook mode: parse, offer each frame to the hook,
+ * queue the rest for flipper_receive_message()
+ */
+static void flipper_on_rx(void *context)
+{
+    (void)context;
+    flipper_msg_buf_t *ready[FLIPPER_FRAME_QUEUE_DEPTH];
 
-        /* Verify checksum */
-        uint8_t expected_checksum = flipper_checksum(header, 3);
-        expected_checksum ^= flipper_checksum(payload_and_sum, payload_length);
+    for (;;) {
+        uint8_t count = 0;
 
-        if (expected_checksum != payload_and_sum[payload_length]) {
-            return HAL_ERROR;  /* Checksum mismatch */
+        pthread_mutex_lock(&flipper_ctx.rx_lock);
+        flipper_pump_rx();
+        while (count < FLIPPER_FRAME_QUEUE_DEPTH &&
+               (ready[count] = flipper_parser_pop(&flipper_ctx.parser)) != NULL) {
+            count++;
+        }
+        flipper_rx_hook_t hook = flipper_ctx.rx_hook;
+        void *hook_context = flipper_ctx.rx_hook_context;
+        uint8_t degraded = flipper_link_degraded_locked();
+        pthread_mutex_unlock(&flipper_ctx.rx_lock);
+
+        if (degraded) {
+            pthread_mutex_lock(&flipper_ctx.tx_lock);
+            flipper_ctx.tx_step_down = 1;
+            pthread_cond_signal(&flipper_ctx.tx_kick);
+            pthread_mutex_unlock(&flipper_ctx.tx_lock);
         }
 
-        message->length = payload_length;
-        message->payload = malloc(payload_length);
-        if (message->payload == NULL) {
-            return HAL_ERROR;
+        if (count == 0) {
+            return;
         }
-        memcpy(message->payload, payload_and_sum, payload_length);
-    } else if (payload_length == 0) {
-        /* No payload, but read and verify checksum */
-        uint8_t checksum;
-        status = uart_receive_byte(UART_PORT_1, &checksum, timeout_ms);
-        if (status != HAL_OK) {
-            return status;
+
+        /* Handlers run unlocked so they may send, or receive themselves */
+        for (uint8_t i = 0; i < count; i++) {
+            flipper_message_t message;
+            flipper_message_from_buf(&message, ready[i]);
+            if (hook != NULL && hook(&message, hook_context)) {
+                continue;
+            }
+
+            pthread_mutex_lock(&flipper_ctx.rx_lock);
+            if (flipper_ctx.inbox_count < FLIPPER_FRAME_QUEUE_DEPTH) {
+                uint8_t slot = (uint8_t)((flipper_ctx.inbox_head + flipper_ctx.inbox_count) % FLIPPER_FRAME_QUEUE_DEPTH);
+                flipper_ctx.inbox[slot] = ready[i];
+                flipper_ctx.inbox_count++;
+                pthread_cond_broadcast(&flipper_ctx.rx_ready);
+            } else {
+                flipper_ctx.parser.stats.queue_overflows++;
+                flipper_pool_release(ready[i]);
+            }
+            pthread_mutex_unlock(&flipper_ctx.rx_lock);
+        }
+    }
+}
+
+/**
+ * HELLO exchange: offer our highest version, adopt the peer's answer
+ *
+ * Both directions stay on v1 framing until the reply arrives, so older
+ * firmware that ignores the payload keeps working.
+ */
+static void flipper_negotiate_version(void)
+{
+    uint8_t offer[6] = { FLIPPER_PROTO_VERSION };
+    flipper_put_be32(&offer[1], FLIPPER_BAUD_MAX);
+    offer[5] = FLIPPER_CAPS;
+    flipper_message_t hello = {
+        .cmd = FLIPPER_CMD_HELLO,
+        .length = sizeof(offer),
+        .payload = offer,
+        .id = 0,
+        .buf = NULL,
+    };
+
+    flipper_ctx.version = FLIPPER_PROTO_V1;
+    flipper_ctx.peer_max_baud = 0;
+    flipper_ctx.caps = 0;
+    pthread_mutex_lock(&flipper_ctx.rx_lock);
+    flipper_parser_set_version(&flipper_ctx.parser, FLIPPER_PROTO_V1);
+    pthread_mutex_unlock(&flipper_ctx.rx_lock);
+    if (flipper_send_message(&hello) != HAL_OK) {
+        return;
+    }
+
+    uint8_t agreed = FLIPPER_PROTO_V1;
+    uint64_t deadline = flipper_now_ms() + FLIPPER_HELLO_TIMEOUT_MS;
+    uint64_t now;
+
+    while ((now = flipper_now_ms()) < deadline) {
+        flipper_message_t reply;
+        if (flipper_receive_message(&reply, (uint32_t)(deadline - now)) != HAL_OK) {
+            break;
         }
 
-        uint8_t expected_checksum = flipper_checksum(header, 3);
-        if (expected_checksum != checksum) {
-            return HAL_ERROR;  /* Checksum mismatch */
+        uint8_t cmd = reply.cmd;
+        if (cmd == FLIPPER_CMD_HELLO && reply.length >= 1 && reply.payload[0] > FLIPPER_PROTO_V1) {
+            agreed = (reply.payload[0] < FLIPPER_PROTO_VERSION) ? reply.payload[0] : FLIPPER_PROTO_VERSION;
+        }
+        if (cmd == FLIPPER_CMD_HELLO && reply.length >= 5) {
+            flipper_ctx.peer_max_baud = flipper_get_be32(&reply.payload[1]);
+        }
+        if (cmd == FLIPPER_CMD_HELLO && reply.length >= 6) {
+            flipper_ctx.caps = reply.payload[5] & FLIPPER_CAPS;
         }
+        flipper_message_release(&reply);   /* Nothing else is expected before the handshake */
 
-        message->length = 0;
-        message->payload = NULL;
-    } else {
-        return HAL_INVALID_PARAM;  /* Payload too large */
+        if (cmd == FLIPPER_CMD_HELLO) {
+            break;
+        }
     }
 
-    return HAL_OK;
+    flipper_ctx.version = agreed;
+    pthread_mutex_lock(&flipper_ctx.rx_lock);
+    flipper_parser_set_version(&flipper_ctx.parser, agreed);
+    pthread_mutex_unlock(&flipper_ctx.rx_lock);
 }
 
-uint32_t flipper_available(void)
+/**
+ * Discard receive state after a rate change (bytes straddling it are junk)
+ */
+static void flipper_reset_rx(void)
 {
-    if (!flipper_ctx.initialized) {
-        return 0;
-    }
-
-    return uart_available(UART_PORT_1);
+    uart_flush(UART_PORT_1);
+    pthread_mutex_lock(&flipper_ctx.rx_lock);
+    flipper_parser_init(&flipper_ctx.parser);
+    flipper_parser_set_version(&flipper_ctx.parser, flipper_ctx.version);
+    pthread_mutex_unlock(&flipper_ctx.rx_lock);
 }
 
-hal_status_t flipper_uart_deinit(void)
+/**
+ * Send a frame and wait for the peer to echo it back unchanged
+ */
+static hal_status_t flipper_echo(uint8_t cmd, const uint8_t *payload, uint16_t length, uint32_t timeout_ms)
 {
-    if (!flipper_ctx.initialized) {
-        return HAL_OK;
+    flipper_message_t request = {
+        .cmd = cmd,
+        .length = length,
+        .payload = (uint8_t *)payload,
+        .id = 0,
+        .buf = NULL,
+    };
+    hal_status_t status = flipper_send_message(&request);
+    if (status != HAL_OK) {
+        return status;
     }
 
-    /* Send GOODBYE message */
-    flipper_message_t goodbye = {
-        .cmd = FLIPPER_CMD_GOODBYE,
-        .length = 0,
-        .payload = NULL,
-    };
-    flipper_send_message(&goodbye);
+    uint64_t deadline = flipper_now_ms() + timeout_ms;
+    uint64_t now;
 
-    uart_deinit(UART_PORT_1);
-    flipper_ctx.initialized = 0;
-    flipper_ctx.connected = 0;
-    return HAL_OK;
+    while ((now = flipper_now_ms()) < deadline) {
+        flipper_message_t reply;
+        status = flipper_receive_message(&reply, (uint32_t)(deadline - now));
+        if (status != HAL_OK) {
+            return status;
+        }
+
+        bool match = reply.cmd == cmd && reply.length == length &&
+                     memcmp(reply.payload, payload, length) == 0;
+        bool same_cmd = reply.cmd == cmd;
+        flipper_message_release(&reply);
+
+        if (match) {
+            return HAL_OK;
+        }
+        if (same_cmd) {
+            return HAL_ERROR;   /* Peer refused or the echo was mangled */
+        }
+    }
+    return HAL_TIMEOUT;
 }
+
 /**
- * Flipper Zero UART Communication Driver Implementation
- * Orange Pi Zero 2W - UART1 Interface
+ * Switch both sides to `baud`, prove the link and commit; roll back on failure
  */
+static hal_status_t flipper_try_baud(uint32_t baud)
+{
+    uint32_t previous = flipper_ctx.baud_rate;
+    uint8_t rate[4];
+    flipper_put_be32(rate, baud);
+
+    /* Phase 1: ask at the current rate */
+    uint64_t asked = flipper_now_ms();
+    if (flipper_echo(FLIPPER_CMD_SET_BAUD, rate, sizeof(rate), FLIPPER_HELLO_TIMEOUT_MS) != HAL_OK) {
+        /* The peer may have switched and lost its echo: outwait its fallback timer */
+        uint64_t resume = asked + FLIPPER_BAUD_FALLBACK_MS + FLIPPER_BAUD_SETTLE_MS;
+        uint64_t now = flipper_now_ms();
+        if (now < resume) {
+            usleep((useconds_t)(resume - now) * 1000);
+        }
+        flipper_reset_rx();
+        return HAL_NOT_SUPPORTED;
+    }
 
-#include "flipper_uart.h"
-#include "uart.h"
-#include "config.h"
-#include <string.h>
+    if (uart_set_baud_rate(UART_PORT_1, baud) != HAL_OK) {
+        return HAL_NOT_SUPPORTED;   /* Peer reverts once the commit never comes */
+    }
+    uint64_t switched = flipper_now_ms();
+    usleep(FLIPPER_BAUD_SETTLE_MS * 1000);
+    flipper_reset_rx();
+
+    /* Phase 2: full-size frames with SOF bytes and bit-edge patterns, echoed */
+    hal_status_t status = HAL_OK;
+    uint8_t pattern[FLIPPER_MSG_MAX_PAYLOAD];
+    for (uint8_t round = 0; round < FLIPPER_LINK_TEST_ROUNDS && status == HAL_OK; round++) {
+        for (uint16_t i = 0; i < sizeof(pattern); i++) {
+            static const uint8_t edges[] = { 0x00, 0xFF, 0x55, 0xAA, FLIPPER_FRAME_SOF };
+            pattern[i] = (i & 1) ? edges[(i / 2 + round) % sizeof(edges)] : (uint8_t)(i * 7 + round);
+        }
+        status = flipper_echo(FLIPPER_CMD_LINK_TEST, pattern, sizeof(pattern), FLIPPER_LINK_TEST_TIMEOUT_MS);
+    }
 
-/* ===== FLIPPER UART STATE ===== */
-typedef struct {
-    uint8_t initialized;
-    uint8_t connected;
-} flipper_uart_context_t;
+    /* Phase 3: commit; repeat in case the echo alone was lost */
+    if (status == HAL_OK) {
+        for (uint8_t attempt = 0; attempt < FLIPPER_LINK_TEST_ROUNDS; attempt++) {
+            status = flipper_echo(FLIPPER_CMD_SET_BAUD, rate, sizeof(rate), FLIPPER_LINK_TEST_TIMEOUT_MS);
+            if (status == HAL_OK) {
+                break;
+            }
+        }
+    }
 
-static flipper_uart_context_t flipper_ctx = {
-    .initialized = 0,
-    .connected = 0,
-};
+    if (status == HAL_OK) {
+        pthread_mutex_lock(&flipper_ctx.rx_lock);
+        flipper_ctx.baud_rate = baud;
+        pthread_mutex_unlock(&flipper_ctx.rx_lock);
+        return HAL_OK;
+    }
 
-/* ===== LOCAL HELPER FUNCTIONS ===== */
+    /* Roll back and outwait the peer's fallback timer */
+    uart_set_baud_rate(UART_PORT_1, previous);
+    uint64_t resume = switched + FLIPPER_BAUD_FALLBACK_MS + FLIPPER_BAUD_SETTLE_MS;
+    uint64_t now = flipper_now_ms();
+    if (now < resume) {
+        usleep((useconds_t)(resume - now) * 1000);
+    }
+    flipper_reset_rx();
+    return HAL_ERROR;
+}
 
 /**
- * Calculate simple checksum for message
+ * Try rates from max_baud down until one passes (renegotiating claimed)
  */
-static uint8_t flipper_checksum(const uint8_t *data, uint16_t length)
+static void flipper_change_baud(uint32_t max_baud)
 {
-    uint8_t checksum = 0;
-    for (uint16_t i = 0; i < length; i++) {
-        checksum ^= data[i];
+    if (max_baud > flipper_ctx.peer_max_baud) {
+        max_baud = flipper_ctx.peer_max_baud;
+    }
+
+    for (size_t i = 0; i < sizeof(flipper_baud_rates) / sizeof(flipper_baud_rates[0]); i++) {
+        uint32_t baud = flipper_baud_rates[i];
+        if (baud > max_baud) {
+            continue;
+        }
+        if (baud == flipper_ctx.baud_rate || flipper_try_baud(baud) == HAL_OK) {
+            break;
+        }
     }
-    return checksum;
+}
+
+/**
+ * Release the renegotiation claim and restart the health window
+ */
+static void flipper_renegotiation_done(void)
+{
+    pthread_mutex_lock(&flipper_ctx.rx_lock);
+    flipper_ctx.frame_mark = flipper_ctx.parser.stats.frames;
+    flipper_ctx.error_mark = flipper_ctx.parser.stats.checksum_errors + flipper_ctx.parser.stats.length_errors;
+    flipper_ctx.renegotiating = 0;
+    pthread_mutex_unlock(&flipper_ctx.rx_lock);
+}
+
+/**
+ * Step down after flipper_link_degraded_locked() fired
+ *
+ * When the link is too damaged for even the SET_BAUD exchange, every
+ * candidate fails in phase 1 and the rate would stay where it fails.
+ * GOODBYE then returns both sides to UART1_BAUD_RATE unconditionally,
+ * and a fresh HELLO resynchronizes the frame format there.
+ */
+static void flipper_step_down(void)
+{
+    uint32_t from = flipper_ctx.baud_rate;
+    flipper_change_baud(from - 1);
+
+    if (flipper_ctx.baud_rate >= from) {
+        flipper_message_t goodbye = {
+            .cmd = FLIPPER_CMD_GOODBYE,
+            .length = 0,
+            .payload = NULL,
+            .id = 0,
+            .buf = NULL,
+        };
+        /* Repeated: on a link this bad a single frame may not survive */
+        for (uint8_t attempt = 0; attempt < FLIPPER_LINK_TEST_ROUNDS; attempt++) {
+            flipper_send_message(&goodbye);
+        }
+
+        /*
+         * A damaged length byte leaves the peer's parser waiting for a
+         * payload that will never come at this rate, with the GOODBYEs
+         * stuck behind it. A frame's worth of idle (non-SOF) bytes fills
+         * that out so the peer rescans and finds them.
+         */
+        static const uint8_t idle[FLIPPER_FRAME_MAX_SIZE];
+        pthread_mutex_lock(&flipper_ctx.tx_lock);
+        uart_send(UART_PORT_1, idle, sizeof(idle));
+        pthread_mutex_unlock(&flipper_ctx.tx_lock);
+
+        uart_set_baud_rate(UART_PORT_1, UART1_BAUD_RATE);
+        pthread_mutex_lock(&flipper_ctx.rx_lock);
+        flipper_ctx.baud_rate = UART1_BAUD_RATE;
+        pthread_mutex_unlock(&flipper_ctx.rx_lock);
+        usleep(FLIPPER_BAUD_SETTLE_MS * 1000);
+        flipper_reset_rx();
+        flipper_negotiate_version();
+    }
+
+    flipper_renegotiation_done();
 }
 
 /* ===== PUBLIC IMPLEMENTATION ===== */
@@ -212,47 +629,146 @@ hal_status_t flipper_uart_init(void)
         return HAL_ERROR;
     }
 
+    flipper_parser_init(&flipper_ctx.parser);
+
+    /* Flush and receive deadlines are CLOCK_MONOTONIC */
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&flipper_ctx.tx_kick, &attr);
+    pthread_cond_init(&flipper_ctx.rx_ready, &attr);
+    pthread_condattr_destroy(&attr);
+
+    flipper_ctx.tx_running = 1;
+    if (pthread_create(&flipper_ctx.tx_thread, NULL, flipper_tx_thread, NULL) != 0) {
+        flipper_ctx.tx_running = 0;
+        pthread_cond_destroy(&flipper_ctx.tx_kick);
+        pthread_cond_destroy(&flipper_ctx.rx_ready);
+        uart_deinit(UART_PORT_1);
+        return HAL_ERROR;
+    }
+
     flipper_ctx.initialized = 1;
     
-    /* Handshake: send HELLO message */
-    flipper_message_t hello = {
-        .cmd = FLIPPER_CMD_HELLO,
-        .length = 0,
-        .payload = NULL,
-    };
-    flipper_send_message(&hello);
+    /* Handshake: exchange HELLO and settle the frame format */
+    flipper_ctx.baud_rate = UART1_BAUD_RATE;
+    flipper_negotiate_version();
 
     flipper_ctx.connected = 1;
+
+    if (flipper_ctx.peer_max_baud > UART1_BAUD_RATE) {
+        flipper_negotiate_baud(FLIPPER_BAUD_MAX);
+    }
     return HAL_OK;
 }
 
-hal_status_t flipper_send_message(const flipper_message_t *message)
+hal_status_t flipper_message_alloc(flipper_message_t *message, uint8_t cmd)
 {
     if (message == NULL) {
         return HAL_INVALID_PARAM;
     }
 
-    if (!flipper_ctx.initialized) {
-        return HAL_NOT_READY;
+    flipper_msg_buf_t *buf = flipper_pool_alloc();
+    if (buf == NULL) {
+        return HAL_BUSY;
     }
 
-    /* Build packet: [CMD, LEN_HI, LEN_LO, PAYLOAD..., CHECKSUM] */
-    uint8_t packet[FLIPPER_MSG_MAX_PAYLOAD + 4];
-    
-    packet[0] = message->cmd;
-    packet[1] = (message->length >> 8) & 0xFF;
-    packet[2] = message->length & 0xFF;
+    buf->cmd = cmd;
+    message->cmd = cmd;
+    message->id = 0;
+    message->length = 0;
+    message->payload = flipper_pool_payload(buf);
+    message->buf = buf;
+    return HAL_OK;
+}
+
+void flipper_message_release(flipper_message_t *message)
+{
+    if (message == NULL) {
+        return;
+    }
 
-    if (message->payload != NULL && message->length > 0) {
-        memcpy(&packet[3], message->payload, message->length);
+    flipper_pool_release(message->buf);
+    message->buf = NULL;
+    message->payload = NULL;
+    message->length = 0;
+}
+
+hal_status_t flipper_send_message(const flipper_message_t *message)
+{
+    hal_status_t status = flipper_check_message(message);
+    if (status != HAL_OK) {
+        return status;
     }
 
-    uint16_t packet_length = 3 + message->length;
-    packet[packet_length] = flipper_checksum(packet, packet_length);
-    packet_length++;
+    pthread_mutex_lock(&flipper_ctx.tx_lock);
+
+    /* Frames already queued go first, in the same write */
+    if (flipper_ctx.tx_used > 0) {
+        /* The frame is queued even if making room failed: still flush, report the first error */
+        status = flipper_tx_append_locked(message);
+        hal_status_t flushed = flipper_tx_flush_locked();
+        if (status == HAL_OK) {
+            status = flushed;
+        }
+        pthread_mutex_unlock(&flipper_ctx.tx_lock);
+        return status;
+    }
 
-    /* Send packet */
-    return uart_send(UART_PORT_1, packet, packet_length);
+    /* Built in a pool buffer: frame around the payload where it sits */
+    if (message->buf != NULL && message->payload == flipper_pool_payload(message->buf)) {
+        const uint8_t *packet;
+        uint16_t packet_length = flipper_frame_seal(message->buf->frame, flipper_ctx.version,
+                                                    message->cmd, message->id, message->length,
+                                                    &packet);
+        status = uart_send(UART_PORT_1, packet, packet_length);
+        pthread_mutex_unlock(&flipper_ctx.tx_lock);
+        return status;
+    }
+
+    /* Caller-owned payload: build packet [SOF, CMD, (ID,) LEN_HI, LEN_LO, PAYLOAD..., TRAILER] */
+    flipper_msg_buf_t *tx = flipper_pool_alloc();
+    if (tx == NULL) {
+        pthread_mutex_unlock(&flipper_ctx.tx_lock);
+        return HAL_BUSY;
+    }
+
+    uint16_t packet_length = flipper_frame_encode(flipper_ctx.version, message->cmd, message->id,
+                                                  message->payload, message->length, tx->frame);
+    status = uart_send(UART_PORT_1, tx->frame, packet_length);
+    pthread_mutex_unlock(&flipper_ctx.tx_lock);
+    flipper_pool_release(tx);
+    return status;
+}
+
+hal_status_t flipper_queue_message(const flipper_message_t *message)
+{
+    hal_status_t status = flipper_check_message(message);
+    if (status != HAL_OK) {
+        return status;
+    }
+
+    pthread_mutex_lock(&flipper_ctx.tx_lock);
+    status = flipper_tx_append_locked(message);
+
+    /* No room left for a full-size frame: don't wait for the deadline */
+    if (status == HAL_OK && FLIPPER_TX_BATCH_SIZE - flipper_ctx.tx_used < FLIPPER_FRAME_MAX_SIZE) {
+        status = flipper_tx_flush_locked();
+    }
+    pthread_mutex_unlock(&flipper_ctx.tx_lock);
+    return status;
+}
+
+hal_status_t flipper_flush(void)
+{
+    if (!flipper_ctx.initialized) {
+        return HAL_NOT_READY;
+    }
+
+    pthread_mutex_lock(&flipper_ctx.tx_lock);
+    hal_status_t status = flipper_tx_flush_locked();
+    pthread_mutex_unlock(&flipper_ctx.tx_lock);
+    return status;
 }
 
 hal_status_t flipper_receive_message(flipper_message_t *message, uint32_t timeout_ms)
@@ -265,67 +781,169 @@ hal_status_t flipper_receive_message(flipper_message_t *message, uint32_t timeou
         return HAL_NOT_READY;
     }
 
-    /* Read header: [CMD, LEN_HI, LEN_LO] */
-    uint8_t header[3];
-    hal_status_t status = uart_receive(UART_PORT_1, header, 3, timeout_ms);
-    if (status != HAL_OK) {
-        return status;
+    uint64_t deadline = flipper_now_ms() + timeout_ms;
+    struct timespec wake;
+    if (timeout_ms > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &wake);
+        wake.tv_sec += timeout_ms / 1000;
+        wake.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+        if (wake.tv_nsec >= 1000000000L) {
+            wake.tv_sec++;
+            wake.tv_nsec -= 1000000000L;
+        }
     }
 
-    message->cmd = header[0];
-    uint16_t payload_length = ((uint16_t)header[1] << 8) | header[2];
+    flipper_msg_buf_t *buf = NULL;
+    hal_status_t status = HAL_OK;
 
-    if (payload_length > 0 && payload_length <= FLIPPER_MSG_MAX_PAYLOAD) {
-        /* Read payload + checksum */
-        uint8_t payload_and_sum[FLIPPER_MSG_MAX_PAYLOAD + 1];
-        status = uart_receive(UART_PORT_1, payload_and_sum, payload_length + 1, timeout_ms);
-        if (status != HAL_OK) {
-            return status;
+    pthread_mutex_lock(&flipper_ctx.rx_lock);
+    for (;;) {
+        buf = flipper_inbox_pop();
+        if (buf != NULL) {
+            break;
         }
 
-        /* Verify checksum */
-        uint8_t expected_checksum = flipper_checksum(header, 3);
-        expected_checksum ^= flipper_checksum(payload_and_sum, payload_length);
+        if (flipper_ctx.rx_hook != NULL) {
+            /* The reader thread parses; wait for it to hand something over */
+            int rc = (timeout_ms > 0)
+                ? pthread_cond_timedwait(&flipper_ctx.rx_ready, &flipper_ctx.rx_lock, &wake)
+                : pthread_cond_wait(&flipper_ctx.rx_ready, &flipper_ctx.rx_lock);
+            if (rc != 0 && flipper_ctx.inbox_count == 0) {
+                status = HAL_TIMEOUT;
+                break;
+            }
+            continue;
+        }
 
-        if (expected_checksum != payload_and_sum[payload_length]) {
-            return HAL_ERROR;  /* Checksum mismatch */
+        buf = flipper_parser_pop(&flipper_ctx.parser);
+        if (buf != NULL) {
+            break;
         }
 
-        message->length = payload_length;
-        message->payload = malloc(payload_length);
-        if (message->payload == NULL) {
-            return HAL_ERROR;
+        /* Parse whatever has arrived, however it was chunked */
+        if (flipper_pump_rx() > 0) {
+            continue;
         }
-        memcpy(message->payload, payload_and_sum, payload_length);
-    } else if (payload_length == 0) {
-        /* No payload, but read and verify checksum */
-        uint8_t checksum;
-        status = uart_receive_byte(UART_PORT_1, &checksum, timeout_ms);
-        if (status != HAL_OK) {
-            return status;
+
+        uint32_t wait_ms = 0;
+        if (timeout_ms > 0) {
+            uint64_t now = flipper_now_ms();
+            if (now >= deadline) {
+                status = HAL_TIMEOUT;
+                break;
+            }
+            wait_ms = (uint32_t)(deadline - now);
         }
 
-        uint8_t expected_checksum = flipper_checksum(header, 3);
-        if (expected_checksum != checksum) {
-            return HAL_ERROR;  /* Checksum mismatch */
+        pthread_mutex_unlock(&flipper_ctx.rx_lock);
+        status = uart_wait_available(UART_PORT_1, wait_ms);
+        pthread_mutex_lock(&flipper_ctx.rx_lock);
+        if (status != HAL_OK) {
+            break;
         }
+    }
+    /* Hook mode checks on the reader thread (flipper_on_rx) */
+    uint8_t degraded = (flipper_ctx.rx_hook == NULL) ? flipper_link_degraded_locked() : 0;
+    pthread_mutex_unlock(&flipper_ctx.rx_lock);
+
+    if (degraded) {
+        flipper_step_down();
+    }
+
+    if (buf == NULL) {
+        return status;
+    }
+
+    /* Hand out the parser's buffer as-is; the caller owns its reference */
+    flipper_message_from_buf(message, buf);
+    return HAL_OK;
+}
+
+hal_status_t flipper_set_rx_hook(flipper_rx_hook_t hook, void *context)
+{
+    if (!flipper_ctx.initialized) {
+        return HAL_NOT_READY;
+    }
+
+    pthread_mutex_lock(&flipper_ctx.rx_lock);
+    flipper_ctx.rx_hook = hook;
+    flipper_ctx.rx_hook_context = context;
+    pthread_cond_broadcast(&flipper_ctx.rx_ready);     /* Waiters re-check the mode */
+    pthread_mutex_unlock(&flipper_ctx.rx_lock);
 
-        message->length = 0;
-        message->payload = NULL;
-    } else {
-        return HAL_INVALID_PARAM;  /* Payload too large */
+    uart_set_rx_notify(UART_PORT_1, (hook != NULL) ? flipper_on_rx : NULL, NULL);
+    if (hook != NULL) {
+        flipper_on_rx(NULL);    /* Anything that arrived before the hook */
     }
+    return HAL_OK;
+}
 
+uint8_t flipper_get_protocol_version(void)
+{
+    return flipper_ctx.version;
+}
+
+hal_status_t flipper_negotiate_baud(uint32_t max_baud)
+{
+    if (!flipper_ctx.initialized) {
+        return HAL_NOT_READY;
+    }
+    if (flipper_ctx.peer_max_baud == 0) {
+        return HAL_NOT_SUPPORTED;
+    }
+
+    pthread_mutex_lock(&flipper_ctx.rx_lock);
+    uint8_t busy = flipper_ctx.renegotiating;
+    flipper_ctx.renegotiating = 1;
+    pthread_mutex_unlock(&flipper_ctx.rx_lock);
+    if (busy) {
+        return HAL_BUSY;
+    }
+
+    flipper_change_baud(max_baud);
+    flipper_renegotiation_done();
     return HAL_OK;
 }
 
+uint8_t flipper_get_peer_caps(void)
+{
+    return flipper_ctx.caps;
+}
+
+uint32_t flipper_get_baud_rate(void)
+{
+    return flipper_ctx.baud_rate;
+}
+
 uint32_t flipper_available(void)
 {
     if (!flipper_ctx.initialized) {
         return 0;
     }
 
-    return uart_available(UART_PORT_1);
+    return uart_available(UART_PORT_1) + flipper_ctx.inbox_count;
+}
+
+hal_status_t flipper_get_link_stats(flipper_link_stats_t *stats)
+{
+    if (stats == NULL) {
+        return HAL_INVALID_PARAM;
+    }
+
+    *stats = flipper_ctx.parser.stats;
+    return HAL_OK;
+}
+
+hal_status_t flipper_get_tx_stats(flipper_tx_stats_t *stats)
+{
+    if (stats == NULL) {
+        return HAL_INVALID_PARAM;
+    }
+
+    pthread_mutex_lock(&flipper_ctx.tx_lock);
+    *stats = flipper_ctx.tx_stats;
+    pthread_mutex_unlock(&flipper_ctx.tx_lock);
+    return HAL_OK;
 }
 
 hal_status_t flipper_uart_deinit(void)
@@ -339,11 +957,33 @@ hal_status_t flipper_uart_deinit(void)
         .cmd = FLIPPER_CMD_GOODBYE,
         .length = 0,
         .payload = NULL,
+        .id = 0,
+        .buf = NULL,
     };
     flipper_send_message(&goodbye);
 
+    pthread_mutex_lock(&flipper_ctx.tx_lock);
+    flipper_ctx.tx_running = 0;
+    pthread_cond_signal(&flipper_ctx.tx_kick);
+    pthread_mutex_unlock(&flipper_ctx.tx_lock);
+    pthread_join(flipper_ctx.tx_thread, NULL);
+    pthread_cond_destroy(&flipper_ctx.tx_kick);
+
+    flipper_set_rx_hook(NULL, NULL);
     uart_deinit(UART_PORT_1);
+
+    /* Return queued frames to the pool */
+    flipper_msg_buf_t *buf;
+    while ((buf = flipper_inbox_pop()) != NULL) {
+        flipper_pool_release(buf);
+    }
+    flipper_parser_init(&flipper_ctx.parser);
+    pthread_cond_destroy(&flipper_ctx.rx_ready);
     flipper_ctx.initialized = 0;
     flipper_ctx.connected = 0;
+    flipper_ctx.version = FLIPPER_PROTO_V1;
+    flipper_ctx.baud_rate = UART1_BAUD_RATE;
+    flipper_ctx.peer_max_baud = 0;
+    flipper_ctx.caps = 0;
     return HAL_OK;
 }
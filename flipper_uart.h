@@ -7,20 +7,44 @@
  */
 
 #include "types.h"
-#include "board_config.h"
+#include "config.h"
 
 /* ===== FLIPPER MESSAGE PROTOCOL ===== */
 
-#define FLIPPER_MSG_HEADER_SIZE     2
-#define FLIPPER_MSG_CMD_OFFSET      0
-#define FLIPPER_MSG_LEN_OFFSET      1
 #define FLIPPER_MSG_MAX_PAYLOAD     256
 
+/*
+ * Protocol versions (frame trailer). HELLO carries the sender's highest
+ * version as its first payload byte and is always framed as v1; the
+ * reply names the version both sides switch to. An empty HELLO means v1.
+ *
+ * Bytes 1..4 of HELLO, when present, give the highest baud rate the
+ * sender supports (big-endian); byte 5 is a FLIPPER_CAP_x mask. Features
+ * are used only when both sides advertise them. Rate changes are
+ * two-phase:
+ *   1. SET_BAUD [rate] at the current rate; the peer echoes it and both
+ *      switch.
+ *   2. LINK_TEST frames at the new rate, each echoed verbatim, then
+ *      SET_BAUD [rate] again to commit (also echoed).
+ * A peer that sees no commit within FLIPPER_BAUD_FALLBACK_MS of switching
+ * returns to its previous rate. GOODBYE returns both sides to
+ * UART1_BAUD_RATE.
+ */
+#define FLIPPER_PROTO_V1            1       /* XOR checksum */
+#define FLIPPER_PROTO_V2            2       /* CRC-32 */
+#define FLIPPER_PROTO_V3            3       /* CRC-32 + correlation ID header byte */
+#define FLIPPER_PROTO_VERSION       FLIPPER_PROTO_V3    /* Highest version supported */
+
+#define FLIPPER_CAP_COMPRESS        0x01    /* LZSS SEND_DATA chunks (flipper_lzss.h) */
+#define FLIPPER_CAPS                (FLIPPER_CAP_COMPRESS)  /* Advertised by us */
+
 typedef enum {
     FLIPPER_CMD_ACK           = 0x00,
     FLIPPER_CMD_NACK          = 0x01,
     FLIPPER_CMD_HELLO         = 0x02,
     FLIPPER_CMD_GOODBYE       = 0x03,
+    FLIPPER_CMD_SET_BAUD      = 0x04,
+    FLIPPER_CMD_LINK_TEST     = 0x05,
     FLIPPER_CMD_REQUEST_STATE = 0x10,
     FLIPPER_CMD_STATE_UPDATE  = 0x11,
     FLIPPER_CMD_REQUEST_DATA  = 0x20,
@@ -29,114 +53,188 @@ typedef enum {
     FLIPPER_CMD_DEBUG         = 0xF0,
 } flipper_cmd_t;
 
+/* Pooled frame buffer (see flipper_pool.h) */
+typedef struct flipper_msg_buf flipper_msg_buf_t;
+
 typedef struct {
     uint8_t cmd;
     uint16_t length;
     uint8_t *payload;
+    uint8_t id;                 /* Correlation ID (FLIPPER_PROTO_V3), 0 if none */
+    flipper_msg_buf_t *buf;     /* Pool buffer backing payload, NULL if caller-owned */
 } flipper_message_t;
 
+/**
+ * Frame consumer run on the UART reader thread (see flipper_dispatch.h)
+ * @param[in,out] message Received message
+ * @param[in] context Registration context
+ * @return true if the hook took ownership of the message (and will
+ *         release it), false to leave it for flipper_receive_message()
+ */
+typedef bool (*flipper_rx_hook_t)(flipper_message_t *message, void *context);
+
+/* ===== LINK STATISTICS ===== */
+typedef struct {
+    uint32_t frames;            /* Valid frames received */
+    uint32_t checksum_errors;   /* Frames rejected by checksum */
+    uint32_t length_errors;     /* Headers with impossible lengths */
+    uint32_t dropped_bytes;     /* Bytes skipped while resynchronizing */
+    uint32_t queue_overflows;   /* Valid frames lost to a full queue */
+    uint32_t pool_exhausted;    /* Valid frames lost for lack of a buffer */
+} flipper_link_stats_t;
+
+typedef struct {
+    uint32_t frames;            /* Frames queued with flipper_queue_message() */
+    uint32_t writes;            /* Batched writes to the UART */
+    uint32_t superseded;        /* Queued STATE_UPDATEs replaced by a newer one */
+} flipper_tx_stats_t;
+
 /* ===== PUBLIC API ===== */
 
 /**
  * Initialize Flipper UART communication
+ *
+ * Performs the HELLO handshake; a peer that does not answer within
+ * FLIPPER_HELLO_TIMEOUT_MS is assumed to speak FLIPPER_PROTO_V1 at
+ * UART1_BAUD_RATE. Otherwise the rate is raised as far as the link test
+ * allows (see flipper_negotiate_baud()).
+ *
  * @return HAL_OK on success
  */
 hal_status_t flipper_uart_init(void);
 
 /**
- * Send message to Flipper
- * @param[in] message Pointer to message structure
- * @return HAL_OK on success
+ * Get the protocol version negotiated at handshake
+ * @return FLIPPER_PROTO_Vx (FLIPPER_PROTO_V1 before init)
  */
-hal_status_t flipper_send_message(const flipper_message_t *message);
+uint8_t flipper_get_protocol_version(void);
 
 /**
- * Receive message from Flipper (blocking)
- * @param[out] message Pointer to receive message
- * @param[in] timeout_ms Timeout in milliseconds
- * @return HAL_OK on success
+ * Move the link to the fastest rate both sides pass the link test at
+ *
+ * Candidates run from max_baud (capped by what the peer advertised in
+ * HELLO) downwards; a rate that fails is rolled back before the next is
+ * tried. flipper_uart_init() calls this with FLIPPER_BAUD_MAX, and
+ * the receive path (the reader thread once an rx hook is set) steps the
+ * rate down on its own when frame errors exceed FLIPPER_LINK_ERROR_LIMIT.
+ * If no lower rate can be negotiated, GOODBYE forces both sides back to
+ * UART1_BAUD_RATE.
+ *
+ * @param[in] max_baud Highest rate to try
+ * @return HAL_OK with the link at the chosen rate (possibly
+ *         UART1_BAUD_RATE), HAL_NOT_SUPPORTED if the peer did not
+ *         advertise rate changes
  */
-hal_status_t flipper_receive_message(flipper_message_t *message, uint32_t timeout_ms);
+hal_status_t flipper_negotiate_baud(uint32_t max_baud);
 
 /**
- * Check if data available from Flipper
- * @return Number of bytes available, 0 if none
+ * Get the features both sides advertised in HELLO
+ * @return FLIPPER_CAP_x mask (0 before init or with an older peer)
  */
-uint32_t flipper_available(void);
+uint8_t flipper_get_peer_caps(void);
 
 /**
- * Deinitialize Flipper UART
- * @return HAL_OK on success
+ * Get the current line rate
+ * @return Baud rate in use
  */
-hal_status_t flipper_uart_deinit(void);
-
-#endif /* FLIPPER_UART_H */
-#ifndef FLIPPER_UART_H
-#define FLIPPER_UART_H
+uint32_t flipper_get_baud_rate(void);
 
 /**
- * Flipper Zero UART Communication Driver
- * Bidirectional serial protocol over UART1
+ * Get a pooled message to build in place
+ *
+ * payload points at FLIPPER_MSG_MAX_PAYLOAD bytes inside a pool buffer
+ * with room for the frame header and trailer around it, so sending it
+ * needs no copy. Release with flipper_message_release().
+ *
+ * @param[out] message Message to set up
+ * @param[in] cmd Command byte
+ * @return HAL_OK on success, HAL_BUSY if the pool is exhausted
  */
-
-#include "types.h"
-#include "config.h"
-
-/* ===== FLIPPER MESSAGE PROTOCOL ===== */
-
-#define FLIPPER_MSG_HEADER_SIZE     2
-#define FLIPPER_MSG_CMD_OFFSET      0
-#define FLIPPER_MSG_LEN_OFFSET      1
-#define FLIPPER_MSG_MAX_PAYLOAD     256
-
-typedef enum {
-    FLIPPER_CMD_ACK           = 0x00,
-    FLIPPER_CMD_NACK          = 0x01,
-    FLIPPER_CMD_HELLO         = 0x02,
-    FLIPPER_CMD_GOODBYE       = 0x03,
-    FLIPPER_CMD_REQUEST_STATE = 0x10,
-    FLIPPER_CMD_STATE_UPDATE  = 0x11,
-    FLIPPER_CMD_REQUEST_DATA  = 0x20,
-    FLIPPER_CMD_SEND_DATA     = 0x21,
-    FLIPPER_CMD_CONTROL       = 0x30,
-    FLIPPER_CMD_DEBUG         = 0xF0,
-} flipper_cmd_t;
-
-typedef struct {
-    uint8_t cmd;
-    uint16_t length;
-    uint8_t *payload;
-} flipper_message_t;
-
-/* ===== PUBLIC API ===== */
+hal_status_t flipper_message_alloc(flipper_message_t *message, uint8_t cmd);
 
 /**
- * Initialize Flipper UART communication
- * @return HAL_OK on success
+ * Return a pooled message (received or allocated) to the pool
+ * @param[in,out] message Message; payload and buf are cleared
  */
-hal_status_t flipper_uart_init(void);
+void flipper_message_release(flipper_message_t *message);
 
 /**
  * Send message to Flipper
+ *
+ * Pooled messages are framed in place; caller-owned payloads are copied
+ * into a pool buffer first. Anything queued with flipper_queue_message()
+ * goes out first, in the same write. The message is not released.
+ *
  * @param[in] message Pointer to message structure
  * @return HAL_OK on success
  */
 hal_status_t flipper_send_message(const flipper_message_t *message);
 
 /**
- * Receive message from Flipper (blocking)
- * @param[out] message Pointer to receive message
- * @param[in] timeout_ms Timeout in milliseconds
+ * Queue a message for a coalesced write
+ *
+ * Queued frames go out together in one write, FLIPPER_TX_FLUSH_MS after
+ * the first was queued, as soon as the batch is full, or ahead of the
+ * next flipper_send_message(). A queued STATE_UPDATE is replaced by a
+ * newer one rather than sent twice. The payload is copied; the message
+ * is not released.
+ *
+ * @param[in] message Pointer to message structure
+ * @return HAL_OK on success
+ */
+hal_status_t flipper_queue_message(const flipper_message_t *message);
+
+/**
+ * Write out queued messages now
  * @return HAL_OK on success
  */
+hal_status_t flipper_flush(void);
+
+/**
+ * Receive message from Flipper (blocking)
+ *
+ * Corrupted frames are skipped (and counted) rather than reported;
+ * the call keeps waiting for the next valid frame until the timeout.
+ *
+ * @param[out] message Pointer to receive message (release with flipper_message_release())
+ * @param[in] timeout_ms Timeout in milliseconds (0 = wait forever)
+ * @return HAL_OK on success, HAL_TIMEOUT if no valid frame arrived
+ */
 hal_status_t flipper_receive_message(flipper_message_t *message, uint32_t timeout_ms);
 
+/**
+ * Parse on the UART reader thread and offer each frame to a hook
+ *
+ * With a hook installed, frames are parsed as soon as the reader thread
+ * wakes, with no polling. Frames the hook declines queue up for
+ * flipper_receive_message().
+ *
+ * @param[in] hook Frame consumer (NULL to parse on the caller's thread again)
+ * @param[in] context Passed to the hook
+ * @return HAL_OK on success
+ */
+hal_status_t flipper_set_rx_hook(flipper_rx_hook_t hook, void *context);
+
 /**
  * Check if data available from Flipper
  * @return Number of bytes available, 0 if none
  */
 uint32_t flipper_available(void);
 
+/**
+ * Get receive-side framing statistics
+ * @param[out] stats Receives a snapshot of the counters
+ * @return HAL_OK on success
+ */
+hal_status_t flipper_get_link_stats(flipper_link_stats_t *stats);
+
+/**
+ * Get transmit batching statistics
+ * @param[out] stats Receives a snapshot of the counters
+ * @return HAL_OK on success
+ */
+hal_status_t flipper_get_tx_stats(flipper_tx_stats_t *stats);
+
 /**
  * Deinitialize Flipper UART
  * @return HAL_OK on success
@@ -1,134 +1,408 @@
-hal_status_t gpio_init(void)
+/**
+ * @file gpio.c
+ * @brief GPIO Hardware Abstraction Layer Implementation
+ * Orange Pi Zero 2W - Linux GPIO character device (v2 uAPI)
+ *
+ * Each header pin's line is requested once and the request fd is kept,
+ * so set/read are one ioctl on a cached fd: no sysfs export, no path or
+ * value formatting, no open/close per access.
+ *
+ * Optionally (gpio_set_backend(GPIO_BACKEND_MMIO)) the H618 PIO block is
+ * mapped into the process and set/read/toggle become a store or load on
+ * the port data register. Lines are still requested through the chardev,
+ * so the kernel keeps muxing, bias and ownership.
+ *
+ * Edge-triggered inputs (gpio_request_edge()) are line requests with edge
+ * detection and kernel debounce. Their fds sit in one epoll set; a
+ * dispatch pass reads the kernel-timestamped events and runs the pin's
+ * callback, either on the GPIO event thread or in the caller's own loop.
+ */
+
+#define LOG_MODULE LOG_MODULE_GPIO
+
+#include "gpio.h"
+#include "config.h"
+#include "log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/gpio.h>
+
+/* H618 PIO register layout */
+#define GPIO_PIO_PORTS          9       /* PA..PI */
+#define GPIO_PIO_PORT_STRIDE    0x24
+#define GPIO_PIO_DAT_OFFSET     0x10
+#define GPIO_PIO_DAT(base, port) \
+    ((base)[((port) * GPIO_PIO_PORT_STRIDE + GPIO_PIO_DAT_OFFSET) / sizeof(uint32_t)])
+
+#define GPIO_EVENT_BATCH        16      /* Kernel events pulled per read() */
+#define GPIO_EVENT_WAKE         0       /* epoll tag of the wake eventfd (pin 0 is never a GPIO) */
+
+/* ===== GPIO LINE STATE ===== */
+typedef struct {
+    int fd;                 /* Line request fd, -1 if not requested */
+    gpio_mode_t mode;
+    gpio_level_t level;     /* Last level driven (outputs) */
+    uint8_t bit;            /* Index within its line request */
+    uint8_t grouped;        /* Request shared with a gpio_group_t */
+    uint8_t port;           /* PIO port (line / 32) */
+    uint32_t mask;          /* Bit in the port data register */
+
+    /* Edge detection; callback is NULL for plain lines */
+    gpio_event_callback_t callback;
+    void *context;
+} gpio_line_state_t;
+
+typedef struct {
+    int chip_fd;
+    gpio_line_state_t lines[GPIO_HEADER_PINS + 1];     /* Indexed by header pin */
+
+    /* MMIO backend: pio is NULL while the chardev path is in use */
+    gpio_backend_t backend;
+    volatile uint32_t *pio;
+    void *pio_map;
+    size_t pio_map_size;
+    uint32_t shadow[GPIO_PIO_PORTS];            /* Last value written to each Pn_DAT */
+    atomic_flag port_lock[GPIO_PIO_PORTS];      /* Shadow update + store as one step */
+    bool mmio_deferred;                         /* GPIO_MMIO_DEFAULT: switch once a line can verify it */
+
+    /* Edge events */
+    int epoll_fd;
+    int wake_fd;
+    pthread_mutex_t event_lock;                 /* Edge registration vs. dispatch */
+    pthread_t event_thread;
+    atomic_bool event_running;
+} gpio_context_t;
+
+static const uint16_t gpio_header_lines[GPIO_HEADER_PINS + 1] = GPIO_HEADER_LINES;
+
+static gpio_context_t gpio_ctx = {
+    .chip_fd = -1,
+    .backend = GPIO_BACKEND_CHARDEV,
+    .epoll_fd = -1,
+    .wake_fd = -1,
+    .event_lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* ===== LOCAL FUNCTIONS ===== */
+
+/**
+ * Get the line state of a requested pin
+ * @return State, or NULL if the pin has no line request
+ */
+static gpio_line_state_t *gpio_get_line(uint32_t pin)
 {
-    LOG_INFO("Initializing GPIO subsystem");
-    /* Initialize GPIO subsystem */
-    /* On Orange Pi: usually handled by the kernel and accessible via sysfs */
-    return HAL_OK;
+    /* Before gpio_init() the fds are not yet marked unused */
+    if (gpio_ctx.chip_fd < 0 || pin > GPIO_HEADER_PINS || gpio_ctx.lines[pin].fd < 0) {
+        return NULL;
+    }
+    return &gpio_ctx.lines[pin];
 }
 
-hal_status_t gpio_configure(const gpio_config_t *config)
+/**
+ * Fill in the uAPI line configuration for a mode and pull
+ * @param[in] num_lines Lines in the request, all configured alike
+ */
+static void gpio_build_config(struct gpio_v2_line_config *line_config, gpio_mode_t mode,
+                              gpio_pull_t pull, uint32_t num_lines)
 {
-    if (config == NULL) {
-        LOG_ERROR("GPIO configuration failed: config is NULL");
-        return HAL_INVALID_PARAM;
-    }
+    memset(line_config, 0, sizeof(*line_config));
 
-    LOG_DEBUG("Configuring GPIO pin %u (mode=%d, pull=%d)", 
-             config->pin, config->mode, config->pull);
+    if (mode == GPIO_MODE_OUTPUT) {
+        line_config->flags = GPIO_V2_LINE_FLAG_OUTPUT;
 
-    /* Export the GPIO pin */
-    hal_status_t status = gpio_export(config->pin);
-    if (status != HAL_OK) {
-        LOG_ERROR("Failed to export GPIO pin %u", config->pin);
-        return status;
+        /* Start LOW rather than whatever the lines held */
+        line_config->num_attrs = 1;
+        line_config->attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+        line_config->attrs[0].attr.values = 0;
+        line_config->attrs[0].mask = (num_lines >= 64) ? ~0ull : ((1ull << num_lines) - 1);
+    } else {
+        line_config->flags = GPIO_V2_LINE_FLAG_INPUT;
     }
 
-    /* Set pin direction */
-    switch (config->mode) {
-        case GPIO_MODE_INPUT:
-            LOG_DEBUG("Set GPIO pin %u as INPUT", config->pin);
-            break;
-        case GPIO_MODE_OUTPUT:
-            LOG_DEBUG("Set GPIO pin %u as OUTPUT", config->pin);
+    switch (pull) {
+        case GPIO_PULL_UP:
+            line_config->flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
             break;
-        case GPIO_MODE_ALTERNATE:
-            LOG_DEBUG("Set GPIO pin %u as ALTERNATE function", config->pin);
+        case GPIO_PULL_DOWN:
+            line_config->flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN;
             break;
         default:
-            LOG_ERROR("Invalid GPIO mode: %d", config->mode);
-            return HAL_INVALID_PARAM;
+            line_config->flags |= GPIO_V2_LINE_FLAG_BIAS_DISABLED;
+            break;
     }
-
-    return HAL_OK;
 }
 
-hal_status_t gpio_set(uint32_t pin, gpio_level_t level)
+/**
+ * Set and clear bits of a port through the mapped data register
+ *
+ * The whole port is written from the shadow, so the store is a single
+ * 32-bit write and never reads back pin levels.
+ */
+static inline void gpio_mmio_update(uint8_t port, uint32_t set, uint32_t clear)
 {
-    if (level > GPIO_LEVEL_HIGH) {
-        LOG_ERROR("Invalid GPIO level: %d", level);
-        return HAL_INVALID_PARAM;
+    atomic_flag *lock = &gpio_ctx.port_lock[port];
+    while (atomic_flag_test_and_set_explicit(lock, memory_order_acquire)) {
+        /* Held for a few ns by another writer on this port */
     }
 
-    LOG_DEBUG("GPIO pin %u set to %s", pin, (level == GPIO_LEVEL_HIGH) ? "HIGH" : "LOW");
-    /* Set pin output level */
-    return HAL_OK;
+    uint32_t value = (gpio_ctx.shadow[port] & ~clear) | set;
+    gpio_ctx.shadow[port] = value;
+    GPIO_PIO_DAT(gpio_ctx.pio, port) = value;
+
+    atomic_flag_clear_explicit(lock, memory_order_release);
 }
 
-hal_status_t gpio_read(uint32_t pin, gpio_level_t *level)
+static inline void gpio_mmio_write(const gpio_line_state_t *line, gpio_level_t level)
 {
-    if (level == NULL) {
-        LOG_ERROR("GPIO read failed: level pointer is NULL");
-        return HAL_INVALID_PARAM;
+    if (level == GPIO_LEVEL_HIGH) {
+        gpio_mmio_update(line->port, line->mask, 0);
+    } else {
+        gpio_mmio_update(line->port, 0, line->mask);
+    }
+}
+
+/**
+ * Map the PIO block: /dev/gpiomem exposes just that block at offset 0,
+ * /dev/mem needs root and the physical address
+ */
+static hal_status_t gpio_mmio_map(void)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t size = (size_t)page_size;
+    off_t offset = 0;
+
+    int fd = open(GPIO_MEM_PATH, O_RDWR | O_SYNC | O_CLOEXEC);
+    if (fd < 0) {
+        fd = open("/dev/mem", O_RDWR | O_SYNC | O_CLOEXEC);
+        offset = (off_t)(GPIO_PIO_BASE & ~(uint32_t)(page_size - 1));
+    }
+    if (fd < 0) {
+        LOG_WARN("No access to %s or /dev/mem: %s", GPIO_MEM_PATH, strerror(errno));
+        return HAL_NOT_SUPPORTED;
     }
 
-    /* Read pin input level */
-    *level = GPIO_LEVEL_LOW;
-    LOG_DEBUG("GPIO pin %u read as %s", pin, (*level == GPIO_LEVEL_HIGH) ? "HIGH" : "LOW");
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+    close(fd);
+    if (map == MAP_FAILED) {
+        LOG_WARN("Failed to map the PIO block: %s", strerror(errno));
+        return HAL_NOT_SUPPORTED;
+    }
+
+    gpio_ctx.pio_map = map;
+    gpio_ctx.pio_map_size = size;
+    gpio_ctx.pio = (volatile uint32_t *)((uint8_t *)map + (offset ? (GPIO_PIO_BASE - (uint32_t)offset) : 0));
     return HAL_OK;
 }
 
-hal_status_t gpio_toggle(uint32_t pin)
+static void gpio_mmio_unmap(void)
 {
-    LOG_DEBUG("Toggling GPIO pin %u", pin);
-    
-    gpio_level_t current;
-    hal_status_t status = gpio_read(pin, &current);
-    if (status != HAL_OK) {
-        LOG_ERROR("Failed to read GPIO pin %u for toggle", pin);
-        return status;
+    if (gpio_ctx.pio_map != NULL) {
+        munmap(gpio_ctx.pio_map, gpio_ctx.pio_map_size);
     }
+    gpio_ctx.pio_map = NULL;
+    gpio_ctx.pio = NULL;
+}
 
-    gpio_level_t new_level = (current == GPIO_LEVEL_HIGH) ? GPIO_LEVEL_LOW : GPIO_LEVEL_HIGH;
-    return gpio_set(pin, new_level);
+/**
+ * Check the mapping against the kernel's view of every held line
+ * @return true if at least one line was compared and each reads the
+ *         same through both paths
+ */
+static bool gpio_mmio_verify(void)
+{
+    uint32_t checked = 0;
+
+    for (uint32_t pin = 0; pin <= GPIO_HEADER_PINS; pin++) {
+        gpio_line_state_t *line = &gpio_ctx.lines[pin];
+        if (line->fd < 0) {
+            continue;
+        }
+
+        struct gpio_v2_line_values values = { .bits = 0, .mask = 1ull << line->bit };
+        if (ioctl(line->fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0) {
+            return false;
+        }
+        bool mapped_high = (GPIO_PIO_DAT(gpio_ctx.pio, line->port) & line->mask) != 0;
+        if (mapped_high != ((values.bits & values.mask) != 0)) {
+            return false;
+        }
+        checked++;
+    }
+    return checked > 0;
 }
 
-hal_status_t gpio_deinit(void)
+/**
+ * Make the GPIO_MMIO_DEFAULT switch gpio_init() had to put off, now that
+ * a requested line can vouch for the mapping (tried once)
+ */
+static void gpio_mmio_switch_deferred(void)
 {
-    LOG_INFO("Deinitializing GPIO subsystem");
-    /* Deinitialize GPIO subsystem */
-    return HAL_OK;
+    if (gpio_ctx.mmio_deferred) {
+        gpio_ctx.mmio_deferred = false;
+        gpio_set_backend(GPIO_BACKEND_MMIO);    /* Stays on the chardev on failure */
+    }
 }
+
 /**
- * @file gpio.c
- * @brief GPIO Hardware Abstraction Layer Implementation
- * Orange Pi Zero 2W
+ * Record where a pin's line lives once it has been requested
  */
+static void gpio_bind_line(uint32_t pin, int fd, uint8_t bit, uint8_t grouped, gpio_mode_t mode)
+{
+    gpio_line_state_t *line = &gpio_ctx.lines[pin];
 
-#include "gpio.h"
-#include "log.h"
+    line->fd = fd;
+    line->bit = bit;
+    line->grouped = grouped;
+    line->mode = mode;
+    line->level = GPIO_LEVEL_LOW;
+    line->port = (uint8_t)(gpio_header_lines[pin] / 32);
+    line->mask = 1u << (gpio_header_lines[pin] % 32);
 
-/* Import system resources from /sys/class/gpio (Linux sysfs) */
-static const char *GPIO_SYSFS_PATH = "/sys/class/gpio";
+    /* The kernel just drove the output LOW behind the shadow's back */
+    if (gpio_ctx.pio != NULL && mode == GPIO_MODE_OUTPUT) {
+        gpio_mmio_write(line, GPIO_LEVEL_LOW);
+    }
+}
 
-/* ===== LOCAL FUNCTIONS ===== */
+/**
+ * Give a pin's line back to the kernel, with every line sharing its request
+ */
+static void gpio_release_line(uint32_t pin)
+{
+    int fd = gpio_ctx.lines[pin].fd;
+    if (fd < 0) {
+        return;
+    }
+
+    if (gpio_ctx.lines[pin].callback != NULL) {
+        /* Keep a dispatch pass from reading a closed (or reused) fd */
+        pthread_mutex_lock(&gpio_ctx.event_lock);
+        epoll_ctl(gpio_ctx.epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+        gpio_ctx.lines[pin].callback = NULL;
+        gpio_ctx.lines[pin].context = NULL;
+        close(fd);
+        gpio_ctx.lines[pin].fd = -1;
+        pthread_mutex_unlock(&gpio_ctx.event_lock);
+        return;
+    }
+
+    close(fd);
+    for (uint32_t other = 0; other <= GPIO_HEADER_PINS; other++) {
+        if (gpio_ctx.lines[other].fd == fd) {
+            gpio_ctx.lines[other].fd = -1;
+            gpio_ctx.lines[other].grouped = 0;
+        }
+    }
+}
 
 /**
- * Export GPIO pin via sysfs
+ * Validate a pin number for line requests
  */
-static hal_status_t gpio_export(uint32_t pin)
+static hal_status_t gpio_check_pin(uint32_t pin)
 {
-    LOG_DEBUG("Exporting GPIO pin %u", pin);
-    /* This implementation assumes sysfs GPIO access on Linux */
-    /* For actual deployment, replace with direct register access */
+    if (pin == 0 || pin > GPIO_HEADER_PINS) {
+        LOG_ERROR("Invalid GPIO pin: %u", pin);
+        return HAL_INVALID_PARAM;
+    }
+    if (gpio_header_lines[pin] == GPIO_LINE_NONE) {
+        LOG_ERROR("Header pin %u is not a GPIO", pin);
+        return HAL_NOT_SUPPORTED;
+    }
     return HAL_OK;
 }
 
 /**
- * Unexport GPIO pin via sysfs
+ * Read and deliver the pending events of one edge line
  */
-static hal_status_t gpio_unexport(uint32_t pin)
+static void gpio_event_drain(uint32_t pin)
 {
-    LOG_DEBUG("Unexporting GPIO pin %u", pin);
-    return HAL_OK;
+    struct gpio_v2_line_event raw[GPIO_EVENT_BATCH];
+
+    for (;;) {
+        pthread_mutex_lock(&gpio_ctx.event_lock);
+        gpio_line_state_t *line = &gpio_ctx.lines[pin];
+        gpio_event_callback_t callback = line->callback;
+        void *context = line->context;
+        ssize_t got = (callback != NULL) ? read(line->fd, raw, sizeof(raw)) : -1;
+        pthread_mutex_unlock(&gpio_ctx.event_lock);
+
+        if (got < (ssize_t)sizeof(raw[0])) {
+            return;     /* EAGAIN, or released since epoll_wait() */
+        }
+
+        /* Callbacks run unlocked so they may release or re-request edges */
+        for (size_t i = 0; i < (size_t)got / sizeof(raw[0]); i++) {
+            gpio_event_t event = {
+                .pin = pin,
+                .edge = (raw[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE) ? GPIO_EDGE_RISING
+                                                                      : GPIO_EDGE_FALLING,
+                .timestamp_ns = raw[i].timestamp_ns,
+                .seqno = raw[i].line_seqno,
+            };
+            callback(&event, context);
+        }
+    }
+}
+
+/**
+ * Event thread: dispatch until gpio_event_stop()
+ */
+static void *gpio_event_thread(void *arg)
+{
+    (void)arg;
+
+    while (atomic_load(&gpio_ctx.event_running)) {
+        hal_status_t status = gpio_event_dispatch(-1);
+        if (status != HAL_OK && status != HAL_TIMEOUT) {
+            break;
+        }
+    }
+    return NULL;
 }
 
 /* ===== PUBLIC IMPLEMENTATION ===== */
 
 hal_status_t gpio_init(void)
 {
+    if (gpio_ctx.chip_fd >= 0) {
+        return HAL_OK;
+    }
+
     LOG_INFO("Initializing GPIO subsystem");
-    /* Initialize GPIO subsystem */
-    /* On Orange Pi: usually handled by the kernel and accessible via sysfs */
+
+    for (uint32_t pin = 0; pin <= GPIO_HEADER_PINS; pin++) {
+        gpio_ctx.lines[pin].fd = -1;
+    }
+
+    gpio_ctx.chip_fd = open(GPIO_CHIP_PATH, O_RDWR | O_CLOEXEC);
+    if (gpio_ctx.chip_fd < 0) {
+        LOG_ERROR("Failed to open %s: %s", GPIO_CHIP_PATH, strerror(errno));
+        return HAL_ERROR;
+    }
+
+    gpio_ctx.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    gpio_ctx.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (gpio_ctx.epoll_fd < 0 || gpio_ctx.wake_fd < 0) {
+        gpio_deinit();
+        return HAL_ERROR;
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN };
+    ev.data.u32 = GPIO_EVENT_WAKE;
+    epoll_ctl(gpio_ctx.epoll_fd, EPOLL_CTL_ADD, gpio_ctx.wake_fd, &ev);
+
+#if GPIO_MMIO_DEFAULT
+    /* Nothing to verify the mapping against yet; see gpio_mmio_switch_deferred() */
+    gpio_ctx.mmio_deferred = true;
+#endif
     return HAL_OK;
 }
 
@@ -138,33 +412,65 @@ hal_status_t gpio_configure(const gpio_config_t *config)
         LOG_ERROR("GPIO configuration failed: config is NULL");
         return HAL_INVALID_PARAM;
     }
+    if (config->mode > GPIO_MODE_ALTERNATE) {
+        LOG_ERROR("Invalid GPIO mode: %d", config->mode);
+        return HAL_INVALID_PARAM;
+    }
+    hal_status_t status = gpio_check_pin(config->pin);
+    if (status != HAL_OK) {
+        return status;
+    }
+    if (gpio_ctx.chip_fd < 0) {
+        return HAL_NOT_READY;
+    }
+    if (gpio_ctx.lines[config->pin].grouped) {
+        LOG_ERROR("GPIO pin %u belongs to a line group", config->pin);
+        return HAL_BUSY;
+    }
+    if (gpio_ctx.lines[config->pin].callback != NULL) {
+        /* Drop edge detection: re-request as a plain line */
+        gpio_release_line(config->pin);
+    }
 
-    LOG_DEBUG("Configuring GPIO pin %u (mode=%d, pull=%d)", 
+    LOG_DEBUG("Configuring GPIO pin %u (mode=%d, pull=%d)",
              config->pin, config->mode, config->pull);
 
-    /* Export the GPIO pin */
-    hal_status_t status = gpio_export(config->pin);
-    if (status != HAL_OK) {
-        LOG_ERROR("Failed to export GPIO pin %u", config->pin);
-        return status;
+    gpio_line_state_t *line = &gpio_ctx.lines[config->pin];
+
+    /* Pin muxed to a peripheral: the kernel driver owns it */
+    if (config->mode == GPIO_MODE_ALTERNATE) {
+        gpio_release_line(config->pin);
+        line->mode = GPIO_MODE_ALTERNATE;
+        return HAL_OK;
     }
 
-    /* Set pin direction */
-    switch (config->mode) {
-        case GPIO_MODE_INPUT:
-            LOG_DEBUG("Set GPIO pin %u as INPUT", config->pin);
-            break;
-        case GPIO_MODE_OUTPUT:
-            LOG_DEBUG("Set GPIO pin %u as OUTPUT", config->pin);
-            break;
-        case GPIO_MODE_ALTERNATE:
-            LOG_DEBUG("Set GPIO pin %u as ALTERNATE function", config->pin);
-            break;
-        default:
-            LOG_ERROR("Invalid GPIO mode: %d", config->mode);
-            return HAL_INVALID_PARAM;
+    struct gpio_v2_line_config line_config;
+    gpio_build_config(&line_config, config->mode, config->pull, 1);
+
+    if (line->fd >= 0) {
+        /* Already held: change direction/bias in place */
+        if (ioctl(line->fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &line_config) < 0) {
+            LOG_ERROR("Failed to reconfigure GPIO pin %u: %s", config->pin, strerror(errno));
+            return HAL_ERROR;
+        }
+    } else {
+        struct gpio_v2_line_request request;
+        memset(&request, 0, sizeof(request));
+        request.offsets[0] = gpio_header_lines[config->pin];
+        request.num_lines = 1;
+        request.config = line_config;
+        strncpy(request.consumer, GPIO_CONSUMER, sizeof(request.consumer) - 1);
+
+        if (ioctl(gpio_ctx.chip_fd, GPIO_V2_GET_LINE_IOCTL, &request) < 0) {
+            LOG_ERROR("Failed to request GPIO pin %u (line %u): %s",
+                      config->pin, gpio_header_lines[config->pin], strerror(errno));
+            return (errno == EBUSY) ? HAL_BUSY : HAL_ERROR;
+        }
+        line->fd = request.fd;
     }
 
+    gpio_bind_line(config->pin, line->fd, 0, 0, config->mode);
+    gpio_mmio_switch_deferred();
     return HAL_OK;
 }
 
@@ -175,8 +481,26 @@ hal_status_t gpio_set(uint32_t pin, gpio_level_t level)
         return HAL_INVALID_PARAM;
     }
 
-    LOG_DEBUG("GPIO pin %u set to %s", pin, (level == GPIO_LEVEL_HIGH) ? "HIGH" : "LOW");
-    /* Set pin output level */
+    gpio_line_state_t *line = gpio_get_line(pin);
+    if (line == NULL || line->mode != GPIO_MODE_OUTPUT) {
+        return HAL_ERROR;
+    }
+
+    if (gpio_ctx.pio != NULL) {
+        gpio_mmio_write(line, level);
+        line->level = level;
+        return HAL_OK;
+    }
+
+    struct gpio_v2_line_values values = {
+        .bits = (uint64_t)level << line->bit,
+        .mask = 1ull << line->bit,
+    };
+    if (ioctl(line->fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values) < 0) {
+        return HAL_ERROR;
+    }
+
+    line->level = level;
     return HAL_OK;
 }
 
@@ -187,30 +511,420 @@ hal_status_t gpio_read(uint32_t pin, gpio_level_t *level)
         return HAL_INVALID_PARAM;
     }
 
-    /* Read pin input level */
-    *level = GPIO_LEVEL_LOW;
-    LOG_DEBUG("GPIO pin %u read as %s", pin, (*level == GPIO_LEVEL_HIGH) ? "HIGH" : "LOW");
+    gpio_line_state_t *line = gpio_get_line(pin);
+    if (line == NULL) {
+        return HAL_ERROR;
+    }
+
+    if (gpio_ctx.pio != NULL) {
+        *level = (GPIO_PIO_DAT(gpio_ctx.pio, line->port) & line->mask) ? GPIO_LEVEL_HIGH : GPIO_LEVEL_LOW;
+        return HAL_OK;
+    }
+
+    struct gpio_v2_line_values values = {
+        .bits = 0,
+        .mask = 1ull << line->bit,
+    };
+    if (ioctl(line->fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0) {
+        return HAL_ERROR;
+    }
+
+    *level = (values.bits & values.mask) ? GPIO_LEVEL_HIGH : GPIO_LEVEL_LOW;
     return HAL_OK;
 }
 
 hal_status_t gpio_toggle(uint32_t pin)
 {
-    LOG_DEBUG("Toggling GPIO pin %u", pin);
-    
-    gpio_level_t current;
-    hal_status_t status = gpio_read(pin, &current);
+    gpio_line_state_t *line = gpio_get_line(pin);
+    if (line == NULL || line->mode != GPIO_MODE_OUTPUT) {
+        return HAL_ERROR;
+    }
+
+    return gpio_set(pin, (line->level == GPIO_LEVEL_HIGH) ? GPIO_LEVEL_LOW : GPIO_LEVEL_HIGH);
+}
+
+hal_status_t gpio_group_request(gpio_group_t *group, const uint32_t *pins, uint8_t count,
+                                gpio_mode_t mode, gpio_pull_t pull)
+{
+    if (group == NULL || pins == NULL || count == 0 || count > GPIO_GROUP_MAX_PINS) {
+        return HAL_INVALID_PARAM;
+    }
+    if (mode != GPIO_MODE_INPUT && mode != GPIO_MODE_OUTPUT) {
+        return HAL_INVALID_PARAM;
+    }
+    if (gpio_ctx.chip_fd < 0) {
+        return HAL_NOT_READY;
+    }
+
+    struct gpio_v2_line_request request;
+    memset(&request, 0, sizeof(request));
+
+    for (uint8_t i = 0; i < count; i++) {
+        hal_status_t status = gpio_check_pin(pins[i]);
+        if (status != HAL_OK) {
+            return status;
+        }
+        if (gpio_ctx.lines[pins[i]].fd >= 0) {
+            LOG_ERROR("GPIO pin %u is already requested", pins[i]);
+            return HAL_BUSY;
+        }
+        for (uint8_t j = 0; j < i; j++) {
+            if (pins[j] == pins[i]) {
+                return HAL_INVALID_PARAM;
+            }
+        }
+        request.offsets[i] = gpio_header_lines[pins[i]];
+    }
+
+    request.num_lines = count;
+    gpio_build_config(&request.config, mode, pull, count);
+    strncpy(request.consumer, GPIO_CONSUMER, sizeof(request.consumer) - 1);
+
+    if (ioctl(gpio_ctx.chip_fd, GPIO_V2_GET_LINE_IOCTL, &request) < 0) {
+        LOG_ERROR("Failed to request a %u-line GPIO group: %s", count, strerror(errno));
+        return (errno == EBUSY) ? HAL_BUSY : HAL_ERROR;
+    }
+
+    group->fd = request.fd;
+    group->count = count;
+    group->mode = mode;
+    for (uint8_t i = 0; i < count; i++) {
+        group->pins[i] = pins[i];
+        gpio_bind_line(pins[i], request.fd, i, 1, mode);
+    }
+    gpio_mmio_switch_deferred();
+    return HAL_OK;
+}
+
+hal_status_t gpio_set_mask(gpio_group_t *group, uint32_t mask, uint32_t values)
+{
+    if (group == NULL || group->fd < 0 || group->mode != GPIO_MODE_OUTPUT) {
+        return HAL_INVALID_PARAM;
+    }
+
+    if (group->count < 32) {
+        mask &= (1u << group->count) - 1;
+    }
+    if (mask == 0) {
+        return HAL_OK;
+    }
+
+    if (gpio_ctx.pio != NULL) {
+        /* One store per port touched */
+        uint32_t set[GPIO_PIO_PORTS] = { 0 };
+        uint32_t clear[GPIO_PIO_PORTS] = { 0 };
+        uint16_t touched = 0;
+
+        for (uint8_t i = 0; i < group->count; i++) {
+            if (!(mask & (1u << i))) {
+                continue;
+            }
+            const gpio_line_state_t *line = &gpio_ctx.lines[group->pins[i]];
+            if (values & (1u << i)) {
+                set[line->port] |= line->mask;
+            } else {
+                clear[line->port] |= line->mask;
+            }
+            touched |= (uint16_t)(1u << line->port);
+        }
+        for (uint8_t port = 0; port < GPIO_PIO_PORTS; port++) {
+            if (touched & (1u << port)) {
+                gpio_mmio_update(port, set[port], clear[port]);
+            }
+        }
+    } else {
+        struct gpio_v2_line_values line_values = {
+            .bits = values & mask,
+            .mask = mask,
+        };
+        if (ioctl(group->fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &line_values) < 0) {
+            return HAL_ERROR;
+        }
+    }
+
+    for (uint8_t i = 0; i < group->count; i++) {
+        if (mask & (1u << i)) {
+            gpio_ctx.lines[group->pins[i]].level = (values & (1u << i)) ? GPIO_LEVEL_HIGH : GPIO_LEVEL_LOW;
+        }
+    }
+    return HAL_OK;
+}
+
+hal_status_t gpio_read_mask(gpio_group_t *group, uint32_t mask, uint32_t *values)
+{
+    if (group == NULL || group->fd < 0 || values == NULL) {
+        return HAL_INVALID_PARAM;
+    }
+
+    if (group->count < 32) {
+        mask &= (1u << group->count) - 1;
+    }
+
+    if (gpio_ctx.pio != NULL) {
+        /* One load per port touched */
+        uint32_t port_value[GPIO_PIO_PORTS];
+        uint16_t sampled = 0;
+        uint32_t result = 0;
+
+        for (uint8_t i = 0; i < group->count; i++) {
+            if (!(mask & (1u << i))) {
+                continue;
+            }
+            const gpio_line_state_t *line = &gpio_ctx.lines[group->pins[i]];
+            if (!(sampled & (1u << line->port))) {
+                port_value[line->port] = GPIO_PIO_DAT(gpio_ctx.pio, line->port);
+                sampled |= (uint16_t)(1u << line->port);
+            }
+            if (port_value[line->port] & line->mask) {
+                result |= 1u << i;
+            }
+        }
+        *values = result;
+        return HAL_OK;
+    }
+
+    struct gpio_v2_line_values line_values = {
+        .bits = 0,
+        .mask = mask,
+    };
+    if (ioctl(group->fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &line_values) < 0) {
+        return HAL_ERROR;
+    }
+
+    *values = (uint32_t)(line_values.bits & mask);
+    return HAL_OK;
+}
+
+hal_status_t gpio_group_release(gpio_group_t *group)
+{
+    if (group == NULL) {
+        return HAL_INVALID_PARAM;
+    }
+
+    /* gpio_deinit() may already have closed it */
+    if (group->fd >= 0 && group->count > 0 && gpio_ctx.lines[group->pins[0]].fd == group->fd) {
+        gpio_release_line(group->pins[0]);
+    }
+    group->fd = -1;
+    group->count = 0;
+    return HAL_OK;
+}
+
+hal_status_t gpio_request_edge(uint32_t pin, gpio_edge_t edge, gpio_pull_t pull, uint32_t debounce_us,
+                               gpio_event_callback_t callback, void *context)
+{
+    if (callback == NULL || edge < GPIO_EDGE_RISING || edge > GPIO_EDGE_BOTH) {
+        return HAL_INVALID_PARAM;
+    }
+    hal_status_t status = gpio_check_pin(pin);
+    if (status != HAL_OK) {
+        return status;
+    }
+    if (gpio_ctx.chip_fd < 0) {
+        return HAL_NOT_READY;
+    }
+    if (gpio_ctx.lines[pin].grouped) {
+        return HAL_BUSY;
+    }
+
+    /* Edge flags cannot be added to a held line in place on all kernels */
+    gpio_release_line(pin);
+
+    struct gpio_v2_line_request request;
+    memset(&request, 0, sizeof(request));
+    request.offsets[0] = gpio_header_lines[pin];
+    request.num_lines = 1;
+    gpio_build_config(&request.config, GPIO_MODE_INPUT, pull, 1);
+    if (edge & GPIO_EDGE_RISING) {
+        request.config.flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
+    }
+    if (edge & GPIO_EDGE_FALLING) {
+        request.config.flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    }
+    if (debounce_us > 0) {
+        uint32_t attr = request.config.num_attrs++;
+        request.config.attrs[attr].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
+        request.config.attrs[attr].attr.debounce_period_us = debounce_us;
+        request.config.attrs[attr].mask = 1;
+    }
+    request.event_buffer_size = GPIO_EVENT_BATCH;
+    strncpy(request.consumer, GPIO_CONSUMER, sizeof(request.consumer) - 1);
+
+    if (ioctl(gpio_ctx.chip_fd, GPIO_V2_GET_LINE_IOCTL, &request) < 0) {
+        LOG_ERROR("Failed to request edge events on GPIO pin %u: %s", pin, strerror(errno));
+        return (errno == EBUSY) ? HAL_BUSY : HAL_ERROR;
+    }
+
+    /* Dispatch drains until EAGAIN */
+    fcntl(request.fd, F_SETFL, fcntl(request.fd, F_GETFL) | O_NONBLOCK);
+
+    pthread_mutex_lock(&gpio_ctx.event_lock);
+    gpio_bind_line(pin, request.fd, 0, 0, GPIO_MODE_INPUT);
+    gpio_ctx.lines[pin].callback = callback;
+    gpio_ctx.lines[pin].context = context;
+
+    struct epoll_event ev = { .events = EPOLLIN };
+    ev.data.u32 = pin;
+    epoll_ctl(gpio_ctx.epoll_fd, EPOLL_CTL_ADD, request.fd, &ev);
+    pthread_mutex_unlock(&gpio_ctx.event_lock);
+
+    LOG_DEBUG("GPIO pin %u edge events on (edge=%d, debounce=%u us)", pin, edge, debounce_us);
+    gpio_mmio_switch_deferred();
+    return HAL_OK;
+}
+
+hal_status_t gpio_release_edge(uint32_t pin)
+{
+    if (pin == 0 || pin > GPIO_HEADER_PINS) {
+        return HAL_INVALID_PARAM;
+    }
+    if (gpio_ctx.lines[pin].callback == NULL) {
+        return HAL_NOT_READY;
+    }
+
+    gpio_release_line(pin);
+    return HAL_OK;
+}
+
+int gpio_event_fd(void)
+{
+    return gpio_ctx.epoll_fd;
+}
+
+hal_status_t gpio_event_dispatch(int timeout_ms)
+{
+    if (gpio_ctx.epoll_fd < 0) {
+        return HAL_NOT_READY;
+    }
+
+    struct epoll_event events[GPIO_EVENT_BATCH];
+    int n = epoll_wait(gpio_ctx.epoll_fd, events, GPIO_EVENT_BATCH, timeout_ms);
+    if (n < 0) {
+        if (errno == EINTR) {
+            return HAL_TIMEOUT;
+        }
+        LOG_ERROR("GPIO epoll_wait failed: %s", strerror(errno));
+        return HAL_ERROR;
+    }
+    if (n == 0) {
+        return HAL_TIMEOUT;
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (events[i].data.u32 == GPIO_EVENT_WAKE) {
+            continue;  /* gpio_event_stop(); the thread's loop condition handles it */
+        }
+        gpio_event_drain(events[i].data.u32);
+    }
+    return HAL_OK;
+}
+
+hal_status_t gpio_event_start(void)
+{
+    if (gpio_ctx.epoll_fd < 0) {
+        return HAL_NOT_READY;
+    }
+    if (atomic_load(&gpio_ctx.event_running)) {
+        return HAL_OK;
+    }
+
+    atomic_store(&gpio_ctx.event_running, true);
+    if (pthread_create(&gpio_ctx.event_thread, NULL, gpio_event_thread, NULL) != 0) {
+        atomic_store(&gpio_ctx.event_running, false);
+        return HAL_ERROR;
+    }
+    return HAL_OK;
+}
+
+hal_status_t gpio_event_stop(void)
+{
+    if (!atomic_load(&gpio_ctx.event_running)) {
+        return HAL_OK;
+    }
+
+    atomic_store(&gpio_ctx.event_running, false);
+
+    /* The wake fd stays readable, so every waiter in the set returns */
+    uint64_t one = 1;
+    (void)!write(gpio_ctx.wake_fd, &one, sizeof(one));
+    pthread_join(gpio_ctx.event_thread, NULL);
+
+    uint64_t drain;
+    (void)!read(gpio_ctx.wake_fd, &drain, sizeof(drain));
+    return HAL_OK;
+}
+
+hal_status_t gpio_set_backend(gpio_backend_t backend)
+{
+    if (backend != GPIO_BACKEND_CHARDEV && backend != GPIO_BACKEND_MMIO) {
+        return HAL_INVALID_PARAM;
+    }
+    if (gpio_ctx.chip_fd < 0) {
+        return HAL_NOT_READY;
+    }
+    if (backend == GPIO_BACKEND_CHARDEV) {
+        gpio_ctx.mmio_deferred = false;
+    }
+    if (backend == gpio_ctx.backend) {
+        return HAL_OK;
+    }
+
+    if (backend == GPIO_BACKEND_CHARDEV) {
+        gpio_mmio_unmap();
+        gpio_ctx.backend = GPIO_BACKEND_CHARDEV;
+        return HAL_OK;
+    }
+
+    hal_status_t status = gpio_mmio_map();
     if (status != HAL_OK) {
-        LOG_ERROR("Failed to read GPIO pin %u for toggle", pin);
         return status;
     }
+    if (!gpio_mmio_verify()) {
+        LOG_WARN("Mapped PIO registers disagree with %s (or no line requested to check); "
+                 "staying on the chardev backend", GPIO_CHIP_PATH);
+        gpio_mmio_unmap();
+        return HAL_NOT_SUPPORTED;
+    }
+
+    for (uint32_t port = 0; port < GPIO_PIO_PORTS; port++) {
+        atomic_flag_clear(&gpio_ctx.port_lock[port]);
+        gpio_ctx.shadow[port] = GPIO_PIO_DAT(gpio_ctx.pio, port);
+    }
+    gpio_ctx.backend = GPIO_BACKEND_MMIO;
+    LOG_INFO("GPIO using memory-mapped PIO registers");
+    return HAL_OK;
+}
 
-    gpio_level_t new_level = (current == GPIO_LEVEL_HIGH) ? GPIO_LEVEL_LOW : GPIO_LEVEL_HIGH;
-    return gpio_set(pin, new_level);
+gpio_backend_t gpio_get_backend(void)
+{
+    return gpio_ctx.backend;
 }
 
 hal_status_t gpio_deinit(void)
 {
+    if (gpio_ctx.chip_fd < 0) {
+        return HAL_OK;
+    }
+
     LOG_INFO("Deinitializing GPIO subsystem");
-    /* Deinitialize GPIO subsystem */
+
+    gpio_event_stop();
+    gpio_mmio_unmap();
+    gpio_ctx.backend = GPIO_BACKEND_CHARDEV;
+    gpio_ctx.mmio_deferred = false;
+
+    for (uint32_t pin = 0; pin <= GPIO_HEADER_PINS; pin++) {
+        gpio_release_line(pin);
+    }
+    if (gpio_ctx.epoll_fd >= 0) {
+        close(gpio_ctx.epoll_fd);
+        gpio_ctx.epoll_fd = -1;
+    }
+    if (gpio_ctx.wake_fd >= 0) {
+        close(gpio_ctx.wake_fd);
+        gpio_ctx.wake_fd = -1;
+    }
+    close(gpio_ctx.chip_fd);
+    gpio_ctx.chip_fd = -1;
     return HAL_OK;
 }
@@ -7,6 +7,11 @@
  * 
  * Provides GPIO pin control interface for digital I/O operations.
  * Supports pin configuration, output control, and input reading.
+ *
+ * Pins are numbered by their position on the 40-pin header (see
+ * pinout.h). The backend is the Linux GPIO character device (v2 uAPI):
+ * each pin's line is requested once by gpio_configure() and its request
+ * fd is kept, so gpio_set() and gpio_read() are a single ioctl.
  * 
  * @defgroup GPIO GPIO Pin Control
  * @{
@@ -14,16 +19,51 @@
 
 #include "types.h"
 
+/* ===== BACKENDS ===== */
+typedef enum {
+    GPIO_BACKEND_CHARDEV = 0,   /* One ioctl per access on /dev/gpiochipN */
+    GPIO_BACKEND_MMIO = 1,      /* Direct PIO data register access (root or /dev/gpiomem) */
+} gpio_backend_t;
+
+/* ===== LINE GROUPS ===== */
+#define GPIO_GROUP_MAX_PINS     32
+
+/**
+ * Pins requested together; bit i of a mask refers to pins[i]
+ */
+typedef struct {
+    int fd;                                 /* Multi-line request, -1 when released */
+    uint8_t count;
+    gpio_mode_t mode;
+    uint32_t pins[GPIO_GROUP_MAX_PINS];     /* Header pin numbers */
+} gpio_group_t;
+
+/* ===== EDGE EVENTS ===== */
+typedef enum {
+    GPIO_EDGE_RISING = 1,
+    GPIO_EDGE_FALLING = 2,
+    GPIO_EDGE_BOTH = 3,
+} gpio_edge_t;
+
+typedef struct {
+    uint32_t pin;               /* Header pin */
+    gpio_edge_t edge;           /* GPIO_EDGE_RISING or GPIO_EDGE_FALLING */
+    uint64_t timestamp_ns;      /* Kernel CLOCK_MONOTONIC time of the edge */
+    uint32_t seqno;             /* Per-line event count; gaps mean overflowed events */
+} gpio_event_t;
+
+typedef void (*gpio_event_callback_t)(const gpio_event_t *event, void *context);
+
 /* ===== PUBLIC API ===== */
 
 /**
  * @brief Initialize GPIO subsystem
  * 
- * Prepares the GPIO module for operation. Must be called once
- * before any other GPIO operations.
+ * Opens GPIO_CHIP_PATH. Must be called once before any other
+ * GPIO operations.
  * 
  * @return @ref HAL_OK on success
- * @return @ref HAL_ERROR if initialization fails
+ * @return @ref HAL_ERROR if the GPIO chip cannot be opened
  */
 hal_status_t gpio_init(void);
 
@@ -32,6 +72,11 @@ hal_status_t gpio_init(void);
  * 
  * Sets up a GPIO pin with specified mode (input/output),
  * pull configuration, and other parameters.
+ *
+ * The first call for a pin requests its line from the kernel; later
+ * calls reconfigure the held request. Outputs start LOW.
+ * GPIO_MODE_ALTERNATE releases the line to whichever kernel driver the
+ * device tree assigns the pin to.
  * 
  * @param[in] config GPIO configuration structure containing:
  *   - pin: Pin number to configure
@@ -40,6 +85,7 @@ hal_status_t gpio_init(void);
  * 
  * @return @ref HAL_OK if configuration successful
  * @return @ref HAL_INVALID_PARAM if config is NULL or invalid
+ * @return @ref HAL_NOT_SUPPORTED if the header pin is not a GPIO
  * @return @ref HAL_ERROR if hardware configuration fails
  * 
  * @example
@@ -97,7 +143,8 @@ hal_status_t gpio_read(uint32_t pin, gpio_level_t *level);
 /**
  * @brief Toggle GPIO pin output level
  * 
- * Switches the output level from HIGH to LOW or vice versa.
+ * Switches the output level from HIGH to LOW or vice versa, from
+ * the last level set (no read-back).
  * Pin must be configured as output before calling this function.
  * 
  * @param[in] pin GPIO pin number
@@ -108,131 +155,186 @@ hal_status_t gpio_read(uint32_t pin, gpio_level_t *level);
 hal_status_t gpio_toggle(uint32_t pin);
 
 /**
- * @brief Deinitialize GPIO subsystem
+ * @brief Request several pins as one line group
  * 
- * Releases GPIO resources and prepares for shutdown.
- * No GPIO operations are valid after calling this function.
+ * All pins share one kernel line request and one mode/pull setting, so
+ * gpio_set_mask() and gpio_read_mask() cover any subset of them in a
+ * single operation. The pins also keep working with gpio_set(),
+ * gpio_read() and gpio_toggle(); gpio_configure() refuses them until
+ * the group is released.
+ * 
+ * @param[out] group Group handle to fill in
+ * @param[in] pins Header pin numbers; bit i of later masks is pins[i]
+ * @param[in] count Number of pins (1 .. GPIO_GROUP_MAX_PINS)
+ * @param[in] mode GPIO_MODE_INPUT or GPIO_MODE_OUTPUT (outputs start LOW)
+ * @param[in] pull Pull configuration applied to every pin
  * 
  * @return @ref HAL_OK on success
+ * @return @ref HAL_BUSY if a pin is already requested
+ * @return @ref HAL_INVALID_PARAM for bad or repeated pins
  */
-hal_status_t gpio_deinit(void);
-
-/** @} */ // end of GPIO group
-
-#endif /* GPIO_H */
-#ifndef GPIO_H
-#define GPIO_H
+hal_status_t gpio_group_request(gpio_group_t *group, const uint32_t *pins, uint8_t count,
+                                gpio_mode_t mode, gpio_pull_t pull);
 
 /**
- * @file gpio.h
- * @brief GPIO Hardware Abstraction Layer for Orange Pi Zero 2W
+ * @brief Drive several outputs of a group at once
  * 
- * Provides GPIO pin control interface for digital I/O operations.
- * Supports pin configuration, output control, and input reading.
+ * Lines in mask take the matching bit of values; the rest keep their
+ * level. With the chardev backend this is one ioctl and the kernel
+ * applies all lines together; with GPIO_BACKEND_MMIO it is one store
+ * per PIO port involved.
  * 
- * @defgroup GPIO GPIO Pin Control
- * @{
+ * @param[in] group Output group
+ * @param[in] mask Lines to update (bit i = group->pins[i])
+ * @param[in] values New levels for those lines
+ * 
+ * @return @ref HAL_OK on success
+ * @return @ref HAL_INVALID_PARAM if the group is not an output group
+ * 
+ * @example
+ * @code
+ * uint32_t pins[] = { GPIO_TFT_DC, GPIO_TFT_RST };
+ * gpio_group_t tft;
+ * gpio_group_request(&tft, pins, 2, GPIO_MODE_OUTPUT, GPIO_PULL_NONE);
+ * gpio_set_mask(&tft, 0x3, 0x2);      // DC low, RST high in one call
+ * @endcode
  */
-
-#include "types.h"
-
-/* ===== PUBLIC API ===== */
+hal_status_t gpio_set_mask(gpio_group_t *group, uint32_t mask, uint32_t values);
 
 /**
- * @brief Initialize GPIO subsystem
+ * @brief Sample several lines of a group at once
  * 
- * Prepares the GPIO module for operation. Must be called once
- * before any other GPIO operations.
+ * @param[in] group Line group
+ * @param[in] mask Lines to sample (bit i = group->pins[i])
+ * @param[out] values Levels of the sampled lines, 0 elsewhere
  * 
  * @return @ref HAL_OK on success
- * @return @ref HAL_ERROR if initialization fails
  */
-hal_status_t gpio_init(void);
+hal_status_t gpio_read_mask(gpio_group_t *group, uint32_t mask, uint32_t *values);
 
 /**
- * @brief Configure a GPIO pin
+ * @brief Release a line group
  * 
- * Sets up a GPIO pin with specified mode (input/output),
- * pull configuration, and other parameters.
+ * @param[in,out] group Group to release
  * 
- * @param[in] config GPIO configuration structure containing:
- *   - pin: Pin number to configure
- *   - mode: GPIO_MODE_INPUT, GPIO_MODE_OUTPUT, or GPIO_MODE_ALTERNATE
- *   - pull: Pull-up, pull-down, or no pull
+ * @return @ref HAL_OK on success
+ */
+hal_status_t gpio_group_release(gpio_group_t *group);
+
+/**
+ * @brief Watch an input pin for edges
+ * 
+ * The pin is requested as an input with kernel edge detection and, if
+ * debounce_us is non-zero, kernel debounce. Each edge is timestamped by
+ * the kernel when it happens and delivered to callback by
+ * gpio_event_dispatch(), so nothing polls while the line is quiet.
+ * gpio_read() keeps working on the pin; gpio_configure() turns it back
+ * into a plain line.
+ * 
+ * @param[in] pin Header pin number
+ * @param[in] edge Edges to report
+ * @param[in] pull Pull configuration
+ * @param[in] debounce_us Debounce period in microseconds (0 = none)
+ * @param[in] callback Called once per edge from the dispatching thread
+ * @param[in] context Passed to callback
  * 
- * @return @ref HAL_OK if configuration successful
- * @return @ref HAL_INVALID_PARAM if config is NULL or invalid
- * @return @ref HAL_ERROR if hardware configuration fails
+ * @return @ref HAL_OK on success
+ * @return @ref HAL_BUSY if the pin is held elsewhere or by a line group
  * 
  * @example
  * @code
- * gpio_config_t cfg = {
- *     .pin = 18,
- *     .mode = GPIO_MODE_OUTPUT,
- *     .pull = GPIO_PULL_NONE,
- * };
- * gpio_configure(&cfg);
+ * gpio_request_edge(irq_pin, GPIO_EDGE_FALLING, GPIO_PULL_UP, 2000, on_touch, NULL);
+ * gpio_event_start();     // or poll gpio_event_fd() from an existing loop
  * @endcode
  */
-hal_status_t gpio_configure(const gpio_config_t *config);
+hal_status_t gpio_request_edge(uint32_t pin, gpio_edge_t edge, gpio_pull_t pull, uint32_t debounce_us,
+                               gpio_event_callback_t callback, void *context);
 
 /**
- * @brief Set GPIO pin output level
- * 
- * Drives the GPIO pin to HIGH or LOW voltage level.
- * Pin must be configured as output before calling this function.
+ * @brief Stop watching a pin and release its line
  * 
- * @param[in] pin GPIO pin number
- * @param[in] level GPIO_LEVEL_HIGH or GPIO_LEVEL_LOW
+ * @param[in] pin Header pin number
  * 
  * @return @ref HAL_OK on success
- * @return @ref HAL_INVALID_PARAM if level is invalid
- * @return @ref HAL_ERROR if pin is not configured as output
+ * @return @ref HAL_NOT_READY if the pin has no edge request
  */
-hal_status_t gpio_set(uint32_t pin, gpio_level_t level);
+hal_status_t gpio_release_edge(uint32_t pin);
 
 /**
- * @brief Read GPIO pin input level
+ * @brief Get the epoll fd that holds every edge line
  * 
- * Reads the current state of a GPIO pin configured as input.
- * Pin must be configured as input before calling this function.
+ * It becomes readable when any watched pin has pending events, so it can
+ * be added to an application's own epoll or poll set; call
+ * gpio_event_dispatch(0) when it fires.
  * 
- * @param[in] pin GPIO pin number
- * @param[out] level Pointer to store the read level (HIGH/LOW)
+ * @return epoll fd, or -1 before gpio_init()
+ */
+int gpio_event_fd(void);
+
+/**
+ * @brief Deliver pending edge events
+ * 
+ * @param[in] timeout_ms Longest wait for an event (-1 = forever, 0 = none)
+ * 
+ * @return @ref HAL_OK if events were dispatched
+ * @return @ref HAL_TIMEOUT if none arrived
+ */
+hal_status_t gpio_event_dispatch(int timeout_ms);
+
+/**
+ * @brief Run gpio_event_dispatch() on a dedicated thread
+ * 
+ * Callbacks then run on that thread. Do not also dispatch elsewhere.
  * 
  * @return @ref HAL_OK on success
- * @return @ref HAL_INVALID_PARAM if level pointer is NULL
- * @return @ref HAL_ERROR if pin is not configured as input
+ */
+hal_status_t gpio_event_start(void);
+
+/**
+ * @brief Stop the event thread
  * 
- * @example
- * @code
- * gpio_level_t pin_state;
- * if (gpio_read(18, &pin_state) == HAL_OK) {
- *     if (pin_state == GPIO_LEVEL_HIGH) {
- *         LOG_INFO("Pin 18 is HIGH");
- *     }
- * }
- * @endcode
+ * @return @ref HAL_OK on success
  */
-hal_status_t gpio_read(uint32_t pin, gpio_level_t *level);
+hal_status_t gpio_event_stop(void);
 
 /**
- * @brief Toggle GPIO pin output level
+ * @brief Select how pin levels are accessed
  * 
- * Switches the output level from HIGH to LOW or vice versa.
- * Pin must be configured as output before calling this function.
+ * GPIO_BACKEND_MMIO maps the H618 PIO block (GPIO_MEM_PATH, else
+ * /dev/mem) and turns gpio_set(), gpio_read() and gpio_toggle() into
+ * a single load or store on the port data register, with no syscall.
+ * Lines are still requested and configured through the chardev.
+ * Writes go out from a per-port shadow, so on a shared port a pin
+ * changed by another process is put back to its last mapped level.
  * 
- * @param[in] pin GPIO pin number
+ * The mapping is only trusted once held lines read the same through
+ * it as through the kernel, so at least one pin must be requested
+ * first. With GPIO_MMIO_DEFAULT, gpio_init() therefore defers the
+ * switch to the first successful pin request.
+ * 
+ * Switch while no other thread is using GPIO.
+ * 
+ * @param[in] backend GPIO_BACKEND_CHARDEV or GPIO_BACKEND_MMIO
  * 
  * @return @ref HAL_OK on success
- * @return @ref HAL_ERROR if pin is not configured as output
+ * @return @ref HAL_NOT_SUPPORTED if the registers cannot be mapped,
+ *         disagree with the kernel's view, or no line is requested yet
+ *         to compare; the chardev stays in use
+ * @return @ref HAL_NOT_READY before gpio_init()
  */
-hal_status_t gpio_toggle(uint32_t pin);
+hal_status_t gpio_set_backend(gpio_backend_t backend);
+
+/**
+ * @brief Get the backend in use
+ * 
+ * @return GPIO_BACKEND_CHARDEV or GPIO_BACKEND_MMIO
+ */
+gpio_backend_t gpio_get_backend(void);
 
 /**
  * @brief Deinitialize GPIO subsystem
  * 
- * Releases GPIO resources and prepares for shutdown.
+ * Releases every requested line and closes the GPIO chip.
  * No GPIO operations are valid after calling this function.
  * 
  * @return @ref HAL_OK on success
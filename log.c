@@ -0,0 +1,1044 @@
+/**
+ * @file log.c
+ * @brief Asynchronous logging implementation
+ *
+ * log_message() formats on the caller's thread into a thread-local
+ * buffer, then copies the text into a slot of a bounded lock-free MPSC
+ * ring (per-slot sequence numbers, one CAS to claim a slot). A writer
+ * thread drains the ring and does all stdio I/O, so a driver thread
+ * never waits on the console or storage. When the ring is full the
+ * message is dropped and counted instead of blocking.
+ *
+ * Before log_init() (and after log_deinit()) messages are written
+ * synchronously, so host tools and early start-up still log.
+ *
+ * Binary mode (log_set_binary()) skips vsnprintf altogether: the first
+ * call through a LOG_* site registers it and scans its format once, and
+ * each message then queues the site ID and the raw argument values. The
+ * writer emits a site's description the first time it appears in a
+ * stream (see log_binary.h) so tools/log_decode can format offline.
+ *
+ * Storms are cut down twice. Each call site has a token bucket checked
+ * before formatting, so a site failing thousands of times per second
+ * costs a clock read and two atomics per call; the next message it is
+ * allowed reports how many were suppressed. A site that goes quiet
+ * instead is queued for the writer, which reports its count within
+ * LOG_REPEAT_REPORT_MS and on log_flush()/log_deinit(). The writer then
+ * folds identical consecutive lines into "last message repeated N times".
+ * The optional file sink rotates by size, so logs never fill the card.
+ */
+
+#include "log.h"
+#include "log_binary.h"
+#include "config.h"
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LOG_RING_MASK   (LOG_RING_SLOTS - 1u)
+#define LOG_SITE_TEXT   0xFFFF      /* Site ID for formats binary mode cannot carry */
+#define LOG_PATH_MAX    128
+#define LOG_NOTE_MAX    96          /* Writer-generated notices */
+
+_Static_assert((LOG_RING_SLOTS & LOG_RING_MASK) == 0, "LOG_RING_SLOTS must be a power of two");
+
+/* ===== LOG RING ===== */
+typedef struct {
+    atomic_uint sequence;       /* == position: free; == position + 1: published */
+    log_level_t level;
+    int line;
+    const char *file;           /* __FILE__ / __func__ literals: static lifetime */
+    const char *func;
+    uint64_t timestamp_us;      /* CLOCK_MONOTONIC when logged */
+    uint16_t site_id;           /* Binary: text holds encoded arguments; 0: formatted text */
+    uint16_t length;
+    uint32_t suppressed;        /* Messages the site's rate limit dropped before this one */
+    char text[LOG_LINE_MAX];
+} log_slot_t;
+
+/* Last text line written, for "last message repeated N times" */
+typedef struct {
+    log_level_t level;
+    int line;
+    const char *file;
+    const char *func;
+    uint64_t first_us;          /* First repeat since the line was written */
+    uint64_t last_us;
+    uint32_t count;             /* Repeats not yet reported */
+    uint16_t length;
+    char text[LOG_LINE_MAX];
+} log_repeat_t;
+
+/* Registered call site */
+typedef struct {
+    const log_site_t *site;
+    uint8_t nargs;
+    uint8_t types[LOG_MAX_ARGS];
+    int16_t precision[LOG_MAX_ARGS];    /* Per LOG_ARG_STR: bytes to copy at most (LOG_PRECISION_x) */
+} log_site_entry_t;
+
+typedef struct {
+    log_slot_t slots[LOG_RING_SLOTS];
+    atomic_uint enqueue_pos;    /* Next slot producers claim */
+    atomic_uint dequeue_pos;    /* Next slot the writer reads */
+    atomic_uint dropped;        /* Messages lost to a full ring */
+
+    /* Writer thread */
+    sem_t wake;                 /* Posted per message; no lock on the producer side */
+    bool wake_ready;            /* sem_init() done; never destroyed, late producers may post */
+    pthread_t writer;
+    atomic_bool running;
+    FILE *sink;
+    bool color;                 /* Sink is a terminal */
+
+    /* Binary mode; sink_lock keeps the writer off a sink being swapped */
+    atomic_bool binary;
+    FILE *binary_sink;
+    pthread_mutex_t sink_lock;
+    uint8_t site_emitted[LOG_MAX_SITES / 8];    /* Described in the current stream */
+
+    /* File sink (text mode); also under sink_lock */
+    FILE *file_sink;
+    char file_path[LOG_PATH_MAX];
+    uint32_t file_bytes;
+    uint32_t file_max_bytes;
+    uint8_t file_keep;
+    log_repeat_t repeat;
+
+    /* Sites owing a suppression summary (lock-free stack, writer takes all) */
+    _Atomic(log_site_t *) listed_sites;
+
+    /* Site registry, indexed by ID; entries never change once published */
+    log_site_entry_t sites[LOG_MAX_SITES];
+    uint16_t site_count;
+    pthread_mutex_t site_lock;
+
+    /* log_flush() waits here for the writer to catch up */
+    pthread_mutex_t flush_lock;
+    pthread_cond_t flushed;
+    atomic_uint flush_waiters;
+} log_context_t;
+
+static log_context_t log_ctx = {
+    .flush_lock = PTHREAD_MUTEX_INITIALIZER,
+    .flushed = PTHREAD_COND_INITIALIZER,
+    .sink_lock = PTHREAD_MUTEX_INITIALIZER,
+    .site_lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* Everything compiled in starts enabled */
+_Atomic uint8_t log_module_levels[LOG_MODULE_COUNT] = {
+    [0 ... LOG_MODULE_COUNT - 1] = LOG_LEVEL,
+};
+
+/* Formatting scratch, so producers hold no slot while vsnprintf runs */
+static __thread char log_format_buffer[LOG_LINE_MAX];
+
+static const char *const log_level_names[] = {
+    "CRIT", "ERROR", "WARN", "INFO", "DEBUG",
+};
+
+/* Used only when the sink is a terminal */
+static const char *const log_level_colors[] = {
+    "\033[1;31m", "\033[31m", "\033[33m", "\033[34m", "\033[32m",
+};
+#define LOG_COLOR_RESET "\033[0m"
+
+/* ===== LOCAL FUNCTIONS ===== */
+
+static uint64_t log_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static const char *log_basename(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    return (slash != NULL) ? slash + 1 : path;
+}
+
+/**
+ * Write one line: "[sec.usec] LEVEL file:line func(): text"
+ * @return Bytes written, negative on error
+ */
+static int log_write_line(FILE *out, bool color, log_level_t level, uint64_t timestamp_us, const char *file,
+                           int line, const char *func, const char *text, uint16_t length)
+{
+    return fprintf(out, "[%5llu.%06llu] %s%-5s%s %s:%d %s(): %.*s\n",
+            (unsigned long long)(timestamp_us / 1000000u), (unsigned long long)(timestamp_us % 1000000u),
+            color ? log_level_colors[level] : "", log_level_names[level], color ? LOG_COLOR_RESET : "",
+            log_basename(file), line, func, (int)length, text);
+}
+
+static void log_put_u16(FILE *out, uint16_t value)
+{
+    uint8_t bytes[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+    fwrite(bytes, 1, sizeof(bytes), out);
+}
+
+static void log_put_u32(FILE *out, uint32_t value)
+{
+    uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+    fwrite(bytes, 1, sizeof(bytes), out);
+}
+
+static void log_put_u64(FILE *out, uint64_t value)
+{
+    log_put_u32(out, (uint32_t)value);
+    log_put_u32(out, (uint32_t)(value >> 32));
+}
+
+static void log_put_record_header(FILE *out, uint8_t type, size_t length)
+{
+    fputc(type, out);
+    log_put_u16(out, (uint16_t)length);
+}
+
+/**
+ * Write a slot as binary records, describing its site first if needed
+ */
+static void log_write_binary(FILE *out, const log_slot_t *slot)
+{
+    if (slot->site_id == 0) {
+        size_t file_length = strlen(slot->file) + 1;
+        size_t func_length = strlen(slot->func) + 1;
+        log_put_record_header(out, LOG_REC_TEXT, 1 + 8 + 4 + file_length + func_length + slot->length);
+        fputc(slot->level, out);
+        log_put_u64(out, slot->timestamp_us);
+        log_put_u32(out, (uint32_t)slot->line);
+        fwrite(slot->file, 1, file_length, out);
+        fwrite(slot->func, 1, func_length, out);
+        fwrite(slot->text, 1, slot->length, out);
+        return;
+    }
+
+    uint16_t id = slot->site_id;
+    if (!(log_ctx.site_emitted[id / 8] & (1u << (id % 8)))) {
+        const log_site_t *site = log_ctx.sites[id].site;
+        size_t file_length = strlen(site->file) + 1;
+        size_t func_length = strlen(site->func) + 1;
+        size_t fmt_length = strlen(site->fmt) + 1;
+        log_put_record_header(out, LOG_REC_SITE, 2 + 1 + 4 + file_length + func_length + fmt_length);
+        log_put_u16(out, id);
+        fputc(site->level, out);
+        log_put_u32(out, (uint32_t)site->line);
+        fwrite(site->file, 1, file_length, out);
+        fwrite(site->func, 1, func_length, out);
+        fwrite(site->fmt, 1, fmt_length, out);
+        log_ctx.site_emitted[id / 8] |= (uint8_t)(1u << (id % 8));
+    }
+
+    log_put_record_header(out, LOG_REC_MESSAGE, 2 + 8 + slot->length);
+    log_put_u16(out, id);
+    log_put_u64(out, slot->timestamp_us);
+    fwrite(slot->text, 1, slot->length, out);
+}
+
+/**
+ * Rename path -> path.1 -> ... -> path.keep and start a new file
+ */
+static void log_rotate(void)
+{
+    char from[LOG_PATH_MAX + 4];
+    char to[LOG_PATH_MAX + 4];
+
+    fclose(log_ctx.file_sink);
+    for (unsigned int k = log_ctx.file_keep; k >= 1; k--) {
+        if (k == 1) {
+            snprintf(from, sizeof(from), "%s", log_ctx.file_path);
+        } else {
+            snprintf(from, sizeof(from), "%s.%u", log_ctx.file_path, k - 1);
+        }
+        snprintf(to, sizeof(to), "%s.%u", log_ctx.file_path, k);
+        rename(from, to);
+    }
+
+    /* keep == 0: start over in place */
+    log_ctx.file_sink = fopen(log_ctx.file_path, "w");
+    log_ctx.file_bytes = 0;
+    if (log_ctx.file_sink == NULL) {
+        fprintf(stderr, "log: cannot reopen %s after rotation, back to console\n", log_ctx.file_path);
+    }
+}
+
+/**
+ * Write a text line to the file sink or the console
+ */
+static void log_emit_line(log_level_t level, uint64_t timestamp_us, const char *file, int line,
+                          const char *func, const char *text, uint16_t length)
+{
+    if (log_ctx.file_sink == NULL) {
+        log_write_line(log_ctx.sink, log_ctx.color, level, timestamp_us, file, line, func, text, length);
+        return;
+    }
+
+    int written = log_write_line(log_ctx.file_sink, false, level, timestamp_us, file, line, func, text, length);
+    if (written > 0) {
+        log_ctx.file_bytes += (uint32_t)written;
+    }
+    if (log_ctx.file_bytes >= log_ctx.file_max_bytes) {
+        log_rotate();
+    }
+}
+
+/**
+ * Report repeats of the last line, if any
+ */
+static void log_emit_repeats(void)
+{
+    log_repeat_t *repeat = &log_ctx.repeat;
+    if (repeat->count == 0) {
+        return;
+    }
+
+    char note[LOG_NOTE_MAX];
+    int length = snprintf(note, sizeof(note), "last message repeated %u times", repeat->count);
+    log_emit_line(repeat->level, repeat->last_us, repeat->file, repeat->line, repeat->func, note, (uint16_t)length);
+    repeat->count = 0;
+}
+
+/**
+ * Write a text line, folding identical consecutive lines into a count
+ */
+static void log_emit_text(log_level_t level, uint64_t timestamp_us, const char *file, int line,
+                          const char *func, const char *text, uint16_t length)
+{
+    log_repeat_t *repeat = &log_ctx.repeat;
+
+    if (repeat->file == file && repeat->line == line && repeat->length == length &&
+        memcmp(repeat->text, text, length) == 0) {
+        if (repeat->count == 0) {
+            repeat->first_us = timestamp_us;
+        }
+        repeat->count++;
+        repeat->last_us = timestamp_us;
+
+        /* A long storm still reports once per period */
+        if (timestamp_us - repeat->first_us >= (uint64_t)LOG_REPEAT_REPORT_MS * 1000u) {
+            log_emit_repeats();
+        }
+        return;
+    }
+
+    log_emit_repeats();
+    log_emit_line(level, timestamp_us, file, line, func, text, length);
+
+    repeat->level = level;
+    repeat->file = file;
+    repeat->line = line;
+    repeat->func = func;
+    repeat->length = length;
+    memcpy(repeat->text, text, length);
+}
+
+/**
+ * Write a writer-generated notice to whichever sink is active
+ */
+static void log_emit_note(log_level_t level, const char *file, int line, const char *func, const char *text)
+{
+    log_slot_t notice = {
+        .level = level,
+        .line = line,
+        .file = file,
+        .func = func,
+        .timestamp_us = log_now_us(),
+        .site_id = 0,
+        .length = (uint16_t)strnlen(text, LOG_NOTE_MAX),
+    };
+    memcpy(notice.text, text, notice.length);
+
+    if (log_ctx.binary_sink != NULL) {
+        log_write_binary(log_ctx.binary_sink, &notice);
+    } else {
+        log_emit_repeats();
+        log_emit_line(level, notice.timestamp_us, file, line, func, notice.text, notice.length);
+    }
+}
+
+/**
+ * Report what the rate limit dropped at sites that have not logged since
+ *
+ * Called with sink_lock held. Clearing listed before taking the count
+ * means a site suppressing concurrently either adds to the count taken
+ * here or queues itself again, so nothing is lost.
+ */
+static void log_emit_suppressed(void)
+{
+    log_site_t *site = atomic_exchange_explicit(&log_ctx.listed_sites, NULL, memory_order_acquire);
+
+    while (site != NULL) {
+        log_site_t *next = site->next_listed;
+        atomic_store(&site->listed, false);
+
+        uint32_t suppressed = atomic_exchange(&site->suppressed, 0);
+        if (suppressed > 0) {
+            char note[LOG_NOTE_MAX];
+            snprintf(note, sizeof(note), "%u similar messages suppressed (rate limit)", suppressed);
+            log_emit_note(site->level, site->file, site->line, site->func, note);
+        }
+        site = next;
+    }
+}
+
+/**
+ * Write everything published so far
+ * @return true if at least one message was written
+ */
+static bool log_drain(void)
+{
+    bool wrote = false;
+
+    pthread_mutex_lock(&log_ctx.sink_lock);
+    for (;;) {
+        unsigned int pos = atomic_load_explicit(&log_ctx.dequeue_pos, memory_order_relaxed);
+        log_slot_t *slot = &log_ctx.slots[pos & LOG_RING_MASK];
+
+        /* A producer still copying into this slot stops the drain until its post */
+        if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != pos + 1u) {
+            break;
+        }
+
+        if (slot->suppressed > 0) {
+            char note[LOG_NOTE_MAX];
+            snprintf(note, sizeof(note), "%u similar messages suppressed (rate limit)", slot->suppressed);
+            log_emit_note(slot->level, slot->file, slot->line, slot->func, note);
+        }
+
+        if (log_ctx.binary_sink != NULL) {
+            log_write_binary(log_ctx.binary_sink, slot);
+        } else if (slot->site_id == 0) {
+            log_emit_text(slot->level, slot->timestamp_us, slot->file, slot->line,
+                          slot->func, slot->text, slot->length);
+        }
+        /* else: encoded for a binary sink closed since; nothing can format it here */
+
+        atomic_store_explicit(&slot->sequence, pos + LOG_RING_SLOTS, memory_order_release);
+        atomic_store_explicit(&log_ctx.dequeue_pos, pos + 1u, memory_order_release);
+        wrote = true;
+    }
+
+    unsigned int dropped = atomic_exchange_explicit(&log_ctx.dropped, 0, memory_order_relaxed);
+    if (dropped > 0) {
+        char note[LOG_NOTE_MAX];
+        snprintf(note, sizeof(note), "%u messages dropped (ring full)", dropped);
+        log_emit_note(LOG_WARN, __FILE__, __LINE__, __func__, note);
+        wrote = true;
+    }
+    pthread_mutex_unlock(&log_ctx.sink_lock);
+    return wrote;
+}
+
+/**
+ * Push buffered output to the sinks
+ * @param summaries Report pending repeats and suppressed counts first
+ */
+static void log_flush_sinks(bool summaries)
+{
+    pthread_mutex_lock(&log_ctx.sink_lock);
+    if (summaries) {
+        log_emit_suppressed();
+        log_emit_repeats();
+    }
+    fflush(log_ctx.sink);
+    if (log_ctx.file_sink != NULL) {
+        fflush(log_ctx.file_sink);
+    }
+    if (log_ctx.binary_sink != NULL) {
+        fflush(log_ctx.binary_sink);
+    }
+    pthread_mutex_unlock(&log_ctx.sink_lock);
+}
+
+static void *log_writer_thread(void *arg)
+{
+    (void)arg;
+    uint64_t report_us = 0;     /* When pending summaries are due; 0: none pending */
+
+    while (atomic_load(&log_ctx.running)) {
+        /*
+         * With repeats or suppressed counts pending, wake up in time to
+         * report them. The deadline is kept across wake-ups, so a steady
+         * stream of other messages cannot postpone it.
+         */
+        pthread_mutex_lock(&log_ctx.sink_lock);
+        bool pending = log_ctx.repeat.count > 0 ||
+                       atomic_load_explicit(&log_ctx.listed_sites, memory_order_relaxed) != NULL;
+        pthread_mutex_unlock(&log_ctx.sink_lock);
+
+        bool due = false;
+        if (pending) {
+            uint64_t now_us = log_now_us();
+            if (report_us == 0) {
+                report_us = now_us + (uint64_t)LOG_REPEAT_REPORT_MS * 1000u;
+            }
+            if (now_us >= report_us) {
+                due = true;
+            } else {
+                uint64_t wait_us = report_us - now_us;
+                struct timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_sec += (time_t)(wait_us / 1000000u);
+                deadline.tv_nsec += (long)(wait_us % 1000000u) * 1000L;
+                deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+                deadline.tv_nsec %= 1000000000L;
+                while (sem_timedwait(&log_ctx.wake, &deadline) != 0) {
+                    if (errno == ETIMEDOUT) {
+                        due = true;
+                        break;
+                    }
+                }
+            }
+        } else {
+            report_us = 0;
+            while (sem_wait(&log_ctx.wake) != 0) {
+                /* EINTR */
+            }
+        }
+
+        due = due || (report_us != 0 && log_now_us() >= report_us);
+        if (due) {
+            report_us = 0;
+        }
+
+        bool waiters = atomic_load(&log_ctx.flush_waiters) > 0;
+        if (log_drain() || due || waiters) {
+            log_flush_sinks(due || waiters);
+        }
+
+        if (waiters) {
+            pthread_mutex_lock(&log_ctx.flush_lock);
+            pthread_cond_broadcast(&log_ctx.flushed);
+            pthread_mutex_unlock(&log_ctx.flush_lock);
+        }
+    }
+
+    /* Final pass for anything published before log_deinit() */
+    log_drain();
+    log_flush_sinks(true);
+    return NULL;
+}
+
+/**
+ * Claim a ring slot
+ * @return Slot with its position in *pos, or NULL if the ring is full
+ */
+static log_slot_t *log_claim(unsigned int *pos)
+{
+    unsigned int claim = atomic_load_explicit(&log_ctx.enqueue_pos, memory_order_relaxed);
+
+    for (;;) {
+        log_slot_t *slot = &log_ctx.slots[claim & LOG_RING_MASK];
+        unsigned int sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        int diff = (int)(sequence - claim);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&log_ctx.enqueue_pos, &claim, claim + 1u,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *pos = claim;
+                return slot;
+            }
+            /* Lost the race: claim now holds the current position */
+        } else if (diff < 0) {
+            return NULL;    /* Writer has not freed this slot yet */
+        } else {
+            claim = atomic_load_explicit(&log_ctx.enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Assign a site its ID and scan its format, once
+ * @return Site ID, LOG_SITE_TEXT if binary mode cannot carry it
+ */
+static uint16_t log_register_site(log_site_t *site)
+{
+    pthread_mutex_lock(&log_ctx.site_lock);
+
+    uint16_t id = atomic_load_explicit(&site->id, memory_order_relaxed);
+    if (id == 0) {
+        log_site_entry_t entry = { .site = site, .nargs = 0 };
+        bool supported = log_ctx.site_count + 1u < LOG_MAX_SITES;
+
+        for (const char *p = site->fmt; supported && *p != '\0';) {
+            if (*p != '%') {
+                p++;
+                continue;
+            }
+            uint8_t types[3];
+            int count;
+            int precision;
+            p = log_format_conversion(p, types, &count, &precision);
+            if (p == NULL || entry.nargs + count > LOG_MAX_ARGS) {
+                supported = false;
+                break;
+            }
+            memcpy(&entry.types[entry.nargs], types, (size_t)count);
+            entry.nargs += (uint8_t)count;
+            if (count > 0) {
+                entry.precision[entry.nargs - 1] = (int16_t)precision;
+            }
+        }
+
+        if (supported) {
+            id = ++log_ctx.site_count;
+            log_ctx.sites[id] = entry;
+        } else {
+            id = LOG_SITE_TEXT;
+        }
+        atomic_store_explicit(&site->id, id, memory_order_release);
+    }
+
+    pthread_mutex_unlock(&log_ctx.site_lock);
+    return id;
+}
+
+/**
+ * Copy raw argument values in format order
+ * @return Bytes written, or -1 if they do not fit
+ */
+static int log_encode_args(uint8_t *out, size_t capacity, const log_site_entry_t *entry, va_list args)
+{
+    size_t used = 0;
+    int last_int = 0;   /* A '.*' precision is the int just before its string */
+
+    for (uint8_t i = 0; i < entry->nargs; i++) {
+        uint64_t value;
+        size_t size = sizeof(uint64_t);
+
+        switch (entry->types[i]) {
+            case LOG_ARG_INT:
+                last_int = va_arg(args, int);
+                value = (uint32_t)last_int;
+                size = sizeof(uint32_t);
+                break;
+            case LOG_ARG_LONG:
+                value = va_arg(args, unsigned long);     /* Decoder sign-extends %ld */
+                break;
+            case LOG_ARG_LLONG:
+                value = va_arg(args, unsigned long long);
+                break;
+            case LOG_ARG_SIZE:
+                value = va_arg(args, size_t);
+                break;
+            case LOG_ARG_DOUBLE: {
+                double d = va_arg(args, double);
+                memcpy(&value, &d, sizeof(value));
+                break;
+            }
+            case LOG_ARG_PTR:
+                value = (uintptr_t)va_arg(args, void *);
+                break;
+            case LOG_ARG_STR:
+            default: {
+                const char *str = va_arg(args, const char *);
+                if (str == NULL) {
+                    str = "(null)";
+                }
+                if (used + 2 > capacity) {
+                    return -1;
+                }
+
+                /* printf reads no further than the precision; neither may we */
+                size_t limit = capacity - used - 2;     /* Truncate to what fits */
+                int precision = (entry->precision[i] == LOG_PRECISION_ARG) ? last_int : entry->precision[i];
+                if (precision >= 0 && (size_t)precision < limit) {
+                    limit = (size_t)precision;
+                }
+                size_t length = strnlen(str, limit);
+                out[used] = (uint8_t)length;
+                out[used + 1] = (uint8_t)(length >> 8);
+                memcpy(&out[used + 2], str, length);
+                used += 2 + length;
+                continue;
+            }
+        }
+
+        if (used + size > capacity) {
+            return -1;
+        }
+        for (size_t b = 0; b < size; b++) {
+            out[used + b] = (uint8_t)(value >> (8 * b));
+        }
+        used += size;
+    }
+    return (int)used;
+}
+
+static uint32_t log_now_coarse_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u);
+}
+
+/**
+ * Take a token from the site's bucket
+ *
+ * The bucket holds LOG_RATE_BURST tokens and regains one every
+ * 1000 / LOG_RATE_PER_SEC ms. Whoever advances refill_ms adds the
+ * tokens, so concurrent callers never double-count a refill.
+ *
+ * @return true if the message may be logged
+ */
+static bool log_rate_allow(log_site_t *site)
+{
+#if LOG_RATE_PER_SEC > 0
+    const uint32_t interval_ms = 1000u / LOG_RATE_PER_SEC;
+    uint32_t now = log_now_coarse_ms();
+    uint32_t last = atomic_load_explicit(&site->refill_ms, memory_order_relaxed);
+    uint32_t earned = (now - last) / interval_ms;
+
+    if (earned > 0) {
+        /* A full bucket does not bank time */
+        uint32_t next = (earned >= LOG_RATE_BURST) ? now : last + earned * interval_ms;
+        if (atomic_compare_exchange_strong_explicit(&site->refill_ms, &last, next,
+                                                    memory_order_relaxed, memory_order_relaxed)) {
+            int32_t tokens = atomic_load_explicit(&site->tokens, memory_order_relaxed);
+            int32_t refilled;
+            do {
+                refilled = (tokens < 0) ? 0 : tokens;
+                refilled = (earned >= (uint32_t)(LOG_RATE_BURST - refilled)) ? LOG_RATE_BURST
+                                                                             : refilled + (int32_t)earned;
+            } while (!atomic_compare_exchange_weak_explicit(&site->tokens, &tokens, refilled,
+                                                            memory_order_relaxed, memory_order_relaxed));
+        }
+    }
+
+    if (atomic_fetch_sub_explicit(&site->tokens, 1, memory_order_relaxed) > 0) {
+        return true;
+    }
+    /* Pairs with log_emit_suppressed(): seq_cst, so one side sees the other */
+    atomic_fetch_add(&site->suppressed, 1);
+    if (!atomic_load(&site->listed) && !atomic_exchange(&site->listed, true)) {
+        log_site_t *head = atomic_load_explicit(&log_ctx.listed_sites, memory_order_relaxed);
+        do {
+            site->next_listed = head;
+        } while (!atomic_compare_exchange_weak_explicit(&log_ctx.listed_sites, &head, site,
+                                                        memory_order_release, memory_order_relaxed));
+        /* The writer may be blocked with nothing to time out on */
+        if (atomic_load_explicit(&log_ctx.running, memory_order_acquire)) {
+            sem_post(&log_ctx.wake);
+        }
+    }
+    return false;
+#else
+    (void)site;
+    return true;
+#endif
+}
+
+/**
+ * Format and queue a message as text
+ */
+static void log_submit_text(log_level_t level, const char *file, int line, const char *func,
+                            uint32_t suppressed, const char *fmt, va_list args)
+{
+    uint64_t timestamp_us = log_now_us();
+
+    int length = vsnprintf(log_format_buffer, sizeof(log_format_buffer), fmt, args);
+    if (length < 0) {
+        return;
+    }
+    if (length >= LOG_LINE_MAX) {
+        length = LOG_LINE_MAX - 1;     /* Truncated */
+    }
+
+    if (!atomic_load_explicit(&log_ctx.running, memory_order_acquire)) {
+        log_write_line(stderr, isatty(STDERR_FILENO), level, timestamp_us, file, line, func, log_format_buffer, (uint16_t)length);
+        return;
+    }
+
+    unsigned int pos;
+    log_slot_t *slot = log_claim(&pos);
+    if (slot == NULL) {
+        atomic_fetch_add_explicit(&log_ctx.dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    slot->level = level;
+    slot->line = line;
+    slot->file = file;
+    slot->func = func;
+    slot->timestamp_us = timestamp_us;
+    slot->site_id = 0;
+    slot->length = (uint16_t)length;
+    slot->suppressed = suppressed;
+    memcpy(slot->text, log_format_buffer, (size_t)length);
+
+    atomic_store_explicit(&slot->sequence, pos + 1u, memory_order_release);
+    sem_post(&log_ctx.wake);
+}
+
+/* ===== PUBLIC IMPLEMENTATION ===== */
+
+void log_set_level(log_level_t level)
+{
+    for (int module = 0; module < LOG_MODULE_COUNT; module++) {
+        log_set_module_level((log_module_t)module, level);
+    }
+}
+
+log_level_t log_get_level(void)
+{
+    return log_get_module_level(LOG_MODULE_CORE);
+}
+
+void log_set_module_level(log_module_t module, log_level_t level)
+{
+    if (module < LOG_MODULE_COUNT && level >= LOG_CRITICAL && level <= LOG_DEBUG) {
+        atomic_store_explicit(&log_module_levels[module], (uint8_t)level, memory_order_relaxed);
+    }
+}
+
+log_level_t log_get_module_level(log_module_t module)
+{
+    if (module >= LOG_MODULE_COUNT) {
+        return LOG_CRITICAL;
+    }
+    return (log_level_t)atomic_load_explicit(&log_module_levels[module], memory_order_relaxed);
+}
+
+void log_message(log_level_t level, const char *file, int line,
+                 const char *func, const char *fmt, ...)
+{
+    if (level < LOG_CRITICAL || level > (log_level_t)LOG_LEVEL || !LOG_ENABLED(level)) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    log_submit_text(level, file, line, func, 0, fmt, args);
+    va_end(args);
+}
+
+void log_record(log_site_t *site, ...)
+{
+    /* The macro already checked the site's module level */
+    if (!log_rate_allow(site)) {
+        return;
+    }
+    uint32_t suppressed = 0;
+    if (atomic_load_explicit(&site->suppressed, memory_order_relaxed) > 0) {
+        suppressed = atomic_exchange_explicit(&site->suppressed, 0, memory_order_relaxed);
+    }
+
+    va_list args;
+    va_start(args, site);
+
+    if (!atomic_load_explicit(&log_ctx.binary, memory_order_relaxed)) {
+        log_submit_text(site->level, site->file, site->line, site->func, suppressed, site->fmt, args);
+        va_end(args);
+        return;
+    }
+
+    uint16_t id = atomic_load_explicit(&site->id, memory_order_acquire);
+    if (id == 0) {
+        id = log_register_site(site);
+    }
+    if (id == LOG_SITE_TEXT) {
+        log_submit_text(site->level, site->file, site->line, site->func, suppressed, site->fmt, args);
+        va_end(args);
+        return;
+    }
+
+    uint64_t timestamp_us = log_now_us();
+    unsigned int pos;
+    log_slot_t *slot = log_claim(&pos);
+    if (slot == NULL) {
+        atomic_fetch_add_explicit(&log_ctx.dropped, 1, memory_order_relaxed);
+        va_end(args);
+        return;
+    }
+
+    int length = log_encode_args((uint8_t *)slot->text, sizeof(slot->text), &log_ctx.sites[id], args);
+    va_end(args);
+
+    slot->level = site->level;
+    slot->line = site->line;
+    slot->file = site->file;
+    slot->func = site->func;
+    slot->timestamp_us = timestamp_us;
+    slot->suppressed = suppressed;
+    if (length >= 0) {
+        slot->site_id = id;
+        slot->length = (uint16_t)length;
+    } else {
+        /* Fixed-size arguments overflow the slot: record the format itself */
+        slot->site_id = 0;
+        slot->length = (uint16_t)strnlen(site->fmt, sizeof(slot->text));
+        memcpy(slot->text, site->fmt, slot->length);
+    }
+
+    atomic_store_explicit(&slot->sequence, pos + 1u, memory_order_release);
+    sem_post(&log_ctx.wake);
+}
+
+int log_set_binary(const char *path)
+{
+    if (!atomic_load(&log_ctx.running)) {
+        return -1;
+    }
+
+    FILE *stream = NULL;
+    if (path != NULL) {
+        stream = fopen(path, "wb");
+        if (stream == NULL) {
+            return -1;
+        }
+        /* Magic, then the target's long and size_t widths for the decoder */
+        fwrite(LOG_BINARY_MAGIC, 1, LOG_BINARY_MAGIC_SIZE, stream);
+        fputc((int)sizeof(long), stream);
+        fputc((int)sizeof(size_t), stream);
+    }
+
+    /* Messages already queued go out in the mode they were encoded for */
+    atomic_store(&log_ctx.binary, false);
+    log_flush();
+
+    pthread_mutex_lock(&log_ctx.sink_lock);
+    FILE *old = log_ctx.binary_sink;
+    log_ctx.binary_sink = stream;
+    memset(log_ctx.site_emitted, 0, sizeof(log_ctx.site_emitted));
+    pthread_mutex_unlock(&log_ctx.sink_lock);
+
+    if (old != NULL) {
+        fclose(old);
+    }
+    atomic_store(&log_ctx.binary, stream != NULL);
+    return 0;
+}
+
+int log_set_file(const char *path, uint32_t max_bytes, uint8_t keep)
+{
+    if (!atomic_load(&log_ctx.running)) {
+        return -1;
+    }
+    if (path != NULL && (strlen(path) >= LOG_PATH_MAX || max_bytes == 0)) {
+        return -1;
+    }
+
+    FILE *stream = NULL;
+    long size = 0;
+    if (path != NULL) {
+        stream = fopen(path, "a");
+        if (stream == NULL) {
+            return -1;
+        }
+        size = ftell(stream);
+    }
+
+    log_flush();
+
+    pthread_mutex_lock(&log_ctx.sink_lock);
+    log_emit_repeats();
+    FILE *old = log_ctx.file_sink;
+    log_ctx.file_sink = stream;
+    if (stream != NULL) {
+        snprintf(log_ctx.file_path, sizeof(log_ctx.file_path), "%s", path);
+        log_ctx.file_bytes = (size > 0) ? (uint32_t)size : 0;
+        log_ctx.file_max_bytes = max_bytes;
+        log_ctx.file_keep = keep;
+        if (log_ctx.file_bytes >= max_bytes) {
+            log_rotate();
+        }
+    }
+    pthread_mutex_unlock(&log_ctx.sink_lock);
+
+    if (old != NULL) {
+        fclose(old);
+    }
+    return 0;
+}
+
+void log_flush(void)
+{
+    if (!atomic_load(&log_ctx.running)) {
+        fflush(stderr);
+        return;
+    }
+
+    unsigned int target = atomic_load(&log_ctx.enqueue_pos);
+
+    pthread_mutex_lock(&log_ctx.flush_lock);
+    atomic_fetch_add(&log_ctx.flush_waiters, 1);
+    while ((int)(atomic_load(&log_ctx.dequeue_pos) - target) < 0 && atomic_load(&log_ctx.running)) {
+        sem_post(&log_ctx.wake);
+        pthread_cond_wait(&log_ctx.flushed, &log_ctx.flush_lock);
+    }
+    atomic_fetch_sub(&log_ctx.flush_waiters, 1);
+    pthread_mutex_unlock(&log_ctx.flush_lock);
+
+    /* The ring may have been empty already: report what is pending here */
+    if (atomic_load(&log_ctx.running)) {
+        log_flush_sinks(true);
+    }
+}
+
+int log_init(void)
+{
+    if (atomic_load(&log_ctx.running)) {
+        return 0;
+    }
+
+    for (unsigned int i = 0; i < LOG_RING_SLOTS; i++) {
+        atomic_init(&log_ctx.slots[i].sequence, i);
+    }
+    atomic_store(&log_ctx.enqueue_pos, 0);
+    atomic_store(&log_ctx.dequeue_pos, 0);
+    atomic_store(&log_ctx.dropped, 0);
+    log_ctx.sink = stderr;
+    log_ctx.color = isatty(fileno(log_ctx.sink));
+
+    if (!log_ctx.wake_ready) {
+        if (sem_init(&log_ctx.wake, 0, 0) != 0) {
+            return -1;
+        }
+        log_ctx.wake_ready = true;
+    }
+
+    atomic_store(&log_ctx.running, true);
+    if (pthread_create(&log_ctx.writer, NULL, log_writer_thread, NULL) != 0) {
+        atomic_store(&log_ctx.running, false);
+        return -1;
+    }
+    return 0;
+}
+
+void log_deinit(void)
+{
+    if (!atomic_load(&log_ctx.running)) {
+        return;
+    }
+
+    atomic_store(&log_ctx.running, false);
+    sem_post(&log_ctx.wake);
+    pthread_join(log_ctx.writer, NULL);
+
+    /* Producers that saw running just before the store */
+    log_drain();
+    log_flush_sinks(true);
+
+    atomic_store(&log_ctx.binary, false);
+    if (log_ctx.binary_sink != NULL) {
+        fclose(log_ctx.binary_sink);
+        log_ctx.binary_sink = NULL;
+    }
+    if (log_ctx.file_sink != NULL) {
+        fclose(log_ctx.file_sink);
+        log_ctx.file_sink = NULL;
+    }
+
+    /* Wake any log_flush() that raced with shutdown */
+    pthread_mutex_lock(&log_ctx.flush_lock);
+    pthread_cond_broadcast(&log_ctx.flushed);
+    pthread_mutex_unlock(&log_ctx.flush_lock);
+}
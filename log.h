@@ -12,12 +12,39 @@
  *   LOG_INFO("System initialized");
  *   LOG_ERROR("SPI initialization failed with code %d", error_code);
  *   LOG_DEBUG("Register value: 0x%02X", reg_value);
+ *
+ * Each macro site owns a static descriptor (file, line, function,
+ * format). In binary mode (log_set_binary()) only the descriptor ID, a
+ * timestamp and the raw arguments are queued; tools/log_decode formats
+ * them offline.
+ *
+ * Filtering happens twice, both before any argument is evaluated:
+ *  - at compile time, levels above LOG_LEVEL (-DLOG_LEVEL=n, default
+ *    LOG_LEVEL_INFO) expand to dead code, so they cost nothing;
+ *  - at run time, each module has its own level, checked by an inline
+ *    load and branch. A source file picks its module by defining
+ *    LOG_MODULE before including this header (default LOG_MODULE_CORE).
  */
 
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <time.h>
 
 /* ===== LOG LEVELS ===== */
+
+/* Numeric levels for LOG_LEVEL, usable in #if */
+#define LOG_LEVEL_CRITICAL  0
+#define LOG_LEVEL_ERROR     1
+#define LOG_LEVEL_WARN      2
+#define LOG_LEVEL_INFO      3
+#define LOG_LEVEL_DEBUG     4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO    /* Most verbose level compiled in */
+#endif
+
 typedef enum {
     LOG_CRITICAL = 0,  /* System failure, immediate action required */
     LOG_ERROR    = 1,  /* Error condition, operation failed */
@@ -26,59 +53,183 @@ typedef enum {
     LOG_DEBUG    = 4,  /* Debug information, verbose */
 } log_level_t;
 
+/* ===== MODULES ===== */
+typedef enum {
+    LOG_MODULE_CORE = 0,    /* System, utilities, anything unassigned */
+    LOG_MODULE_GPIO,
+    LOG_MODULE_SPI,
+    LOG_MODULE_UART,
+    LOG_MODULE_TFT,
+    LOG_MODULE_SD,
+    LOG_MODULE_FLASH,
+    LOG_MODULE_FLIPPER,
+    LOG_MODULE_COUNT,
+} log_module_t;
+
+#ifndef LOG_MODULE
+#define LOG_MODULE LOG_MODULE_CORE
+#endif
+
+/* Runtime level per module; read by the LOG_* macros, written by log_set_*level() */
+extern _Atomic uint8_t log_module_levels[LOG_MODULE_COUNT];
+
+/* A function, not an expression: a constant CRITICAL (0) would make the
+ * comparison always true and trip -Wtype-limits at every call site */
+static inline bool log_module_enabled(log_module_t module, int level)
+{
+    return level <= (int)atomic_load_explicit(&log_module_levels[module], memory_order_relaxed);
+}
+
+/**
+ * @def LOG_ENABLED
+ * True if this file's module currently emits level
+ */
+#define LOG_ENABLED(level) log_module_enabled(LOG_MODULE, (int)(level))
+
 /* ===== DYNAMIC LOG LEVEL CONTROL ===== */
 
 /**
- * Set global log level (messages below this level are suppressed)
+ * Set the log level of every module (messages above it are suppressed)
  * @param[in] level New log level
  */
 void log_set_level(log_level_t level);
 
 /**
- * Get current log level
+ * Get the log level of LOG_MODULE_CORE
  * @return Current log level
  */
 log_level_t log_get_level(void);
 
+/**
+ * Set one module's log level, e.g. LOG_DEBUG for a noisy subsystem
+ *
+ * Levels above LOG_LEVEL were compiled out and stay silent.
+ *
+ * @param[in] module Module to change
+ * @param[in] level New log level
+ */
+void log_set_module_level(log_module_t module, log_level_t level);
+
+/**
+ * Get one module's log level
+ * @param[in] module Module to query
+ * @return Current log level
+ */
+log_level_t log_get_module_level(log_module_t module);
+
+/* ===== CALL SITES ===== */
+
+/**
+ * Static per-site descriptor created by the LOG_* macros
+ */
+typedef struct log_site {
+    log_level_t level;
+    int line;
+    const char *file;
+    const char *func;
+    const char *fmt;
+    _Atomic uint16_t id;        /* Assigned on first use, 0 until then */
+
+    /* Rate limit (token bucket), zero-initialized */
+    _Atomic int32_t tokens;
+    _Atomic uint32_t refill_ms;
+    _Atomic uint32_t suppressed;    /* Dropped since the last message that got through */
+    _Atomic bool listed;            /* Queued for the writer's suppression summary */
+    struct log_site *next_listed;
+} log_site_t;
+
+/* Never called: lets the compiler check arguments against the format */
+static inline void __attribute__((format(printf, 1, 2))) log_format_check(const char *fmt, ...)
+{
+    (void)fmt;
+}
+
+/**
+ * @def LOG_AT
+ * Log through a static call-site descriptor if the module's level allows
+ */
+#define LOG_AT(site_level, site_fmt, ...) do { \
+    if (0) { \
+        log_format_check(site_fmt, ##__VA_ARGS__); \
+    } \
+    if (LOG_ENABLED(site_level)) { \
+        static log_site_t log_site_ = { \
+            .level = (site_level), .line = __LINE__, .file = __FILE__, .func = __func__, .fmt = (site_fmt), \
+        }; \
+        log_record(&log_site_, ##__VA_ARGS__); \
+    } \
+} while (0)
+
+/**
+ * @def LOG_COMPILED_OUT
+ * Expansion of levels above LOG_LEVEL: arguments stay type-checked, no code
+ */
+#define LOG_COMPILED_OUT(fmt, ...) do { \
+    if (0) { \
+        log_format_check(fmt, ##__VA_ARGS__); \
+    } \
+} while (0)
+
 /* ===== LOGGING MACROS ===== */
 
 /**
  * @def LOG_CRITICAL
  * Log critical error with automatic source location
  */
+#if LOG_LEVEL >= LOG_LEVEL_CRITICAL
 #define LOG_CRITICAL(fmt, ...) \
-    log_message(LOG_CRITICAL, __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
+    LOG_AT(LOG_CRITICAL, fmt, ##__VA_ARGS__)
+#else
+#define LOG_CRITICAL(fmt, ...) \
+    LOG_COMPILED_OUT(fmt, ##__VA_ARGS__)
+#endif
 
 /**
  * @def LOG_ERROR
  * Log error with automatic source location
  */
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
 #define LOG_ERROR(fmt, ...) \
-    log_message(LOG_ERROR, __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
+    LOG_AT(LOG_ERROR, fmt, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(fmt, ...) \
+    LOG_COMPILED_OUT(fmt, ##__VA_ARGS__)
+#endif
 
 /**
  * @def LOG_WARN
  * Log warning with automatic source location
  */
+#if LOG_LEVEL >= LOG_LEVEL_WARN
 #define LOG_WARN(fmt, ...) \
-    log_message(LOG_WARN, __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
+    LOG_AT(LOG_WARN, fmt, ##__VA_ARGS__)
+#else
+#define LOG_WARN(fmt, ...) \
+    LOG_COMPILED_OUT(fmt, ##__VA_ARGS__)
+#endif
 
 /**
  * @def LOG_INFO
  * Log informational message
  */
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...) \
+    LOG_AT(LOG_INFO, fmt, ##__VA_ARGS__)
+#else
 #define LOG_INFO(fmt, ...) \
-    log_message(LOG_INFO, __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
+    LOG_COMPILED_OUT(fmt, ##__VA_ARGS__)
+#endif
 
 /**
  * @def LOG_DEBUG
- * Log debug message (only in DEBUG builds)
+ * Log debug message (compiled in when LOG_LEVEL >= LOG_LEVEL_DEBUG)
  */
-#ifdef DEBUG
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
 #define LOG_DEBUG(fmt, ...) \
-    log_message(LOG_DEBUG, __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
+    LOG_AT(LOG_DEBUG, fmt, ##__VA_ARGS__)
 #else
-#define LOG_DEBUG(fmt, ...)  /* Debug logs disabled in release */
+#define LOG_DEBUG(fmt, ...) \
+    LOG_COMPILED_OUT(fmt, ##__VA_ARGS__)
 #endif
 
 /* ===== CORE LOGGING FUNCTION ===== */
@@ -94,6 +245,37 @@ log_level_t log_get_level(void);
 void log_message(log_level_t level, const char *file, int line, 
                  const char *func, const char *fmt, ...);
 
+/**
+ * Log through a call-site descriptor (use macros instead)
+ * @param[in,out] site Static descriptor; registered on first use
+ */
+void log_record(log_site_t *site, ...);
+
+/**
+ * Switch between text and binary output
+ *
+ * In binary mode messages are written to path as a stream for
+ * tools/log_decode instead of being formatted. Requires log_init().
+ *
+ * @param[in] path Binary log file, or NULL to return to text output
+ * @return 0 on success
+ */
+int log_set_binary(const char *path);
+
+/**
+ * Send text output to a size-rotated file instead of the console
+ *
+ * When the file reaches max_bytes it is renamed to path.1 (path.1 to
+ * path.2, ... up to path.keep) and a new one started, so the log never
+ * takes more than (keep + 1) * max_bytes. Requires log_init().
+ *
+ * @param[in] path Log file (appended to), or NULL to return to the console
+ * @param[in] max_bytes Rotation size, e.g. LOG_FILE_MAX_BYTES
+ * @param[in] keep Rotated files kept, e.g. LOG_FILE_KEEP (0 = truncate in place)
+ * @return 0 on success
+ */
+int log_set_file(const char *path, uint32_t max_bytes, uint8_t keep);
+
 /**
  * Flush log output (if using file logging)
  */
@@ -0,0 +1,157 @@
+#ifndef LOG_BINARY_H
+#define LOG_BINARY_H
+
+/**
+ * @file log_binary.h
+ * @brief Binary log stream format, shared by log.c and tools/log_decode.c
+ *
+ * In binary mode the logger never runs printf: a call site is described
+ * once (file, line, function, format) and each message after that is the
+ * site ID, a timestamp and the raw argument values. log_decode turns the
+ * stream back into the text the text sink would have printed.
+ *
+ * Stream: LOG_BINARY_MAGIC, one byte each for the target's sizeof(long)
+ * and sizeof(size_t), then records. A record is a one-byte type,
+ * a 16-bit body length and the body. Integers are little-endian, as on
+ * both the H618 and development hosts.
+ *
+ *   LOG_REC_SITE     u16 id, u8 level, u32 line, file\0 func\0 fmt\0
+ *   LOG_REC_MESSAGE  u16 id, u64 timestamp_us, arguments in format order
+ *   LOG_REC_TEXT     u8 level, u64 timestamp_us, u32 line, file\0 func\0 text
+ *
+ * Arguments: LOG_ARG_INT is 4 bytes, LOG_ARG_STR is a u16 length and the
+ * bytes (no terminator), every other type is 8 bytes.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_BINARY_MAGIC        "LOKILOG1"
+#define LOG_BINARY_MAGIC_SIZE   8
+#define LOG_RECORD_HEADER_SIZE  3       /* Type + body length */
+#define LOG_MAX_ARGS            12      /* More and the site is logged as text */
+#define LOG_PRECISION_NONE      (-1)    /* Conversion has no precision */
+#define LOG_PRECISION_ARG       (-2)    /* '.*': precision is the preceding LOG_ARG_INT */
+#define LOG_PRECISION_MAX       0x7FFF  /* Literal precisions clamp here (past any record) */
+
+enum {
+    LOG_REC_SITE = 'S',
+    LOG_REC_MESSAGE = 'M',
+    LOG_REC_TEXT = 'T',
+};
+
+typedef enum {
+    LOG_ARG_INT = 0,        /* int, char, short (promoted), '*' width/precision */
+    LOG_ARG_LONG,           /* l */
+    LOG_ARG_LLONG,          /* ll, j */
+    LOG_ARG_SIZE,           /* z, t */
+    LOG_ARG_DOUBLE,         /* e f g a */
+    LOG_ARG_PTR,            /* p */
+    LOG_ARG_STR,            /* s */
+} log_arg_type_t;
+
+/**
+ * Parse one printf conversion
+ *
+ * @param[in] spec Points at the '%'
+ * @param[out] types Receives the argument types it consumes (at most 3)
+ * @param[out] count Number of types written
+ * @param[out] precision Receives the precision: a literal value,
+ *             LOG_PRECISION_ARG or LOG_PRECISION_NONE
+ * @return Pointer just past the conversion, or NULL if the logger cannot
+ *         carry it in binary form (%n, long double, wide strings, ...)
+ */
+static inline const char *log_format_conversion(const char *spec, uint8_t *types, int *count, int *precision)
+{
+    const char *p = spec + 1;
+    *count = 0;
+    *precision = LOG_PRECISION_NONE;
+
+    if (*p == '%') {
+        return p + 1;
+    }
+
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0' || *p == '\'') {
+        p++;
+    }
+    if (*p == '*') {
+        types[(*count)++] = LOG_ARG_INT;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            types[(*count)++] = LOG_ARG_INT;
+            *precision = LOG_PRECISION_ARG;
+            p++;
+        } else {
+            *precision = 0;     /* A bare '.' means zero */
+            while (*p >= '0' && *p <= '9') {
+                *precision = *precision * 10 + (*p - '0');
+                if (*precision > LOG_PRECISION_MAX) {
+                    *precision = LOG_PRECISION_MAX;
+                }
+                p++;
+            }
+        }
+    }
+
+    log_arg_type_t integer = LOG_ARG_INT;
+    switch (*p) {
+        case 'h':
+            p += (p[1] == 'h') ? 2 : 1;
+            break;
+        case 'l':
+            if (p[1] == 'l') {
+                integer = LOG_ARG_LLONG;
+                p += 2;
+            } else {
+                integer = LOG_ARG_LONG;
+                p++;
+            }
+            break;
+        case 'j':
+            integer = LOG_ARG_LLONG;
+            p++;
+            break;
+        case 'z':
+        case 't':
+            integer = LOG_ARG_SIZE;
+            p++;
+            break;
+        case 'L':
+            return NULL;
+        default:
+            break;
+    }
+
+    switch (*p) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            if (*p == 'c' && integer != LOG_ARG_INT) {
+                return NULL;    /* wint_t */
+            }
+            types[(*count)++] = (uint8_t)integer;
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            types[(*count)++] = LOG_ARG_DOUBLE;
+            break;
+        case 'p':
+            types[(*count)++] = LOG_ARG_PTR;
+            break;
+        case 's':
+            if (integer != LOG_ARG_INT) {
+                return NULL;    /* wchar_t string */
+            }
+            types[(*count)++] = LOG_ARG_STR;
+            break;
+        default:
+            return NULL;
+    }
+    return p + 1;
+}
+
+#endif /* LOG_BINARY_H */
@@ -16,6 +16,7 @@ def eeprom_read(address: int, length: int = 16) -> bytes:
         raise RuntimeError(f"EEPROM read failed: {status}")
     return bytes(buf[:length])
 
+# 0x80 and up hold the settings record; the driver refuses writes there
 def eeprom_write(address: int, data: bytes) -> None:
     buf = (c_uint8 * 256)()
     for i, b in enumerate(data):
@@ -0,0 +1,515 @@
+/**
+ * @file memory.c
+ * @brief Safe allocation wrappers, leak tracking and arenas
+ *
+ * DEBUG builds record every live malloc_safe()/calloc_safe() block in a
+ * fixed table so memory_report() can list what was never freed.
+ *
+ * Arenas are a pointer bump inside one block: alloc rounds `used` up to
+ * the alignment and advances it, reset sets it back to zero. They take
+ * no lock, so each thread gets its own scratch arena through a
+ * pthread key whose destructor returns the block when the thread exits.
+ *
+ * Pools are a Treiber stack of slab indices with a change count in the
+ * head word (see memory_pool_t). A pool joins the report list the first
+ * time it is used, so statically defined pools need no registration.
+ */
+
+#include "memory.h"
+#include "log.h"
+#include "config.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(DEBUG) && DEBUG
+#define MEMORY_TRACKING 1
+#else
+#define MEMORY_TRACKING 0
+#endif
+
+/* ===== TRACKING STATE ===== */
+typedef struct {
+    void *ptr;
+    size_t size;
+    uint64_t timestamp_ms;
+} memory_allocation_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t total_bytes;
+    uint32_t count;
+    uint32_t untracked;         /* Allocations that did not fit the table */
+    memory_allocation_t table[MEMORY_TRACK_MAX];
+} memory_tracking_t;
+
+static memory_tracking_t track_ctx = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* ===== POOL REGISTRY ===== */
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static memory_pool_t *pool_list;
+
+/* ===== THREAD ARENAS ===== */
+static pthread_key_t arena_key;
+static pthread_once_t arena_key_once = PTHREAD_ONCE_INIT;
+
+/* ===== LOCAL HELPER FUNCTIONS ===== */
+
+#if MEMORY_TRACKING
+static uint64_t memory_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+#endif
+
+static void memory_track(void *ptr, size_t size)
+{
+#if MEMORY_TRACKING
+    pthread_mutex_lock(&track_ctx.lock);
+    if (track_ctx.count < MEMORY_TRACK_MAX) {
+        track_ctx.table[track_ctx.count++] = (memory_allocation_t){
+            .ptr = ptr,
+            .size = size,
+            .timestamp_ms = memory_now_ms(),
+        };
+        track_ctx.total_bytes += size;
+    } else {
+        track_ctx.untracked++;
+    }
+    pthread_mutex_unlock(&track_ctx.lock);
+#else
+    (void)ptr;
+    (void)size;
+#endif
+}
+
+static void memory_untrack(void *ptr)
+{
+#if MEMORY_TRACKING
+    pthread_mutex_lock(&track_ctx.lock);
+    for (uint32_t i = 0; i < track_ctx.count; i++) {
+        if (track_ctx.table[i].ptr == ptr) {
+            track_ctx.total_bytes -= track_ctx.table[i].size;
+            track_ctx.table[i] = track_ctx.table[--track_ctx.count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&track_ctx.lock);
+#else
+    (void)ptr;
+#endif
+}
+
+static void memory_arena_thread_exit(void *arena)
+{
+    memory_arena_destroy(arena);
+    free(arena);
+}
+
+static void memory_arena_key_create(void)
+{
+    pthread_key_create(&arena_key, memory_arena_thread_exit);
+}
+
+static inline uint64_t memory_pool_head(uint64_t previous, uint32_t top)
+{
+    uint32_t count = (uint32_t)(previous >> 32) + 1;
+    return ((uint64_t)count << 32) | top;
+}
+
+static void memory_pool_register(memory_pool_t *pool)
+{
+    pthread_mutex_lock(&pool_lock);
+    if (!atomic_load_explicit(&pool->registered, memory_order_relaxed)) {
+        pool->report_next = pool_list;
+        pool_list = pool;
+        atomic_store_explicit(&pool->registered, true, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+static void memory_pool_unregister(memory_pool_t *pool)
+{
+    pthread_mutex_lock(&pool_lock);
+    for (memory_pool_t **link = &pool_list; *link != NULL; link = &(*link)->report_next) {
+        if (*link == pool) {
+            *link = pool->report_next;
+            break;
+        }
+    }
+    atomic_store_explicit(&pool->registered, false, memory_order_relaxed);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+/**
+ * Claim an object that has never been handed out
+ * @return Slab index, or UINT32_MAX when all have been
+ */
+static uint32_t memory_pool_take_fresh(memory_pool_t *pool)
+{
+    uint32_t fresh = atomic_load_explicit(&pool->fresh, memory_order_relaxed);
+    while (fresh < pool->capacity) {
+        if (atomic_compare_exchange_weak_explicit(&pool->fresh, &fresh, fresh + 1,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            return fresh;
+        }
+    }
+    return UINT32_MAX;
+}
+
+/* ===== PUBLIC IMPLEMENTATION ===== */
+
+void *malloc_safe(size_t size)
+{
+    void *ptr = malloc(size);
+    if (ptr == NULL) {
+        LOG_ERROR("malloc(%zu) failed", size);
+        return NULL;
+    }
+    memory_track(ptr, size);
+    return ptr;
+}
+
+void *calloc_safe(size_t count, size_t elem_size)
+{
+    void *ptr = calloc(count, elem_size);
+    if (ptr == NULL) {
+        LOG_ERROR("calloc(%zu, %zu) failed", count, elem_size);
+        return NULL;
+    }
+    memory_track(ptr, count * elem_size);
+    return ptr;
+}
+
+void free_safe(void **ptr)
+{
+    if (ptr == NULL || *ptr == NULL) {
+        return;
+    }
+    memory_untrack(*ptr);
+    free(*ptr);
+    *ptr = NULL;
+}
+
+size_t memory_get_usage(void)
+{
+    pthread_mutex_lock(&track_ctx.lock);
+    size_t total = track_ctx.total_bytes;
+    pthread_mutex_unlock(&track_ctx.lock);
+    return total;
+}
+
+void memory_report(void)
+{
+    pthread_mutex_lock(&pool_lock);
+    for (memory_pool_t *pool = pool_list; pool != NULL; pool = pool->report_next) {
+        memory_pool_stats_t stats;
+        memory_pool_get_stats(pool, &stats);
+        if (stats.alloc_failures > 0) {
+            LOG_WARN("Pool %s: %u/%u in use, high water %u, %u allocations failed",
+                     pool->name, stats.in_use, stats.capacity, stats.high_water, stats.alloc_failures);
+        } else {
+            LOG_INFO("Pool %s: %u/%u in use, high water %u",
+                     pool->name, stats.in_use, stats.capacity, stats.high_water);
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+#if MEMORY_TRACKING
+    pthread_mutex_lock(&track_ctx.lock);
+
+    LOG_INFO("=== Memory Allocation Report ===");
+    LOG_INFO("Total allocated: %zu bytes", track_ctx.total_bytes);
+    LOG_INFO("Active allocations: %u", track_ctx.count);
+
+    uint64_t now = memory_now_ms();
+    for (uint32_t i = 0; i < track_ctx.count; i++) {
+        const memory_allocation_t *alloc = &track_ctx.table[i];
+        LOG_WARN("  [%u] %zu bytes at %p (age: %llu ms)", i, alloc->size, alloc->ptr,
+                 (unsigned long long)(now - alloc->timestamp_ms));
+    }
+    if (track_ctx.untracked > 0) {
+        LOG_WARN("%u allocations not tracked (table full, MEMORY_TRACK_MAX)", track_ctx.untracked);
+    }
+
+    pthread_mutex_unlock(&track_ctx.lock);
+#endif
+}
+
+void memory_init(void)
+{
+    pthread_mutex_lock(&track_ctx.lock);
+    track_ctx.total_bytes = 0;
+    track_ctx.count = 0;
+    track_ctx.untracked = 0;
+    pthread_mutex_unlock(&track_ctx.lock);
+
+    pthread_once(&arena_key_once, memory_arena_key_create);
+}
+
+void memory_deinit(void)
+{
+    /* Table entries are left for a late memory_report() */
+}
+
+hal_status_t memory_arena_init(memory_arena_t *arena, void *buffer, size_t size)
+{
+    if (arena == NULL || buffer == NULL || size == 0) {
+        return HAL_INVALID_PARAM;
+    }
+
+    *arena = (memory_arena_t){
+        .base = buffer,
+        .size = size,
+    };
+    return HAL_OK;
+}
+
+hal_status_t memory_arena_create(memory_arena_t *arena, size_t size)
+{
+    if (arena == NULL || size == 0) {
+        return HAL_INVALID_PARAM;
+    }
+
+    void *block = malloc_safe(size);
+    if (block == NULL) {
+        return HAL_ERROR;
+    }
+
+    memory_arena_init(arena, block, size);
+    arena->owned = true;
+    return HAL_OK;
+}
+
+void memory_arena_destroy(memory_arena_t *arena)
+{
+    if (arena == NULL) {
+        return;
+    }
+
+    if (arena->owned) {
+        void *block = arena->base;
+        free_safe(&block);
+    }
+    *arena = (memory_arena_t){ 0 };
+}
+
+void *memory_arena_alloc_aligned(memory_arena_t *arena, size_t size, size_t align)
+{
+    if (arena == NULL || align == 0 || (align & (align - 1)) != 0) {
+        return NULL;
+    }
+
+    /* Align the address, not the offset, so caller-provided blocks work too */
+    uintptr_t base = (uintptr_t)arena->base;
+    uintptr_t start = (base + arena->used + (align - 1)) & ~(uintptr_t)(align - 1);
+    size_t offset = (size_t)(start - base);
+
+    if (offset > arena->size || size > arena->size - offset) {
+        arena->failures++;
+        return NULL;
+    }
+
+    arena->used = offset + size;
+    if (arena->used > arena->high_water) {
+        arena->high_water = arena->used;
+    }
+    return arena->base + offset;
+}
+
+void *memory_arena_alloc(memory_arena_t *arena, size_t size)
+{
+    return memory_arena_alloc_aligned(arena, size, MEMORY_ARENA_ALIGN);
+}
+
+void *memory_arena_calloc(memory_arena_t *arena, size_t count, size_t elem_size)
+{
+    if (elem_size != 0 && count > SIZE_MAX / elem_size) {
+        if (arena != NULL) {
+            arena->failures++;
+        }
+        return NULL;
+    }
+
+    void *ptr = memory_arena_alloc(arena, count * elem_size);
+    if (ptr != NULL) {
+        memset(ptr, 0, count * elem_size);
+    }
+    return ptr;
+}
+
+size_t memory_arena_mark(const memory_arena_t *arena)
+{
+    return (arena != NULL) ? arena->used : 0;
+}
+
+void memory_arena_rewind(memory_arena_t *arena, size_t mark)
+{
+    if (arena != NULL && mark <= arena->used) {
+        arena->used = mark;
+    }
+}
+
+void memory_arena_reset(memory_arena_t *arena)
+{
+    if (arena != NULL) {
+        arena->used = 0;
+    }
+}
+
+memory_arena_t *memory_arena_thread(void)
+{
+    pthread_once(&arena_key_once, memory_arena_key_create);
+
+    memory_arena_t *arena = pthread_getspecific(arena_key);
+    if (arena != NULL) {
+        return arena;
+    }
+
+    /* The descriptor itself is plain malloc so the destructor can free it */
+    arena = malloc(sizeof(*arena));
+    if (arena == NULL) {
+        LOG_ERROR("Thread arena: out of memory");
+        return NULL;
+    }
+    if (memory_arena_create(arena, MEMORY_THREAD_ARENA_SIZE) != HAL_OK) {
+        free(arena);
+        return NULL;
+    }
+
+    pthread_setspecific(arena_key, arena);
+    return arena;
+}
+
+hal_status_t memory_pool_create(memory_pool_t *pool, const char *name, size_t object_size, uint32_t capacity)
+{
+    if (pool == NULL || object_size == 0 || capacity == 0 || capacity == UINT32_MAX) {
+        return HAL_INVALID_PARAM;
+    }
+
+    size_t stride = (object_size + MEMORY_ARENA_ALIGN - 1) & ~(size_t)(MEMORY_ARENA_ALIGN - 1);
+    if (stride < object_size || stride > SIZE_MAX / capacity) {
+        return HAL_INVALID_PARAM;
+    }
+
+    void *slab = malloc_safe(stride * capacity);
+    void *next = calloc_safe(capacity, sizeof(*pool->next));
+    if (slab == NULL || next == NULL) {
+        free_safe(&slab);
+        free_safe(&next);
+        return HAL_ERROR;
+    }
+
+    *pool = (memory_pool_t)MEMORY_POOL_INITIALIZER(name, slab, next, stride, capacity);
+    pool->owned = true;
+    memory_pool_register(pool);
+    return HAL_OK;
+}
+
+void memory_pool_destroy(memory_pool_t *pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+
+    uint32_t in_use = atomic_load_explicit(&pool->in_use, memory_order_relaxed);
+    if (in_use > 0) {
+        LOG_WARN("Pool %s destroyed with %u objects in use", pool->name, in_use);
+    }
+
+    memory_pool_unregister(pool);
+    if (pool->owned) {
+        void *slab = pool->slab;
+        void *next = (void *)pool->next;
+        free_safe(&slab);
+        free_safe(&next);
+    }
+    *pool = (memory_pool_t){ 0 };
+}
+
+void *memory_pool_alloc(memory_pool_t *pool)
+{
+    if (pool == NULL || pool->slab == NULL) {
+        return NULL;
+    }
+
+    if (!atomic_load_explicit(&pool->registered, memory_order_relaxed)) {
+        memory_pool_register(pool);
+    }
+
+    /* Acquire pairs with the release in memory_pool_free(): next[] and the
+     * object's last contents are visible once the head is seen */
+    uint32_t index;
+    uint64_t head = atomic_load_explicit(&pool->head, memory_order_acquire);
+    for (;;) {
+        uint32_t top = (uint32_t)head;
+        if (top == 0) {
+            index = memory_pool_take_fresh(pool);
+            break;
+        }
+
+        /* May read a link another thread is rewriting; the count makes that CAS fail */
+        uint32_t next = atomic_load_explicit(&pool->next[top - 1], memory_order_relaxed);
+        if (atomic_compare_exchange_weak_explicit(&pool->head, &head, memory_pool_head(head, next),
+                                                  memory_order_acquire, memory_order_acquire)) {
+            index = top - 1;
+            break;
+        }
+    }
+
+    if (index == UINT32_MAX) {
+        atomic_fetch_add_explicit(&pool->alloc_failures, 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    uint32_t in_use = atomic_fetch_add_explicit(&pool->in_use, 1, memory_order_relaxed) + 1;
+    uint32_t high_water = atomic_load_explicit(&pool->high_water, memory_order_relaxed);
+    while (in_use > high_water &&
+           !atomic_compare_exchange_weak_explicit(&pool->high_water, &high_water, in_use,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+
+    return pool->slab + (size_t)index * pool->object_size;
+}
+
+void memory_pool_free(memory_pool_t *pool, void *object)
+{
+    if (pool == NULL || object == NULL) {
+        return;
+    }
+
+    uintptr_t offset = (uintptr_t)object - (uintptr_t)pool->slab;
+    uintptr_t index = offset / pool->object_size;
+    if ((uintptr_t)object < (uintptr_t)pool->slab || index >= pool->capacity ||
+        index * pool->object_size != offset) {
+        LOG_ERROR("Pool %s: %p is not one of its objects", pool->name, object);
+        return;
+    }
+
+    /* Count it out before it becomes visible, so in_use never exceeds capacity */
+    atomic_fetch_sub_explicit(&pool->in_use, 1, memory_order_relaxed);
+
+    uint64_t head = atomic_load_explicit(&pool->head, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&pool->next[index], (uint32_t)head, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->head, &head, memory_pool_head(head, (uint32_t)index + 1),
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+void memory_pool_get_stats(memory_pool_t *pool, memory_pool_stats_t *stats)
+{
+    if (pool == NULL || stats == NULL) {
+        return;
+    }
+
+    stats->capacity = pool->capacity;
+    stats->in_use = atomic_load_explicit(&pool->in_use, memory_order_relaxed);
+    stats->high_water = atomic_load_explicit(&pool->high_water, memory_order_relaxed);
+    stats->alloc_failures = atomic_load_explicit(&pool->alloc_failures, memory_order_relaxed);
+}
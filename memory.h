@@ -7,8 +7,20 @@
  * 
  * Provides wrappers around malloc/free with error checking
  * and optional memory leak detection (DEBUG builds).
+ *
+ * Arenas cover short-lived scratch memory (a render pass, one parsed
+ * protocol transaction): allocations bump a pointer through one block
+ * and are all released together by memory_arena_reset(), so the hot
+ * paths never take the malloc lock or fragment the heap.
+ *
+ * Pools cover fixed-size objects that outlive a scope and cross threads
+ * (Flipper message buffers, sector buffers, transfer descriptors): a
+ * preallocated slab with a lock-free free list, so allocation is a
+ * bounded CAS loop and steady-state operation never calls malloc.
  */
 
+#include "types.h"
+#include <stdatomic.h>
 #include <stddef.h>
 
 /* ===== SAFE ALLOCATION ===== */
@@ -48,10 +60,217 @@ void free_safe(void **ptr);
 size_t memory_get_usage(void);
 
 /**
- * Print memory allocation report (DEBUG only)
+ * Print memory allocation report (leaks in DEBUG builds, pool usage always)
  */
 void memory_report(void);
 
+/* ===== ARENAS ===== */
+
+/**
+ * Bump allocator over one block
+ *
+ * An arena is not locked: use one per thread (see memory_arena_thread())
+ * or guard a shared one yourself.
+ */
+typedef struct {
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    size_t high_water;          /* Largest `used` since creation */
+    uint32_t failures;          /* Allocations that did not fit */
+    bool owned;                 /* Block came from memory_arena_create() */
+} memory_arena_t;
+
+/**
+ * Create an arena over a caller-provided block (e.g. a static buffer)
+ * @param[out] arena Arena to set up
+ * @param[in] buffer Backing memory, kept until the arena is no longer used
+ * @param[in] size Size of buffer in bytes
+ * @return HAL_OK, or HAL_INVALID_PARAM for a NULL arena/buffer or zero size
+ */
+hal_status_t memory_arena_init(memory_arena_t *arena, void *buffer, size_t size);
+
+/**
+ * Create an arena with a heap block of the given size
+ * @param[out] arena Arena to set up
+ * @param[in] size Capacity in bytes
+ * @return HAL_OK, HAL_INVALID_PARAM, or HAL_ERROR if the block cannot be allocated
+ */
+hal_status_t memory_arena_create(memory_arena_t *arena, size_t size);
+
+/**
+ * Release an arena's heap block (if it owns one); the arena is empty afterwards
+ * @param[in,out] arena Arena
+ */
+void memory_arena_destroy(memory_arena_t *arena);
+
+/**
+ * Allocate from an arena, aligned for any type (MEMORY_ARENA_ALIGN)
+ * @param[in,out] arena Arena
+ * @param[in] size Bytes
+ * @return Pointer valid until the arena is reset or rewound past it,
+ *         or NULL if it does not fit (the arena never grows)
+ *
+ * Usage:
+ *   memory_arena_t *scratch = memory_arena_thread();
+ *   uint16_t *line = memory_arena_alloc(scratch, width * sizeof(uint16_t));
+ *   ...
+ *   memory_arena_reset(scratch);     // Frees everything at once
+ */
+void *memory_arena_alloc(memory_arena_t *arena, size_t size);
+
+/**
+ * Allocate with an explicit alignment
+ * @param[in,out] arena Arena
+ * @param[in] size Bytes
+ * @param[in] align Power of two (e.g. 64 for a cache line)
+ * @return Pointer, or NULL if it does not fit or align is not a power of two
+ */
+void *memory_arena_alloc_aligned(memory_arena_t *arena, size_t size, size_t align);
+
+/**
+ * Allocate zeroed memory for count elements of elem_size bytes
+ * @return Pointer, or NULL if it does not fit or count * elem_size overflows
+ */
+void *memory_arena_calloc(memory_arena_t *arena, size_t count, size_t elem_size);
+
+/**
+ * Current fill level, to hand to memory_arena_rewind() later
+ * @param[in] arena Arena
+ * @return Opaque mark
+ */
+size_t memory_arena_mark(const memory_arena_t *arena);
+
+/**
+ * Free everything allocated since a mark (nested scratch scopes)
+ * @param[in,out] arena Arena
+ * @param[in] mark Value from memory_arena_mark() on this arena
+ */
+void memory_arena_rewind(memory_arena_t *arena, size_t mark);
+
+/**
+ * Free every allocation in the arena (O(1), the block is kept)
+ * @param[in,out] arena Arena
+ */
+void memory_arena_reset(memory_arena_t *arena);
+
+/**
+ * Calling thread's scratch arena
+ *
+ * Created on first use with MEMORY_THREAD_ARENA_SIZE bytes and released
+ * when the thread exits. The owner resets it; nothing else touches it.
+ *
+ * @return Arena, or NULL if its block cannot be allocated
+ */
+memory_arena_t *memory_arena_thread(void);
+
+/* ===== OBJECT POOLS ===== */
+
+/**
+ * Fixed-size object pool
+ *
+ * The free list links slab indices through a separate next[] array, so
+ * objects carry no header and stay intact while free. Its head packs a
+ * 32-bit change count above index + 1 (0 = empty) in one 64-bit word;
+ * every push and pop bumps the count, so a CAS from a stale head fails
+ * even if the same object came back in between (no ABA). Objects never
+ * freed yet are handed out from `fresh`, so a pool needs no set-up pass
+ * and MEMORY_POOL_DEFINE() pools work from a static initializer.
+ *
+ * Treat the fields as private; use memory_pool_get_stats().
+ */
+typedef struct memory_pool {
+    const char *name;
+    uint8_t *slab;
+    _Atomic uint32_t *next;
+    size_t object_size;                     /* Slab stride */
+    uint32_t capacity;
+    _Atomic uint64_t head;
+    _Atomic uint32_t fresh;                 /* Objects never handed out start here */
+    _Atomic uint32_t in_use;
+    _Atomic uint32_t high_water;
+    _Atomic uint32_t alloc_failures;
+    atomic_bool registered;                 /* Listed by memory_report() */
+    bool owned;                             /* Slab came from memory_pool_create() */
+    struct memory_pool *report_next;
+} memory_pool_t;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t in_use;
+    uint32_t high_water;
+    uint32_t alloc_failures;
+} memory_pool_stats_t;
+
+#define MEMORY_POOL_INITIALIZER(pool_name, slab_storage, next_storage, size, count) { \
+    .name = (pool_name), .slab = (uint8_t *)(slab_storage), .next = (next_storage), \
+    .object_size = (size), .capacity = (count), \
+}
+
+/**
+ * Define a static pool of `count` objects of `type` with typed wrappers
+ *
+ * Usage:
+ *   MEMORY_POOL_DEFINE(sector_pool, sector_buf_t, 8);
+ *   sector_buf_t *buf = sector_pool_alloc();     // NULL when exhausted
+ *   ...
+ *   sector_pool_free(buf);
+ */
+#define MEMORY_POOL_DEFINE(prefix, type, count) \
+    static type prefix##_slab_[count]; \
+    static _Atomic uint32_t prefix##_next_[count]; \
+    static memory_pool_t prefix##_pool_ = \
+        MEMORY_POOL_INITIALIZER(#prefix, prefix##_slab_, prefix##_next_, sizeof(type), count); \
+    static inline type *prefix##_alloc(void) \
+    { \
+        return (type *)memory_pool_alloc(&prefix##_pool_); \
+    } \
+    static inline void prefix##_free(type *object) \
+    { \
+        memory_pool_free(&prefix##_pool_, object); \
+    } \
+    static inline memory_pool_t *prefix##_pool(void) \
+    { \
+        return &prefix##_pool_; \
+    }
+
+/**
+ * Create a pool with a heap slab (one allocation, at creation only)
+ * @param[out] pool Pool to set up
+ * @param[in] name Name shown by memory_report() (not copied)
+ * @param[in] object_size Bytes per object, rounded up to MEMORY_ARENA_ALIGN
+ * @param[in] capacity Number of objects
+ * @return HAL_OK, HAL_INVALID_PARAM, or HAL_ERROR if the slab cannot be allocated
+ */
+hal_status_t memory_pool_create(memory_pool_t *pool, const char *name, size_t object_size, uint32_t capacity);
+
+/**
+ * Release a pool's heap slab; every object must have been freed
+ * @param[in,out] pool Pool from memory_pool_create()
+ */
+void memory_pool_destroy(memory_pool_t *pool);
+
+/**
+ * Take an object from a pool (any thread)
+ * @param[in,out] pool Pool
+ * @return Object with undefined contents, or NULL if the pool is exhausted
+ */
+void *memory_pool_alloc(memory_pool_t *pool);
+
+/**
+ * Return an object to its pool (any thread)
+ * @param[in,out] pool Pool the object came from
+ * @param[in] object Object (NULL is ignored)
+ */
+void memory_pool_free(memory_pool_t *pool, void *object);
+
+/**
+ * Get pool usage counters
+ * @param[in] pool Pool
+ * @param[out] stats Receives a snapshot
+ */
+void memory_pool_get_stats(memory_pool_t *pool, memory_pool_stats_t *stats);
+
 /**
  * Initialize memory tracking system
  */
@@ -0,0 +1,435 @@
+/**
+ * @file flipper_bench.c
+ * @brief Flipper link throughput/latency benchmark against the pty simulator
+ *
+ * Runs the real driver stack over a pseudo-terminal with flipper_sim on
+ * the far end and reports:
+ *   - round-trip latency (p50/p99) of STATE_UPDATE -> ACK, one at a time;
+ *   - messages/s and payload bytes/s of pipelined SEND_DATA -> ACK;
+ *   - that timed receives with an rx hook installed wait out their
+ *     timeout and still deliver replies (exit status 1 if not);
+ *   - with -m, that the rate was negotiated up, and that under injected
+ *     noise the host steps down by SET_BAUD and, with the simulator's
+ *     rate locked, by GOODBYE, polling and with flipper_dispatch running
+ *     (exit status 1 if the link does not recover).
+ *
+ * Usage: flipper_bench [-n count] [-s payload] [-w window] [-b baud]
+ *                      [-l loss] [-c corrupt] [-v version] [-r seed]
+ *                      [-m max_baud]
+ */
+
+#include "flipper_sim.h"
+#include "flipper_uart.h"
+#include "flipper_frame.h"
+#include "flipper_dispatch.h"
+#include "uart.h"
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_DEFAULT_COUNT     1000
+#define BENCH_DEFAULT_PAYLOAD   32
+#define BENCH_DEFAULT_WINDOW    8
+#define BENCH_TIMEOUT_SLACK_MS  50      /* Added to two frame times before a reply counts as lost */
+#define BENCH_IDLE_WAIT_MS      200     /* Hook-mode receive with nothing coming */
+#define BENCH_HOOK_ATTEMPTS     3       /* STATE_UPDATEs tried for a hook-mode reply */
+#define BENCH_NOISE_RATE        0.01    /* Per-byte corruption injected to force a step-down */
+#define BENCH_STEP_DOWN_MS      5000    /* Traffic allowed before a missing step-down fails */
+#define BENCH_NOISY_TIMEOUT_MS  10      /* Reply wait while waiting for the step-down */
+#define BENCH_RECOVER_ATTEMPTS  20      /* Round trips tried once the rate dropped */
+#define BENCH_RECOVER_WAIT_MS   50      /* Pause after a failed one (the host may be in HELLO) */
+
+typedef struct {
+    uint32_t count;
+    uint16_t payload;
+    uint8_t window;
+} bench_config_t;
+
+static uint64_t bench_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static int bench_compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Correlation IDs cycle through 1..255; v1/v2 links ignore them */
+static uint8_t bench_id(uint32_t sequence)
+{
+    return (uint8_t)(sequence % 255u + 1u);
+}
+
+/**
+ * Wait for the ACK carrying id (any ACK on links without IDs)
+ * @return true if it arrived before the timeout
+ */
+static bool bench_wait_ack(uint8_t id, uint32_t timeout_ms)
+{
+    uint64_t deadline = bench_now_us() + (uint64_t)timeout_ms * 1000u;
+    bool correlated = flipper_get_protocol_version() >= FLIPPER_PROTO_V3;
+
+    for (;;) {
+        uint64_t now = bench_now_us();
+        if (now >= deadline) {
+            return false;
+        }
+
+        flipper_message_t reply;
+        uint32_t wait_ms = (uint32_t)((deadline - now + 999u) / 1000u);
+        if (flipper_receive_message(&reply, wait_ms) != HAL_OK) {
+            return false;
+        }
+
+        bool match = reply.cmd == FLIPPER_CMD_ACK && (!correlated || reply.id == id);
+        flipper_message_release(&reply);
+        if (match) {
+            return true;
+        }
+        /* A late ACK for a request already counted lost: keep waiting */
+    }
+}
+
+static void bench_latency(const bench_config_t *bench, const uint8_t *payload, uint32_t timeout_ms)
+{
+    uint32_t *rtt_us = malloc(bench->count * sizeof(*rtt_us));
+    if (rtt_us == NULL) {
+        return;
+    }
+
+    uint32_t done = 0;
+    uint32_t lost = 0;
+    for (uint32_t i = 0; i < bench->count; i++) {
+        flipper_message_t msg = {
+            .cmd = FLIPPER_CMD_STATE_UPDATE,
+            .length = bench->payload,
+            .payload = (uint8_t *)payload,
+            .id = bench_id(i),
+            .buf = NULL,
+        };
+
+        uint64_t start = bench_now_us();
+        if (flipper_send_message(&msg) != HAL_OK || !bench_wait_ack(msg.id, timeout_ms)) {
+            lost++;
+            continue;
+        }
+        rtt_us[done++] = (uint32_t)(bench_now_us() - start);
+    }
+
+    printf("latency:    %u round trips, %u lost\n", done, lost);
+    if (done > 0) {
+        qsort(rtt_us, done, sizeof(*rtt_us), bench_compare_u32);
+        printf("            p50 %u us, p99 %u us, max %u us\n",
+               rtt_us[done / 2], rtt_us[(done * 99u) / 100u], rtt_us[done - 1]);
+    }
+    free(rtt_us);
+}
+
+static void bench_throughput(const bench_config_t *bench, const uint8_t *payload, uint32_t timeout_ms)
+{
+    bool outstanding[256] = { false };
+    bool correlated = flipper_get_protocol_version() >= FLIPPER_PROTO_V3;
+    uint32_t sent = 0;
+    uint32_t acked = 0;
+    uint32_t lost = 0;
+    uint32_t in_flight = 0;
+
+    uint64_t start = bench_now_us();
+    while (acked + lost < bench->count) {
+        /* Keep the window full */
+        while (in_flight < bench->window && sent < bench->count) {
+            flipper_message_t msg = {
+                .cmd = FLIPPER_CMD_SEND_DATA,
+                .length = bench->payload,
+                .payload = (uint8_t *)payload,
+                .id = bench_id(sent),
+                .buf = NULL,
+            };
+            if (flipper_send_message(&msg) != HAL_OK) {
+                break;
+            }
+            outstanding[msg.id] = true;
+            sent++;
+            in_flight++;
+        }
+
+        flipper_message_t reply;
+        if (flipper_receive_message(&reply, timeout_ms) != HAL_OK) {
+            /* Nothing more is coming for this window */
+            lost += in_flight;
+            in_flight = 0;
+            memset(outstanding, 0, sizeof(outstanding));
+            continue;
+        }
+
+        if (reply.cmd == FLIPPER_CMD_ACK && (!correlated || outstanding[reply.id]) && in_flight > 0) {
+            outstanding[reply.id] = false;
+            acked++;
+            in_flight--;
+        }
+        flipper_message_release(&reply);
+    }
+    uint64_t elapsed_us = bench_now_us() - start;
+    if (elapsed_us == 0) {
+        elapsed_us = 1;
+    }
+
+    uint32_t frame_bytes = flipper_frame_header_size(flipper_get_protocol_version()) + bench->payload +
+                           flipper_frame_trailer_size(flipper_get_protocol_version());
+    double seconds = (double)elapsed_us / 1e6;
+    printf("throughput: %u acked, %u lost in %.3f s (window %u)\n", acked, lost, seconds, bench->window);
+    printf("            %.0f msgs/s, %.0f payload bytes/s, %.0f frame bytes/s\n",
+           acked / seconds, (double)acked * bench->payload / seconds, (double)acked * frame_bytes / seconds);
+}
+
+/* Claims nothing: frames go to the inbox flipper_receive_message() waits on */
+static bool bench_pass_hook(flipper_message_t *message, void *context)
+{
+    (void)message;
+    (void)context;
+    return false;
+}
+
+/**
+ * Timed receives in hook mode: an idle wait must last its timeout, and
+ * a reply on the way must be delivered
+ * @return true if both hold
+ */
+static bool bench_hook_receive(const uint8_t *payload, uint32_t timeout_ms)
+{
+    flipper_set_rx_hook(bench_pass_hook, NULL);
+
+    flipper_message_t reply;
+    uint64_t start = bench_now_us();
+    hal_status_t idle = flipper_receive_message(&reply, BENCH_IDLE_WAIT_MS);
+    uint32_t idle_ms = (uint32_t)((bench_now_us() - start) / 1000u);
+    if (idle == HAL_OK) {
+        flipper_message_release(&reply);
+    }
+
+    bool acked = false;
+    for (uint32_t attempt = 0; attempt < BENCH_HOOK_ATTEMPTS && !acked; attempt++) {
+        flipper_message_t msg = {
+            .cmd = FLIPPER_CMD_STATE_UPDATE,
+            .length = BENCH_DEFAULT_PAYLOAD,
+            .payload = (uint8_t *)payload,
+            .id = bench_id(attempt),
+            .buf = NULL,
+        };
+        acked = flipper_send_message(&msg) == HAL_OK && bench_wait_ack(msg.id, timeout_ms);
+    }
+
+    flipper_set_rx_hook(NULL, NULL);
+
+    bool ok = idle == HAL_TIMEOUT && idle_ms + 1u >= BENCH_IDLE_WAIT_MS && acked;
+    printf("hook rx:    idle receive returned after %u of %u ms, reply %s: %s\n",
+           idle_ms, BENCH_IDLE_WAIT_MS, acked ? "delivered" : "lost", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+/**
+ * One STATE_UPDATE -> ACK round trip, through the dispatcher when it runs
+ * @return true if the ACK arrived
+ */
+static bool bench_round_trip(const uint8_t *payload, uint32_t sequence, bool dispatch, uint32_t timeout_ms)
+{
+    flipper_message_t msg = {
+        .cmd = FLIPPER_CMD_STATE_UPDATE,
+        .length = BENCH_DEFAULT_PAYLOAD,
+        .payload = (uint8_t *)payload,
+        .id = bench_id(sequence),
+        .buf = NULL,
+    };
+
+    if (!dispatch) {
+        return flipper_send_message(&msg) == HAL_OK && bench_wait_ack(msg.id, timeout_ms);
+    }
+
+    flipper_message_t reply;
+    if (flipper_request(&msg, &reply, timeout_ms) != HAL_OK) {
+        return false;
+    }
+    bool acked = reply.cmd == FLIPPER_CMD_ACK;
+    flipper_message_release(&reply);
+    return acked;
+}
+
+/**
+ * Add noise at the current rate and keep traffic going until the host
+ * steps down; forced also locks the simulator's rate, so only GOODBYE
+ * can bring the two ends back together. Renegotiates up afterwards.
+ * @return true if the rate dropped, both ends agree and the link works
+ */
+static bool bench_step_down(bool dispatch, bool forced, const uint8_t *payload, uint32_t timeout_ms)
+{
+    uint32_t from = flipper_get_baud_rate();
+    uint8_t version = flipper_get_protocol_version();
+    flipper_sim_stats_t before;
+    flipper_sim_get_stats(&before);
+
+    flipper_sim_lock_rate(forced);
+    flipper_sim_set_noise(forced ? UART1_BAUD_RATE : from - 1, BENCH_NOISE_RATE);
+
+    uint32_t sequence = 0;
+    uint64_t start = bench_now_us();
+    uint64_t deadline = start + (uint64_t)BENCH_STEP_DOWN_MS * 1000u;
+    while (flipper_get_baud_rate() >= from && bench_now_us() < deadline) {
+        bench_round_trip(payload, sequence++, dispatch, BENCH_NOISY_TIMEOUT_MS);
+    }
+    uint32_t step_ms = (uint32_t)((bench_now_us() - start) / 1000u);
+
+    /* With the dispatcher the step-down runs on the TX thread and may still be in HELLO */
+    bool recovered = false;
+    for (uint32_t attempt = 0; attempt < BENCH_RECOVER_ATTEMPTS && !recovered; attempt++) {
+        recovered = flipper_get_protocol_version() == version &&
+                    bench_round_trip(payload, sequence++, dispatch, timeout_ms);
+        if (!recovered) {
+            usleep(BENCH_RECOVER_WAIT_MS * 1000);
+        }
+    }
+
+    uint32_t to = flipper_get_baud_rate();
+    flipper_sim_stats_t after;
+    flipper_sim_get_stats(&after);
+    bool goodbye = after.goodbyes > before.goodbyes;
+    bool ok = to < from && after.baud_rate == to && recovered && (!forced || (goodbye && to == UART1_BAUD_RATE));
+
+    printf("step-down:  %s, %s: %u -> %u baud in %u ms via %s, simulator at %u, v%u link %s: %s\n",
+           dispatch ? "dispatch" : "polling", forced ? "rate locked" : "noisy rate",
+           from, to, step_ms, goodbye ? "GOODBYE" : "SET_BAUD", after.baud_rate,
+           flipper_get_protocol_version(), recovered ? "up" : "down", ok ? "ok" : "FAIL");
+
+    /* Clean line again for the next run */
+    flipper_sim_set_noise(0, 0.0);
+    flipper_sim_lock_rate(false);
+    while (flipper_negotiate_baud(FLIPPER_BAUD_MAX) == HAL_BUSY) {
+        usleep(BENCH_RECOVER_WAIT_MS * 1000);
+    }
+    return ok;
+}
+
+/**
+ * Rate negotiation and both step-down paths, polling and dispatched
+ * @return true if all of them hold
+ */
+static bool bench_rate_changes(uint32_t max_baud, const uint8_t *payload, uint32_t timeout_ms)
+{
+    flipper_sim_stats_t sim_stats;
+    flipper_sim_get_stats(&sim_stats);
+    uint32_t expected = (max_baud < FLIPPER_BAUD_MAX) ? max_baud : FLIPPER_BAUD_MAX;
+    bool ok = flipper_get_baud_rate() > UART1_BAUD_RATE && flipper_get_baud_rate() <= expected &&
+              sim_stats.baud_rate == flipper_get_baud_rate();
+    printf("rate:       negotiated %u baud (offered %u), simulator at %u: %s\n",
+           flipper_get_baud_rate(), max_baud, sim_stats.baud_rate, ok ? "ok" : "FAIL");
+    if (!ok) {
+        return false;
+    }
+
+    ok = bench_step_down(false, false, payload, timeout_ms) && ok;
+    ok = bench_step_down(false, true, payload, timeout_ms) && ok;
+
+    if (flipper_get_protocol_version() < FLIPPER_PROTO_V3) {
+        printf("step-down:  dispatch skipped (needs protocol v3)\n");
+        return ok;
+    }
+    if (flipper_dispatch_start() != HAL_OK) {
+        printf("step-down:  dispatcher failed to start: FAIL\n");
+        return false;
+    }
+    ok = bench_step_down(true, false, payload, timeout_ms) && ok;
+    ok = bench_step_down(true, true, payload, timeout_ms) && ok;
+    flipper_dispatch_stop();
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    bench_config_t bench = {
+        .count = BENCH_DEFAULT_COUNT,
+        .payload = BENCH_DEFAULT_PAYLOAD,
+        .window = BENCH_DEFAULT_WINDOW,
+    };
+    flipper_sim_config_t sim;
+    flipper_sim_default_config(&sim);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:w:b:l:c:v:r:m:h")) != -1) {
+        switch (opt) {
+        case 'n': bench.count = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 's': bench.payload = (uint16_t)strtoul(optarg, NULL, 0); break;
+        case 'w': bench.window = (uint8_t)strtoul(optarg, NULL, 0); break;
+        case 'b': sim.baud_rate = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'l': sim.loss_rate = strtod(optarg, NULL); break;
+        case 'c': sim.corrupt_rate = strtod(optarg, NULL); break;
+        case 'v': sim.version = (uint8_t)strtoul(optarg, NULL, 0); break;
+        case 'r': sim.seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'm': sim.max_baud = (uint32_t)strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-n count] [-s payload] [-w window] [-b baud (0 = unpaced)]\n"
+                            "       [-l loss] [-c corrupt] [-v version] [-r seed] [-m max_baud]\n", argv[0]);
+            return (opt == 'h') ? 0 : 2;
+        }
+    }
+    if (bench.count == 0 || bench.payload > FLIPPER_MSG_MAX_PAYLOAD || bench.window == 0 || bench.window > 128) {
+        fprintf(stderr, "count must be > 0, payload <= %u, window 1..128\n", FLIPPER_MSG_MAX_PAYLOAD);
+        return 2;
+    }
+
+    char path[64];
+    if (flipper_sim_start(&sim, path, sizeof(path)) != HAL_OK) {
+        fprintf(stderr, "failed to start the simulator\n");
+        return 1;
+    }
+    uart_set_device_path(UART_PORT_1, path);
+    if (flipper_uart_init() != HAL_OK) {
+        fprintf(stderr, "failed to open %s\n", path);
+        flipper_sim_stop();
+        return 1;
+    }
+
+    /* A reply is lost once two max-size frames could have crossed the line */
+    uint32_t timeout_ms = BENCH_TIMEOUT_SLACK_MS;
+    if (sim.baud_rate > 0) {
+        timeout_ms += (uint32_t)(2u * FLIPPER_FRAME_MAX_SIZE * 10u * 1000u / sim.baud_rate);
+    }
+
+    uint8_t payload[FLIPPER_MSG_MAX_PAYLOAD];
+    for (uint32_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)(i * 31u + 7u);
+    }
+
+    printf("link:       protocol v%u, %u baud%s, %u-byte payloads, loss %g, corruption %g\n",
+           flipper_get_protocol_version(), sim.baud_rate, sim.baud_rate ? "" : " (unpaced)",
+           bench.payload, sim.loss_rate, sim.corrupt_rate);
+
+    bench_latency(&bench, payload, timeout_ms);
+    bench_throughput(&bench, payload, timeout_ms);
+    bool hook_ok = bench_hook_receive(payload, timeout_ms);
+    bool rate_ok = (sim.max_baud == 0) || bench_rate_changes(sim.max_baud, payload, timeout_ms);
+
+    flipper_link_stats_t link;
+    flipper_sim_stats_t sim_stats;
+    flipper_get_link_stats(&link);
+    flipper_sim_get_stats(&sim_stats);
+    printf("host rx:    %u frames, %u checksum errors, %u length errors, %u bytes skipped\n",
+           link.frames, link.checksum_errors, link.length_errors, link.dropped_bytes);
+    printf("simulator:  %u frames in, %u out, %u bad, %u bytes dropped, %u corrupted, %u misclocked\n",
+           sim_stats.frames_rx, sim_stats.frames_tx, sim_stats.bad_frames,
+           sim_stats.bytes_dropped, sim_stats.bytes_corrupted, sim_stats.bytes_misclocked);
+    if (sim.max_baud > 0) {
+        printf("            %u rate changes, %u fallbacks, %u GOODBYEs\n",
+               sim_stats.rate_changes, sim_stats.fallbacks, sim_stats.goodbyes);
+    }
+
+    flipper_uart_deinit();
+    flipper_sim_stop();
+    return (hook_ok && rate_ok) ? 0 : 1;
+}
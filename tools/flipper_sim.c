@@ -0,0 +1,659 @@
+/**
+ * @file flipper_sim.c
+ * @brief Flipper Zero stand-in on a pseudo-terminal
+ */
+
+#define _GNU_SOURCE
+#include "flipper_sim.h"
+#include "flipper_uart.h"
+#include "flipper_frame.h"
+#include "flipper_pool.h"
+#include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FLIPPER_SIM_WIRE_SIZE   4096    /* Bytes in flight per direction */
+#define FLIPPER_SIM_BITS_PER_BYTE   10  /* 8N1: start + 8 data + stop */
+
+/* One direction of the emulated line: bytes leave in order, one per byte time */
+typedef struct {
+    uint8_t data[FLIPPER_SIM_WIRE_SIZE];
+    uint32_t head;
+    uint32_t count;
+    uint64_t clock_ns;          /* When data[head] has finished arriving */
+} flipper_sim_wire_t;
+
+typedef struct {
+    flipper_sim_config_t config;
+    int master_fd;
+    int slave_fd;               /* Held open so the master never sees a hangup */
+    int wake_fd;
+    pthread_t thread;
+    atomic_bool running;
+
+    flipper_parser_t parser;
+    uint8_t version;            /* Agreed in HELLO */
+    uint8_t impaired;           /* Handshake done: loss/corruption apply */
+    uint64_t byte_ns;
+    uint32_t rng;
+
+    uint32_t line_baud;         /* Rate the simulator's end runs at */
+    uint32_t committed_baud;    /* Rate to revert to while a switch is uncommitted */
+    uint32_t switch_baud;       /* Agreed in SET_BAUD, taken once the echo is out (0: none) */
+    uint64_t fallback_ns;       /* Revert deadline of an uncommitted switch (0: none) */
+    uint32_t host_baud;         /* Host's rate as last read from the pty */
+    uint32_t host_prev_baud;    /* Host's rate before its last change */
+    uint64_t host_changed_ns;
+
+    flipper_sim_wire_t to_sim;
+    flipper_sim_wire_t to_host;
+
+    pthread_mutex_t lock;       /* Guards stats and the knobs below */
+    flipper_sim_stats_t stats;
+    uint32_t noise_above_baud;
+    double noise_rate;
+    bool rate_locked;
+} flipper_sim_context_t;
+
+static flipper_sim_context_t sim_ctx = {
+    .master_fd = -1,
+    .slave_fd = -1,
+    .wake_fd = -1,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* ===== LOCAL HELPER FUNCTIONS ===== */
+
+static uint64_t flipper_sim_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* xorshift32: cheap, and the same seed gives the same impairments */
+static bool flipper_sim_chance(double rate)
+{
+    if (rate <= 0.0) {
+        return false;
+    }
+
+    uint32_t x = sim_ctx.rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim_ctx.rng = x;
+    return (double)x / 4294967296.0 < rate;
+}
+
+static uint32_t flipper_sim_wire_space(const flipper_sim_wire_t *wire)
+{
+    return FLIPPER_SIM_WIRE_SIZE - wire->count;
+}
+
+/**
+ * Host's line rate, read back from the termios uart.c set on the pty
+ * @return Rate in baud, 0 if not one uart.c uses
+ */
+static uint32_t flipper_sim_host_baud(void)
+{
+    static const struct {
+        speed_t speed;
+        uint32_t baud;
+    } rates[] = {
+        { B9600, 9600 }, { B19200, 19200 }, { B38400, 38400 }, { B57600, 57600 },
+        { B115200, 115200 }, { B230400, 230400 }, { B460800, 460800 }, { B921600, 921600 },
+        { B1000000, 1000000 }, { B1500000, 1500000 }, { B2000000, 2000000 }, { B3000000, 3000000 },
+    };
+
+    struct termios tty;
+    if (tcgetattr(sim_ctx.slave_fd, &tty) != 0) {
+        return 0;
+    }
+
+    speed_t speed = cfgetospeed(&tty);
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        if (rates[i].speed == speed) {
+            return rates[i].baud;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Whether bytes cross the line now: both ends must run at the same rate
+ *
+ * The pty does not timestamp bytes, so for FLIPPER_BAUD_SETTLE_MS after
+ * the host retunes, bytes it wrote just before still count at its old rate.
+ */
+static bool flipper_sim_rates_match(uint64_t now)
+{
+    if (sim_ctx.config.max_baud == 0) {
+        return true;    /* Nobody retunes */
+    }
+
+    uint32_t host = flipper_sim_host_baud();
+    if (host != sim_ctx.host_baud) {
+        sim_ctx.host_prev_baud = sim_ctx.host_baud;
+        sim_ctx.host_baud = host;
+        sim_ctx.host_changed_ns = now;
+    }
+
+    if (sim_ctx.line_baud == sim_ctx.host_baud) {
+        return true;
+    }
+    return sim_ctx.line_baud == sim_ctx.host_prev_baud &&
+           now - sim_ctx.host_changed_ns < (uint64_t)FLIPPER_BAUD_SETTLE_MS * 1000000u;
+}
+
+static void flipper_sim_count_misclocked(uint32_t length)
+{
+    pthread_mutex_lock(&sim_ctx.lock);
+    sim_ctx.stats.bytes_misclocked += length;
+    pthread_mutex_unlock(&sim_ctx.lock);
+}
+
+/**
+ * Move the simulator's end of the line to a new rate
+ */
+static void flipper_sim_retune(uint32_t baud)
+{
+    uint32_t pace = (baud == UART1_BAUD_RATE) ? sim_ctx.config.baud_rate : baud;
+
+    sim_ctx.line_baud = baud;
+    sim_ctx.byte_ns = (sim_ctx.config.baud_rate && pace) ? (uint64_t)FLIPPER_SIM_BITS_PER_BYTE * 1000000000u / pace : 0;
+
+    pthread_mutex_lock(&sim_ctx.lock);
+    sim_ctx.stats.baud_rate = baud;
+    pthread_mutex_unlock(&sim_ctx.lock);
+}
+
+/**
+ * Put bytes on the line, applying loss and corruption once the
+ * handshake is over, and any noise set for the current rate
+ */
+static void flipper_sim_wire_push(flipper_sim_wire_t *wire, const uint8_t *data, uint32_t length, uint64_t now)
+{
+    uint32_t dropped = 0;
+    uint32_t corrupted = 0;
+
+    pthread_mutex_lock(&sim_ctx.lock);
+    double noise = (sim_ctx.line_baud > sim_ctx.noise_above_baud) ? sim_ctx.noise_rate : 0.0;
+    pthread_mutex_unlock(&sim_ctx.lock);
+    double corrupt_rate = (sim_ctx.impaired ? sim_ctx.config.corrupt_rate : 0.0) + noise;
+
+    for (uint32_t i = 0; i < length && wire->count < FLIPPER_SIM_WIRE_SIZE; i++) {
+        uint8_t byte = data[i];
+        if (sim_ctx.impaired && flipper_sim_chance(sim_ctx.config.loss_rate)) {
+            dropped++;
+            continue;
+        }
+        if (flipper_sim_chance(corrupt_rate)) {
+            byte ^= (uint8_t)(1u << (sim_ctx.rng & 7));
+            corrupted++;
+        }
+
+        /* An idle line starts clocking out from now */
+        if (wire->count == 0 && wire->clock_ns < now + sim_ctx.byte_ns) {
+            wire->clock_ns = now + sim_ctx.byte_ns;
+        }
+        wire->data[(wire->head + wire->count) % FLIPPER_SIM_WIRE_SIZE] = byte;
+        wire->count++;
+    }
+
+    if (dropped || corrupted) {
+        pthread_mutex_lock(&sim_ctx.lock);
+        sim_ctx.stats.bytes_dropped += dropped;
+        sim_ctx.stats.bytes_corrupted += corrupted;
+        pthread_mutex_unlock(&sim_ctx.lock);
+    }
+}
+
+/**
+ * Number of bytes that have finished crossing the line by now
+ */
+static uint32_t flipper_sim_wire_ready(const flipper_sim_wire_t *wire, uint64_t now)
+{
+    if (wire->count == 0 || now < wire->clock_ns) {
+        return 0;
+    }
+    if (sim_ctx.byte_ns == 0) {
+        return wire->count;
+    }
+
+    uint64_t done = (now - wire->clock_ns) / sim_ctx.byte_ns + 1;
+    return (done < wire->count) ? (uint32_t)done : wire->count;
+}
+
+/**
+ * Copy out (up to the ring wrap) and consume ready bytes
+ * @return Bytes copied
+ */
+static uint32_t flipper_sim_wire_take(flipper_sim_wire_t *wire, uint8_t *out, uint32_t max_length)
+{
+    uint32_t contiguous = FLIPPER_SIM_WIRE_SIZE - wire->head;
+    uint32_t n = (max_length < contiguous) ? max_length : contiguous;
+
+    memcpy(out, &wire->data[wire->head], n);
+    wire->head = (wire->head + n) % FLIPPER_SIM_WIRE_SIZE;
+    wire->count -= n;
+    wire->clock_ns += n * sim_ctx.byte_ns;
+    return n;
+}
+
+static void flipper_sim_reply(uint8_t version, uint8_t cmd, uint8_t id,
+                              const uint8_t *payload, uint16_t length, uint64_t now)
+{
+    uint8_t frame[FLIPPER_FRAME_MAX_SIZE];
+    uint16_t frame_length = flipper_frame_encode(version, cmd, id, payload, length, frame);
+
+    flipper_sim_wire_push(&sim_ctx.to_host, frame, frame_length, now);
+
+    pthread_mutex_lock(&sim_ctx.lock);
+    sim_ctx.stats.frames_tx++;
+    pthread_mutex_unlock(&sim_ctx.lock);
+}
+
+/**
+ * Act on one frame from the host, the way the firmware would
+ */
+static void flipper_sim_handle(flipper_msg_buf_t *frame, uint64_t now)
+{
+    const uint8_t *payload = flipper_pool_payload(frame);
+
+    switch (frame->cmd) {
+    case FLIPPER_CMD_HELLO: {
+        /* Reply in v1 framing, then both sides switch */
+        uint8_t offer = (frame->length >= 1) ? payload[0] : FLIPPER_PROTO_V1;
+        uint8_t agreed = (offer < sim_ctx.config.version) ? offer : sim_ctx.config.version;
+        uint32_t max_baud = sim_ctx.config.max_baud;
+        uint8_t hello[6] = {
+            agreed, (max_baud >> 24) & 0xFF, (max_baud >> 16) & 0xFF, (max_baud >> 8) & 0xFF, max_baud & 0xFF,
+            sim_ctx.config.caps,
+        };
+
+        flipper_sim_reply(FLIPPER_PROTO_V1, FLIPPER_CMD_HELLO, 0, hello, sizeof(hello), now);
+        sim_ctx.version = (agreed > FLIPPER_PROTO_V1) ? agreed : FLIPPER_PROTO_V1;
+        flipper_parser_set_version(&sim_ctx.parser, sim_ctx.version);
+        sim_ctx.impaired = 1;
+        break;
+    }
+
+    case FLIPPER_CMD_STATE_UPDATE:
+    case FLIPPER_CMD_SEND_DATA:
+    case FLIPPER_CMD_CONTROL:
+        flipper_sim_reply(sim_ctx.version, FLIPPER_CMD_ACK, frame->id, NULL, 0, now);
+        break;
+
+    case FLIPPER_CMD_REQUEST_STATE: {
+        uint8_t state[4];
+        pthread_mutex_lock(&sim_ctx.lock);
+        uint32_t frames = sim_ctx.stats.frames_rx;
+        pthread_mutex_unlock(&sim_ctx.lock);
+        state[0] = (frames >> 24) & 0xFF;
+        state[1] = (frames >> 16) & 0xFF;
+        state[2] = (frames >> 8) & 0xFF;
+        state[3] = frames & 0xFF;
+        flipper_sim_reply(sim_ctx.version, FLIPPER_CMD_STATE_UPDATE, frame->id, state, sizeof(state), now);
+        break;
+    }
+
+    case FLIPPER_CMD_LINK_TEST:
+        flipper_sim_reply(sim_ctx.version, FLIPPER_CMD_LINK_TEST, frame->id, payload, frame->length, now);
+        break;
+
+    case FLIPPER_CMD_SET_BAUD: {
+        pthread_mutex_lock(&sim_ctx.lock);
+        bool locked = sim_ctx.rate_locked;
+        pthread_mutex_unlock(&sim_ctx.lock);
+        if (locked || sim_ctx.config.max_baud == 0 || frame->length != 4) {
+            break;      /* Silent, like firmware that cannot retune */
+        }
+
+        uint32_t rate = ((uint32_t)payload[0] << 24) | ((uint32_t)payload[1] << 16) |
+                        ((uint32_t)payload[2] << 8) | payload[3];
+        if (rate == sim_ctx.line_baud && sim_ctx.switch_baud == 0) {
+            /* Commit, or a repeat of one whose echo was lost */
+            if (sim_ctx.fallback_ns != 0) {
+                pthread_mutex_lock(&sim_ctx.lock);
+                sim_ctx.stats.rate_changes++;
+                pthread_mutex_unlock(&sim_ctx.lock);
+            }
+            sim_ctx.fallback_ns = 0;
+            sim_ctx.committed_baud = rate;
+            flipper_sim_reply(sim_ctx.version, FLIPPER_CMD_SET_BAUD, frame->id, payload, frame->length, now);
+        } else if (rate > 0 && rate <= sim_ctx.config.max_baud &&
+                   sim_ctx.switch_baud == 0 && sim_ctx.fallback_ns == 0) {
+            /* Echo at the old rate; the thread switches once it is out */
+            flipper_sim_reply(sim_ctx.version, FLIPPER_CMD_SET_BAUD, frame->id, payload, frame->length, now);
+            sim_ctx.switch_baud = rate;
+        } else {
+            flipper_sim_reply(sim_ctx.version, FLIPPER_CMD_NACK, frame->id, NULL, 0, now);
+        }
+        break;
+    }
+
+    case FLIPPER_CMD_GOODBYE:
+        /* Back to the power-on rate and framing until the next HELLO */
+        sim_ctx.switch_baud = 0;
+        sim_ctx.fallback_ns = 0;
+        sim_ctx.committed_baud = UART1_BAUD_RATE;
+        flipper_sim_retune(UART1_BAUD_RATE);
+        sim_ctx.version = FLIPPER_PROTO_V1;
+        flipper_parser_set_version(&sim_ctx.parser, FLIPPER_PROTO_V1);
+        sim_ctx.impaired = 0;
+
+        pthread_mutex_lock(&sim_ctx.lock);
+        sim_ctx.stats.goodbyes++;
+        pthread_mutex_unlock(&sim_ctx.lock);
+        break;
+
+    case FLIPPER_CMD_ACK:
+    case FLIPPER_CMD_NACK:
+    case FLIPPER_CMD_DEBUG:
+        break;
+
+    default:
+        flipper_sim_reply(sim_ctx.version, FLIPPER_CMD_NACK, frame->id, NULL, 0, now);
+        break;
+    }
+}
+
+/**
+ * Feed bytes that have crossed the line to the parser and answer frames
+ */
+static void flipper_sim_deliver(uint64_t now)
+{
+    uint8_t chunk[256];
+    uint32_t ready;
+
+    while ((ready = flipper_sim_wire_ready(&sim_ctx.to_sim, now)) > 0) {
+        /* Stay within what the parser queue can hold */
+        uint32_t room = (uint32_t)(FLIPPER_FRAME_QUEUE_DEPTH - sim_ctx.parser.q_count) * FLIPPER_FRAME_MIN_SIZE;
+        uint32_t want = (ready < sizeof(chunk)) ? ready : sizeof(chunk);
+        uint32_t n = flipper_sim_wire_take(&sim_ctx.to_sim, chunk, (want < room) ? want : room);
+        if (n == 0) {
+            break;
+        }
+
+        uint32_t before = sim_ctx.parser.stats.checksum_errors + sim_ctx.parser.stats.length_errors;
+        flipper_parser_feed(&sim_ctx.parser, chunk, n);
+        uint32_t bad = sim_ctx.parser.stats.checksum_errors + sim_ctx.parser.stats.length_errors - before;
+
+        flipper_msg_buf_t *frame;
+        while ((frame = flipper_parser_pop(&sim_ctx.parser)) != NULL) {
+            pthread_mutex_lock(&sim_ctx.lock);
+            sim_ctx.stats.frames_rx++;
+            pthread_mutex_unlock(&sim_ctx.lock);
+
+            flipper_sim_handle(frame, now);
+            flipper_pool_release(frame);
+        }
+
+        if (bad) {
+            pthread_mutex_lock(&sim_ctx.lock);
+            sim_ctx.stats.bad_frames += bad;
+            pthread_mutex_unlock(&sim_ctx.lock);
+        }
+    }
+}
+
+/**
+ * Write bytes that have crossed the line to the host's side of the pty
+ */
+static void flipper_sim_transmit(uint64_t now)
+{
+    uint8_t chunk[256];
+    uint32_t ready;
+
+    while ((ready = flipper_sim_wire_ready(&sim_ctx.to_host, now)) > 0) {
+        if (!flipper_sim_rates_match(now)) {
+            flipper_sim_count_misclocked(flipper_sim_wire_take(&sim_ctx.to_host, chunk,
+                                                               (ready < sizeof(chunk)) ? ready : sizeof(chunk)));
+            continue;
+        }
+
+        /* Peek, and only consume what the pty accepted */
+        uint32_t head = sim_ctx.to_host.head;
+        uint32_t count = sim_ctx.to_host.count;
+        uint64_t clock_ns = sim_ctx.to_host.clock_ns;
+        uint32_t n = flipper_sim_wire_take(&sim_ctx.to_host, chunk,
+                                           (ready < sizeof(chunk)) ? ready : sizeof(chunk));
+
+        ssize_t written = write(sim_ctx.master_fd, chunk, n);
+        if (written == (ssize_t)n) {
+            continue;
+        }
+
+        sim_ctx.to_host.head = head;
+        sim_ctx.to_host.count = count;
+        sim_ctx.to_host.clock_ns = clock_ns;
+        if (written > 0) {
+            flipper_sim_wire_take(&sim_ctx.to_host, chunk, (uint32_t)written);
+        }
+        break;
+    }
+}
+
+/**
+ * Take an agreed rate once its echo is out; revert one left uncommitted
+ */
+static void flipper_sim_rate_timers(uint64_t now)
+{
+    if (sim_ctx.switch_baud != 0 && sim_ctx.to_host.count == 0) {
+        flipper_sim_retune(sim_ctx.switch_baud);
+        sim_ctx.switch_baud = 0;
+        sim_ctx.fallback_ns = now + (uint64_t)FLIPPER_BAUD_FALLBACK_MS * 1000000u;
+    }
+
+    if (sim_ctx.fallback_ns != 0 && now >= sim_ctx.fallback_ns) {
+        sim_ctx.fallback_ns = 0;
+        flipper_sim_retune(sim_ctx.committed_baud);
+
+        pthread_mutex_lock(&sim_ctx.lock);
+        sim_ctx.stats.fallbacks++;
+        pthread_mutex_unlock(&sim_ctx.lock);
+    }
+}
+
+static void *flipper_sim_thread(void *arg)
+{
+    (void)arg;
+    uint8_t chunk[256];
+
+    while (atomic_load(&sim_ctx.running)) {
+        uint64_t now = flipper_sim_now_ns();
+        flipper_sim_deliver(now);
+        flipper_sim_transmit(now);
+        flipper_sim_rate_timers(now);
+
+        /* Sleep until input arrives, the next byte finishes on either line or a switch times out */
+        uint64_t due = (sim_ctx.fallback_ns != 0) ? sim_ctx.fallback_ns : UINT64_MAX;
+        if (sim_ctx.to_sim.count > 0 && sim_ctx.to_sim.clock_ns < due) {
+            due = sim_ctx.to_sim.clock_ns;
+        }
+        if (sim_ctx.to_host.count > 0 && sim_ctx.to_host.clock_ns < due) {
+            due = sim_ctx.to_host.clock_ns;
+        }
+
+        struct timespec timeout;
+        struct timespec *timeout_ptr = NULL;
+        if (due != UINT64_MAX) {
+            uint64_t wait = (due > now) ? due - now : 0;
+            timeout.tv_sec = (time_t)(wait / 1000000000u);
+            timeout.tv_nsec = (long)(wait % 1000000000u);
+            timeout_ptr = &timeout;
+        }
+
+        struct pollfd fds[2] = {
+            { .fd = sim_ctx.master_fd, .events = (flipper_sim_wire_space(&sim_ctx.to_sim) > 0) ? POLLIN : 0 },
+            { .fd = sim_ctx.wake_fd, .events = POLLIN },
+        };
+        if (ppoll(fds, 2, timeout_ptr, NULL) < 0 && errno != EINTR) {
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint32_t space = flipper_sim_wire_space(&sim_ctx.to_sim);
+            ssize_t n = read(sim_ctx.master_fd, chunk, (space < sizeof(chunk)) ? space : sizeof(chunk));
+            uint64_t arrived = flipper_sim_now_ns();
+            if (n > 0 && flipper_sim_rates_match(arrived)) {
+                flipper_sim_wire_push(&sim_ctx.to_sim, chunk, (uint32_t)n, arrived);
+            } else if (n > 0) {
+                flipper_sim_count_misclocked((uint32_t)n);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* ===== PUBLIC IMPLEMENTATION ===== */
+
+void flipper_sim_default_config(flipper_sim_config_t *config)
+{
+    if (config == NULL) {
+        return;
+    }
+
+    config->baud_rate = UART1_BAUD_RATE;
+    config->max_baud = 0;
+    config->loss_rate = 0.0;
+    config->corrupt_rate = 0.0;
+    config->version = FLIPPER_PROTO_VERSION;
+    config->caps = FLIPPER_CAPS;
+    config->seed = 1;
+}
+
+hal_status_t flipper_sim_start(const flipper_sim_config_t *config, char *slave_path, uint32_t path_size)
+{
+    if (config == NULL || slave_path == NULL || path_size == 0) {
+        return HAL_INVALID_PARAM;
+    }
+
+    if (atomic_load(&sim_ctx.running)) {
+        return HAL_BUSY;
+    }
+
+    sim_ctx.master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (sim_ctx.master_fd < 0 || grantpt(sim_ctx.master_fd) != 0 || unlockpt(sim_ctx.master_fd) != 0 ||
+        ptsname_r(sim_ctx.master_fd, slave_path, path_size) != 0) {
+        goto fail;
+    }
+
+    /* Raw from the start, so nothing is echoed before uart_init() configures it */
+    sim_ctx.slave_fd = open(slave_path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (sim_ctx.slave_fd < 0) {
+        goto fail;
+    }
+    struct termios tty;
+    if (tcgetattr(sim_ctx.slave_fd, &tty) != 0) {
+        goto fail;
+    }
+    cfmakeraw(&tty);
+    tcsetattr(sim_ctx.slave_fd, TCSANOW, &tty);
+
+    sim_ctx.wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (sim_ctx.wake_fd < 0) {
+        goto fail;
+    }
+
+    sim_ctx.config = *config;
+    sim_ctx.version = FLIPPER_PROTO_V1;
+    sim_ctx.impaired = 0;
+    sim_ctx.rng = config->seed ? config->seed : 1;
+    memset(&sim_ctx.to_sim, 0, sizeof(sim_ctx.to_sim));
+    memset(&sim_ctx.to_host, 0, sizeof(sim_ctx.to_host));
+    memset(&sim_ctx.stats, 0, sizeof(sim_ctx.stats));
+    sim_ctx.noise_above_baud = 0;
+    sim_ctx.noise_rate = 0.0;
+    sim_ctx.rate_locked = false;
+    sim_ctx.committed_baud = UART1_BAUD_RATE;
+    sim_ctx.switch_baud = 0;
+    sim_ctx.fallback_ns = 0;
+    sim_ctx.host_baud = 0;
+    sim_ctx.host_prev_baud = 0;
+    sim_ctx.host_changed_ns = 0;
+    flipper_sim_retune(UART1_BAUD_RATE);
+    flipper_parser_init(&sim_ctx.parser);
+
+    atomic_store(&sim_ctx.running, true);
+    if (pthread_create(&sim_ctx.thread, NULL, flipper_sim_thread, NULL) != 0) {
+        atomic_store(&sim_ctx.running, false);
+        goto fail;
+    }
+    return HAL_OK;
+
+fail:
+    if (sim_ctx.wake_fd >= 0) {
+        close(sim_ctx.wake_fd);
+        sim_ctx.wake_fd = -1;
+    }
+    if (sim_ctx.slave_fd >= 0) {
+        close(sim_ctx.slave_fd);
+        sim_ctx.slave_fd = -1;
+    }
+    if (sim_ctx.master_fd >= 0) {
+        close(sim_ctx.master_fd);
+        sim_ctx.master_fd = -1;
+    }
+    return HAL_ERROR;
+}
+
+hal_status_t flipper_sim_stop(void)
+{
+    if (!atomic_load(&sim_ctx.running)) {
+        return HAL_OK;
+    }
+
+    atomic_store(&sim_ctx.running, false);
+    uint64_t one = 1;
+    if (write(sim_ctx.wake_fd, &one, sizeof(one)) < 0) {
+        /* Reader still sees running == false on its next wakeup */
+    }
+    pthread_join(sim_ctx.thread, NULL);
+
+    flipper_parser_init(&sim_ctx.parser);   /* Returns queued frames to the pool */
+    close(sim_ctx.wake_fd);
+    close(sim_ctx.slave_fd);
+    close(sim_ctx.master_fd);
+    sim_ctx.wake_fd = -1;
+    sim_ctx.slave_fd = -1;
+    sim_ctx.master_fd = -1;
+    return HAL_OK;
+}
+
+void flipper_sim_set_noise(uint32_t above_baud, double corrupt_rate)
+{
+    pthread_mutex_lock(&sim_ctx.lock);
+    sim_ctx.noise_above_baud = above_baud;
+    sim_ctx.noise_rate = corrupt_rate;
+    pthread_mutex_unlock(&sim_ctx.lock);
+}
+
+void flipper_sim_lock_rate(bool locked)
+{
+    pthread_mutex_lock(&sim_ctx.lock);
+    sim_ctx.rate_locked = locked;
+    pthread_mutex_unlock(&sim_ctx.lock);
+}
+
+void flipper_sim_get_stats(flipper_sim_stats_t *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&sim_ctx.lock);
+    *stats = sim_ctx.stats;
+    pthread_mutex_unlock(&sim_ctx.lock);
+}
@@ -0,0 +1,93 @@
+#ifndef FLIPPER_SIM_H
+#define FLIPPER_SIM_H
+
+/**
+ * Flipper Zero stand-in on a pseudo-terminal
+ *
+ * Runs the far end of the Flipper link on a thread attached to the
+ * master side of a pty pair, so the real driver stack (uart.c,
+ * flipper_uart.c) can be exercised on any Linux box by pointing UART1 at
+ * the slave side with uart_set_device_path().
+ *
+ * The simulator answers HELLO like a firmware peer, ACKs STATE_UPDATE,
+ * SEND_DATA and CONTROL frames (echoing the correlation ID on v3 links),
+ * answers REQUEST_STATE with a STATE_UPDATE and echoes LINK_TEST.
+ *
+ * With max_baud set it also takes rate changes the way the firmware does:
+ * SET_BAUD is echoed at the old rate before switching, a second SET_BAUD
+ * at the new rate commits it, and without one the simulator reverts after
+ * FLIPPER_BAUD_FALLBACK_MS. GOODBYE returns it to UART1_BAUD_RATE and v1
+ * framing. The host's rate is read back from the pty, and bytes sent while
+ * the two ends disagree are lost.
+ *
+ * Both directions are paced at the emulated line rate and, once the
+ * handshake is over, impaired by per-byte loss and corruption drawn from
+ * a seeded generator, so runs are repeatable.
+ */
+
+#include "types.h"
+
+typedef struct {
+    uint32_t baud_rate;         /* Pace at UART1_BAUD_RATE (0 = unpaced); SET_BAUD rates pace as agreed */
+    uint32_t max_baud;          /* Highest rate offered in HELLO, 0 = no rate changes */
+    double loss_rate;           /* Probability a byte is dropped */
+    double corrupt_rate;        /* Probability a byte gets one bit flipped */
+    uint8_t version;            /* Highest FLIPPER_PROTO_Vx offered in HELLO */
+    uint8_t caps;               /* FLIPPER_CAP_x offered in HELLO */
+    uint32_t seed;              /* Impairment generator seed */
+} flipper_sim_config_t;
+
+typedef struct {
+    uint32_t frames_rx;         /* Valid frames from the host */
+    uint32_t frames_tx;         /* Frames sent to the host */
+    uint32_t bytes_dropped;     /* Bytes lost to loss_rate, both directions */
+    uint32_t bytes_corrupted;   /* Bytes damaged by corrupt_rate, both directions */
+    uint32_t bad_frames;        /* Host frames rejected by the simulator's parser */
+    uint32_t bytes_misclocked;  /* Bytes lost to a host/simulator rate mismatch, both directions */
+    uint32_t baud_rate;         /* Simulator's current line rate */
+    uint32_t rate_changes;      /* SET_BAUD switches committed */
+    uint32_t fallbacks;         /* Uncommitted switches reverted */
+    uint32_t goodbyes;          /* GOODBYE frames from the host */
+} flipper_sim_stats_t;
+
+/**
+ * Get the default configuration (UART1_BAUD_RATE, no impairments)
+ * @param[out] config Configuration to fill in
+ */
+void flipper_sim_default_config(flipper_sim_config_t *config);
+
+/**
+ * Open a pty pair and start the simulator on its master side
+ * @param[in] config Simulator configuration
+ * @param[out] slave_path Receives the slave device path for uart_set_device_path()
+ * @param[in] path_size Size of slave_path
+ * @return HAL_OK on success
+ */
+hal_status_t flipper_sim_start(const flipper_sim_config_t *config, char *slave_path, uint32_t path_size);
+
+/**
+ * Stop the simulator and close the pty
+ * @return HAL_OK on success
+ */
+hal_status_t flipper_sim_stop(void);
+
+/**
+ * Add line noise above a rate, as a marginal cable would
+ * @param[in] above_baud Rates above this get the extra corruption
+ * @param[in] corrupt_rate Extra probability a byte gets one bit flipped (0 for none)
+ */
+void flipper_sim_set_noise(uint32_t above_baud, double corrupt_rate);
+
+/**
+ * Ignore SET_BAUD, as firmware that cannot retune would
+ * @param[in] locked true to ignore rate changes, false to take them again
+ */
+void flipper_sim_lock_rate(bool locked);
+
+/**
+ * Get simulator counters
+ * @param[out] stats Receives a snapshot
+ */
+void flipper_sim_get_stats(flipper_sim_stats_t *stats);
+
+#endif /* FLIPPER_SIM_H */
@@ -0,0 +1,338 @@
+/**
+ * @file log_decode.c
+ * @brief Turn a binary log stream (log_set_binary()) back into text
+ *
+ * Output matches the logger's text sink:
+ *   [sec.usec] LEVEL file:line func(): message
+ *
+ * Usage: log_decode [file]      (reads stdin without a file)
+ */
+
+#include "log_binary.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DECODE_MAX_SITES    65536
+#define DECODE_TEXT_MAX     4096
+
+typedef struct {
+    char *file;
+    char *func;
+    char *fmt;
+    uint32_t line;
+    uint8_t level;
+} decode_site_t;
+
+static const char *const decode_level_names[] = {
+    "CRIT", "ERROR", "WARN", "INFO", "DEBUG",
+};
+
+static decode_site_t *decode_sites[DECODE_MAX_SITES];
+static unsigned int decode_long_size = sizeof(long);
+static unsigned int decode_size_size = sizeof(size_t);
+
+static uint16_t decode_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t decode_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t decode_u64(const uint8_t *p)
+{
+    return (uint64_t)decode_u32(p) | ((uint64_t)decode_u32(p + 4) << 32);
+}
+
+static const char *decode_level(uint8_t level)
+{
+    return (level < sizeof(decode_level_names) / sizeof(decode_level_names[0])) ? decode_level_names[level] : "?";
+}
+
+static const char *decode_basename(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    return (slash != NULL) ? slash + 1 : path;
+}
+
+static void decode_print(uint8_t level, uint64_t timestamp_us, const char *file, uint32_t line,
+                         const char *func, const char *text, size_t length)
+{
+    printf("[%5llu.%06llu] %-5s %s:%u %s(): %.*s\n",
+           (unsigned long long)(timestamp_us / 1000000u), (unsigned long long)(timestamp_us % 1000000u),
+           decode_level(level), decode_basename(file), line, func, (int)length, text);
+}
+
+/**
+ * Read NUL-terminated strings from a record body
+ * @return Pointer past the terminator, or NULL if the body ends first
+ */
+static const uint8_t *decode_string(const uint8_t *p, const uint8_t *end, const char **out)
+{
+    const uint8_t *nul = memchr(p, '\0', (size_t)(end - p));
+    if (nul == NULL) {
+        return NULL;
+    }
+    *out = (const char *)p;
+    return nul + 1;
+}
+
+/* Sign-extend a value the target stored from a type of the given width */
+static int64_t decode_signed(uint64_t value, unsigned int size)
+{
+    if (size >= 8) {
+        return (int64_t)value;
+    }
+    unsigned int shift = 64 - 8 * size;
+    return (int64_t)(value << shift) >> shift;
+}
+
+/**
+ * Format one conversion with its stored value
+ * @return Characters written to out, or -1 on a truncated record
+ */
+static int decode_conversion(char *out, size_t size, const char *spec, size_t spec_length,
+                             const uint8_t *types, int count, const uint8_t **args, const uint8_t *end)
+{
+    char conversion[32];
+    if (spec_length >= sizeof(conversion)) {
+        return -1;
+    }
+    memcpy(conversion, spec, spec_length);
+    conversion[spec_length] = '\0';
+
+    char last = conversion[spec_length - 1];
+    bool is_signed = (last == 'd' || last == 'i');
+
+    /* Leading '*' arguments are ints */
+    int stars[2] = { 0, 0 };
+    int nstars = count - 1;
+    for (int i = 0; i < nstars; i++) {
+        if (*args + 4 > end) {
+            return -1;
+        }
+        stars[i] = (int)decode_u32(*args);
+        *args += 4;
+    }
+
+    uint8_t type = types[count - 1];
+    if (type == LOG_ARG_STR) {
+        if (*args + 2 > end) {
+            return -1;
+        }
+        uint16_t length = decode_u16(*args);
+        if (*args + 2 + length > end) {
+            return -1;
+        }
+        /* A crafted or corrupt record may claim more than a message can show */
+        char text[DECODE_TEXT_MAX];
+        size_t shown = (length < sizeof(text)) ? length : sizeof(text) - 1;
+        memcpy(text, *args + 2, shown);
+        text[shown] = '\0';
+        *args += 2 + length;
+
+        switch (nstars) {
+            case 0: return snprintf(out, size, conversion, text);
+            case 1: return snprintf(out, size, conversion, stars[0], text);
+            default: return snprintf(out, size, conversion, stars[0], stars[1], text);
+        }
+    }
+
+    unsigned int width = (type == LOG_ARG_INT) ? 4 : 8;
+    if (*args + width > end) {
+        return -1;
+    }
+    uint64_t raw = (width == 4) ? decode_u32(*args) : decode_u64(*args);
+    *args += width;
+
+/* Expand snprintf for the number of '*' arguments */
+#define DECODE_PRINT(value) \
+    ((nstars == 0) ? snprintf(out, size, conversion, value) : \
+     (nstars == 1) ? snprintf(out, size, conversion, stars[0], value) : \
+                     snprintf(out, size, conversion, stars[0], stars[1], value))
+
+    switch (type) {
+        case LOG_ARG_INT:
+            return DECODE_PRINT((int)(uint32_t)raw);
+        case LOG_ARG_LONG:
+            return DECODE_PRINT(is_signed ? (long)decode_signed(raw, decode_long_size)
+                                          : (long)(unsigned long)raw);
+        case LOG_ARG_LLONG:
+            return DECODE_PRINT((long long)raw);
+        case LOG_ARG_SIZE:
+            return DECODE_PRINT(is_signed ? (size_t)decode_signed(raw, decode_size_size) : (size_t)raw);
+        case LOG_ARG_DOUBLE: {
+            double d;
+            memcpy(&d, &raw, sizeof(d));
+            return DECODE_PRINT(d);
+        }
+        case LOG_ARG_PTR:
+            return DECODE_PRINT((void *)(uintptr_t)raw);
+        default:
+            return -1;
+    }
+#undef DECODE_PRINT
+}
+
+/**
+ * Rebuild a message from its site format and stored arguments
+ */
+static void decode_message(const decode_site_t *site, const uint8_t *args, const uint8_t *end, uint64_t timestamp_us)
+{
+    char text[DECODE_TEXT_MAX];
+    size_t used = 0;
+    const char *p = site->fmt;
+
+    while (*p != '\0' && used < sizeof(text) - 1) {
+        if (*p != '%') {
+            text[used++] = *p++;
+            continue;
+        }
+
+        uint8_t types[3];
+        int count;
+        int precision;      /* Already applied when the string was stored */
+        const char *next = log_format_conversion(p, types, &count, &precision);
+        if (next == NULL) {
+            break;
+        }
+
+        if (count == 0) {
+            text[used++] = '%';     /* %% */
+        } else {
+            int written = decode_conversion(&text[used], sizeof(text) - used, p, (size_t)(next - p),
+                                            types, count, &args, end);
+            if (written < 0) {
+                used += (size_t)snprintf(&text[used], sizeof(text) - used, "<truncated record>");
+                break;
+            }
+            used += ((size_t)written < sizeof(text) - used) ? (size_t)written : sizeof(text) - used - 1;
+        }
+        p = next;
+    }
+
+    decode_print(site->level, timestamp_us, site->file, site->line, site->func, text, used);
+}
+
+static char *decode_strdup(const char *s)
+{
+    size_t length = strlen(s) + 1;
+    char *copy = malloc(length);
+    if (copy != NULL) {
+        memcpy(copy, s, length);
+    }
+    return copy;
+}
+
+static bool decode_record(uint8_t type, const uint8_t *body, size_t length)
+{
+    const uint8_t *end = body + length;
+
+    switch (type) {
+        case LOG_REC_SITE: {
+            if (length < 7) {
+                return false;
+            }
+            uint16_t id = decode_u16(body);
+            decode_site_t *site = calloc(1, sizeof(*site));
+            const char *file, *func, *fmt;
+            const uint8_t *p = body + 7;
+            if (site == NULL || (p = decode_string(p, end, &file)) == NULL ||
+                (p = decode_string(p, end, &func)) == NULL || decode_string(p, end, &fmt) == NULL) {
+                free(site);
+                return false;
+            }
+            site->level = body[2];
+            site->line = decode_u32(body + 3);
+            site->file = decode_strdup(file);
+            site->func = decode_strdup(func);
+            site->fmt = decode_strdup(fmt);
+
+            if (decode_sites[id] != NULL) {
+                /* A new stream segment may re-describe the site */
+                free(decode_sites[id]->file);
+                free(decode_sites[id]->func);
+                free(decode_sites[id]->fmt);
+                free(decode_sites[id]);
+            }
+            decode_sites[id] = site;
+            return true;
+        }
+
+        case LOG_REC_MESSAGE: {
+            if (length < 10) {
+                return false;
+            }
+            uint16_t id = decode_u16(body);
+            if (decode_sites[id] == NULL) {
+                fprintf(stderr, "log_decode: message for undescribed site %u\n", id);
+                return true;
+            }
+            decode_message(decode_sites[id], body + 10, end, decode_u64(body + 2));
+            return true;
+        }
+
+        case LOG_REC_TEXT: {
+            if (length < 13) {
+                return false;
+            }
+            const char *file, *func;
+            const uint8_t *p = body + 13;
+            if ((p = decode_string(p, end, &file)) == NULL || (p = decode_string(p, end, &func)) == NULL) {
+                return false;
+            }
+            decode_print(body[0], decode_u64(body + 1), file, decode_u32(body + 9), func,
+                         (const char *)p, (size_t)(end - p));
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 2 || (argc == 2 && strcmp(argv[1], "-h") == 0)) {
+        fprintf(stderr, "usage: %s [binary log]\n", argv[0]);
+        return 2;
+    }
+
+    FILE *in = (argc == 2) ? fopen(argv[1], "rb") : stdin;
+    if (in == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    uint8_t header[LOG_BINARY_MAGIC_SIZE + 2];
+    if (fread(header, 1, sizeof(header), in) != sizeof(header) ||
+        memcmp(header, LOG_BINARY_MAGIC, LOG_BINARY_MAGIC_SIZE) != 0) {
+        fprintf(stderr, "log_decode: not a binary log\n");
+        return 1;
+    }
+    decode_long_size = header[LOG_BINARY_MAGIC_SIZE];
+    decode_size_size = header[LOG_BINARY_MAGIC_SIZE + 1];
+
+    static uint8_t body[UINT16_MAX];
+    uint8_t record[LOG_RECORD_HEADER_SIZE];
+    uint64_t records = 0;
+
+    while (fread(record, 1, sizeof(record), in) == sizeof(record)) {
+        uint16_t length = decode_u16(&record[1]);
+        if (fread(body, 1, length, in) != length) {
+            fprintf(stderr, "log_decode: stream ends inside record %llu\n", (unsigned long long)records);
+            break;
+        }
+        if (!decode_record(record[0], body, length)) {
+            fprintf(stderr, "log_decode: bad record %llu (type 0x%02X), stopping\n",
+                    (unsigned long long)records, record[0]);
+            return 1;
+        }
+        records++;
+    }
+    return 0;
+}
@@ -0,0 +1,668 @@
+/**
+ * @file uart.c
+ * @brief UART Hardware Abstraction Layer Implementation
+ * Orange Pi Zero 2W - termios backend with epoll reader thread
+ */
+
+#define LOG_MODULE LOG_MODULE_UART
+
+#include "uart.h"
+#include "config.h"
+#include "log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#if (UART1_RX_BUFFER_SIZE & (UART1_RX_BUFFER_SIZE - 1)) != 0
+#error "UART1_RX_BUFFER_SIZE must be a power of two"
+#endif
+
+#define UART_RX_MASK        (UART1_RX_BUFFER_SIZE - 1)
+#define UART_READ_CHUNK     512     /* Bytes pulled from the tty per read() */
+
+/* ===== UART STATE ===== */
+typedef struct {
+    uint8_t initialized;
+    char device_path[64];           /* Opened by uart_init() */
+    int fd;                         /* tty, O_NONBLOCK */
+    int epoll_fd;
+    int wake_fd;                    /* eventfd used to stop the reader */
+    pthread_t reader;
+    atomic_bool running;
+    atomic_bool line_down;          /* tty hung up or failed: out of epoll, reader parked */
+
+    /* SPSC ring: the reader thread owns head, receivers own tail */
+    uint8_t rx_buf[UART1_RX_BUFFER_SIZE];
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+
+    /* Slow path only: used when a side has to sleep */
+    pthread_mutex_t lock;
+    pthread_cond_t data_ready;
+    pthread_cond_t space_ready;
+    atomic_int rx_waiters;          /* Receivers sleeping on data_ready */
+    atomic_bool reader_stalled;     /* Reader sleeping on space_ready */
+
+    _Atomic(uart_rx_callback_t) rx_callback;
+    _Atomic(uart_rx_notify_t) rx_notify;
+    void *_Atomic rx_notify_context;
+} uart_context_t;
+
+static uart_context_t uart_ctx = {
+    .initialized = 0,
+    .device_path = UART1_DEVICE_PATH,
+    .fd = -1,
+    .epoll_fd = -1,
+    .wake_fd = -1,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .data_ready = PTHREAD_COND_INITIALIZER,
+    .space_ready = PTHREAD_COND_INITIALIZER,
+};
+
+/* ===== LOCAL HELPER FUNCTIONS ===== */
+
+/**
+ * Map a numeric baud rate to its termios constant
+ */
+static speed_t uart_baud_to_speed(uint32_t baud_rate)
+{
+    switch (baud_rate) {
+        case 9600:    return B9600;
+        case 19200:   return B19200;
+        case 38400:   return B38400;
+        case 57600:   return B57600;
+        case 115200:  return B115200;
+        case 230400:  return B230400;
+        case 460800:  return B460800;
+        case 921600:  return B921600;
+        case 1000000: return B1000000;
+        case 1500000: return B1500000;
+        case 2000000: return B2000000;
+        case 3000000: return B3000000;
+        default:      return 0;
+    }
+}
+
+static hal_status_t uart_apply_config(int fd, const uart_config_t *config)
+{
+    speed_t speed = uart_baud_to_speed(config->baud_rate);
+    if (speed == 0) {
+        return HAL_INVALID_PARAM;
+    }
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        return HAL_ERROR;
+    }
+
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+
+    tio.c_cflag &= ~CSIZE;
+    switch (config->data_bits) {
+        case UART_DATA_BITS_5: tio.c_cflag |= CS5; break;
+        case UART_DATA_BITS_6: tio.c_cflag |= CS6; break;
+        case UART_DATA_BITS_7: tio.c_cflag |= CS7; break;
+        case UART_DATA_BITS_8: tio.c_cflag |= CS8; break;
+        default: return HAL_INVALID_PARAM;
+    }
+
+    if (config->stop_bits == UART_STOP_BITS_2) {
+        tio.c_cflag |= CSTOPB;
+    } else {
+        tio.c_cflag &= ~CSTOPB;
+    }
+
+    tio.c_cflag &= ~(PARENB | PARODD);
+    if (config->parity == UART_PARITY_EVEN) {
+        tio.c_cflag |= PARENB;
+    } else if (config->parity == UART_PARITY_ODD) {
+        tio.c_cflag |= PARENB | PARODD;
+    }
+
+    /* Reads never block in the kernel; epoll decides when to read */
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        return HAL_ERROR;
+    }
+
+    tcflush(fd, TCIOFLUSH);
+    return HAL_OK;
+}
+
+static uint32_t uart_rx_count(void)
+{
+    uint32_t head = atomic_load_explicit(&uart_ctx.head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&uart_ctx.tail, memory_order_relaxed);
+    return head - tail;
+}
+
+/**
+ * Absolute CLOCK_MONOTONIC deadline for pthread_cond_timedwait
+ */
+static void uart_deadline(struct timespec *deadline, uint32_t timeout_ms)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += timeout_ms / 1000;
+    deadline->tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/**
+ * Publish bytes to the ring (reader thread only)
+ *
+ * Blocks while the ring is full instead of dropping: the kernel tty buffer
+ * absorbs the input until a receiver catches up.
+ */
+static void uart_rx_push(const uint8_t *data, uint32_t length)
+{
+    uint32_t head = atomic_load_explicit(&uart_ctx.head, memory_order_relaxed);
+
+    while (length > 0) {
+        uint32_t tail = atomic_load_explicit(&uart_ctx.tail, memory_order_acquire);
+        uint32_t space = UART1_RX_BUFFER_SIZE - (head - tail);
+
+        if (space == 0) {
+            pthread_mutex_lock(&uart_ctx.lock);
+            atomic_store(&uart_ctx.reader_stalled, true);
+            while (atomic_load(&uart_ctx.running) &&
+                   atomic_load(&uart_ctx.tail) == tail) {
+                pthread_cond_wait(&uart_ctx.space_ready, &uart_ctx.lock);
+            }
+            atomic_store(&uart_ctx.reader_stalled, false);
+            pthread_mutex_unlock(&uart_ctx.lock);
+            if (!atomic_load(&uart_ctx.running)) {
+                return;
+            }
+            continue;
+        }
+
+        uint32_t n = (length < space) ? length : space;
+        uint32_t offset = head & UART_RX_MASK;
+        uint32_t first = UART1_RX_BUFFER_SIZE - offset;
+        if (first > n) {
+            first = n;
+        }
+        memcpy(&uart_ctx.rx_buf[offset], data, first);
+        memcpy(uart_ctx.rx_buf, data + first, n - first);
+
+        head += n;
+        data += n;
+        length -= n;
+        atomic_store_explicit(&uart_ctx.head, head, memory_order_seq_cst);
+
+        /* Only pay for the mutex when someone is actually asleep */
+        if (atomic_load(&uart_ctx.rx_waiters) > 0) {
+            pthread_mutex_lock(&uart_ctx.lock);
+            pthread_cond_broadcast(&uart_ctx.data_ready);
+            pthread_mutex_unlock(&uart_ctx.lock);
+        }
+    }
+}
+
+/**
+ * Consume bytes from the ring (receiver side)
+ */
+static uint32_t uart_rx_pop(uint8_t *data, uint32_t max_length)
+{
+    uint32_t tail = atomic_load_explicit(&uart_ctx.tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&uart_ctx.head, memory_order_acquire);
+    uint32_t n = head - tail;
+    if (n > max_length) {
+        n = max_length;
+    }
+    if (n == 0) {
+        return 0;
+    }
+
+    uint32_t offset = tail & UART_RX_MASK;
+    uint32_t first = UART1_RX_BUFFER_SIZE - offset;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(data, &uart_ctx.rx_buf[offset], first);
+    memcpy(data + first, uart_ctx.rx_buf, n - first);
+
+    atomic_store_explicit(&uart_ctx.tail, tail + n, memory_order_seq_cst);
+
+    if (atomic_load(&uart_ctx.reader_stalled)) {
+        pthread_mutex_lock(&uart_ctx.lock);
+        pthread_cond_signal(&uart_ctx.space_ready);
+        pthread_mutex_unlock(&uart_ctx.lock);
+    }
+
+    return n;
+}
+
+/**
+ * Sleep until the ring holds at least one byte or the deadline passes
+ */
+static hal_status_t uart_rx_wait(const struct timespec *deadline)
+{
+    hal_status_t status = HAL_OK;
+
+    pthread_mutex_lock(&uart_ctx.lock);
+    atomic_fetch_add(&uart_ctx.rx_waiters, 1);
+    while (uart_rx_count() == 0 && atomic_load(&uart_ctx.running) && !atomic_load(&uart_ctx.line_down)) {
+        int rc = (deadline != NULL)
+            ? pthread_cond_timedwait(&uart_ctx.data_ready, &uart_ctx.lock, deadline)
+            : pthread_cond_wait(&uart_ctx.data_ready, &uart_ctx.lock);
+        if (rc == ETIMEDOUT) {
+            status = (uart_rx_count() > 0) ? HAL_OK : HAL_TIMEOUT;
+            break;
+        }
+    }
+    atomic_fetch_sub(&uart_ctx.rx_waiters, 1);
+    pthread_mutex_unlock(&uart_ctx.lock);
+
+    if (status == HAL_OK && uart_rx_count() == 0) {
+        /* Line dropped, or port shut down while waiting */
+        status = atomic_load(&uart_ctx.line_down) ? HAL_ERROR : HAL_NOT_READY;
+    }
+    return status;
+}
+
+/**
+ * Stop watching a tty that hung up or failed (reader thread)
+ *
+ * Level-triggered epoll would report it on every wait; with the tty out
+ * of the set the reader sleeps until uart_deinit() wakes it, and
+ * receivers with nothing left to read get HAL_ERROR.
+ */
+static void uart_line_down(int error)
+{
+    epoll_ctl(uart_ctx.epoll_fd, EPOLL_CTL_DEL, uart_ctx.fd, NULL);
+    LOG_ERROR("UART %s lost: %s", uart_ctx.device_path, error ? strerror(error) : "hangup");
+
+    pthread_mutex_lock(&uart_ctx.lock);
+    atomic_store(&uart_ctx.line_down, true);
+    pthread_cond_broadcast(&uart_ctx.data_ready);
+    pthread_mutex_unlock(&uart_ctx.lock);
+}
+
+/**
+ * Reader thread: block in epoll, move tty input into the ring
+ */
+static void *uart_reader_thread(void *arg)
+{
+    (void)arg;
+    uint8_t chunk[UART_READ_CHUNK];
+
+    while (atomic_load(&uart_ctx.running)) {
+        struct epoll_event events[2];
+        int n = epoll_wait(uart_ctx.epoll_fd, events, 2, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("UART epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == uart_ctx.wake_fd) {
+                continue;  /* Shutdown request; loop condition handles it */
+            }
+
+            /* Whatever arrived before a hangup is still read out first */
+            bool failed = (events[i].events & (EPOLLHUP | EPOLLERR)) != 0;
+            int error = 0;
+            for (;;) {
+                ssize_t got = read(uart_ctx.fd, chunk, sizeof(chunk));
+                if (got < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (got < 0 && errno != EAGAIN) {
+                    failed = true;
+                    error = errno;
+                    break;
+                }
+                if (got <= 0) {
+                    break;  /* Drained (VMIN 0 reads return 0 or EAGAIN) */
+                }
+
+                uart_rx_callback_t callback = atomic_load(&uart_ctx.rx_callback);
+                if (callback != NULL) {
+                    for (ssize_t j = 0; j < got; j++) {
+                        callback(chunk[j]);
+                    }
+                } else {
+                    uart_rx_push(chunk, (uint32_t)got);
+                }
+            }
+
+            if (failed) {
+                uart_line_down(error);
+            }
+
+            uart_rx_notify_t notify = atomic_load(&uart_ctx.rx_notify);
+            if (notify != NULL) {
+                notify(atomic_load(&uart_ctx.rx_notify_context));
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void uart_close_fds(void)
+{
+    if (uart_ctx.epoll_fd >= 0) {
+        close(uart_ctx.epoll_fd);
+        uart_ctx.epoll_fd = -1;
+    }
+    if (uart_ctx.wake_fd >= 0) {
+        close(uart_ctx.wake_fd);
+        uart_ctx.wake_fd = -1;
+    }
+    if (uart_ctx.fd >= 0) {
+        close(uart_ctx.fd);
+        uart_ctx.fd = -1;
+    }
+}
+
+/* ===== PUBLIC IMPLEMENTATION ===== */
+
+hal_status_t uart_init(uart_port_t port, const uart_config_t *config)
+{
+    if (port != UART_PORT_1 || config == NULL) {
+        return HAL_INVALID_PARAM;
+    }
+
+    if (uart_ctx.initialized) {
+        return HAL_OK;
+    }
+
+    uart_ctx.fd = open(uart_ctx.device_path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (uart_ctx.fd < 0) {
+        LOG_ERROR("Failed to open %s: %s", uart_ctx.device_path, strerror(errno));
+        return HAL_ERROR;
+    }
+
+    hal_status_t status = uart_apply_config(uart_ctx.fd, config);
+    if (status != HAL_OK) {
+        LOG_ERROR("Failed to configure %s (%u baud)", uart_ctx.device_path, config->baud_rate);
+        uart_close_fds();
+        return status;
+    }
+
+    uart_ctx.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    uart_ctx.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (uart_ctx.wake_fd < 0 || uart_ctx.epoll_fd < 0) {
+        uart_close_fds();
+        return HAL_ERROR;
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN };
+    ev.data.fd = uart_ctx.fd;
+    epoll_ctl(uart_ctx.epoll_fd, EPOLL_CTL_ADD, uart_ctx.fd, &ev);
+    ev.data.fd = uart_ctx.wake_fd;
+    epoll_ctl(uart_ctx.epoll_fd, EPOLL_CTL_ADD, uart_ctx.wake_fd, &ev);
+
+    /* Timed receives measure against CLOCK_MONOTONIC */
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&uart_ctx.data_ready, &attr);
+    pthread_condattr_destroy(&attr);
+
+    atomic_store(&uart_ctx.head, 0);
+    atomic_store(&uart_ctx.tail, 0);
+    atomic_store(&uart_ctx.line_down, false);
+    atomic_store(&uart_ctx.running, true);
+
+    if (pthread_create(&uart_ctx.reader, NULL, uart_reader_thread, NULL) != 0) {
+        atomic_store(&uart_ctx.running, false);
+        uart_close_fds();
+        return HAL_ERROR;
+    }
+
+    uart_ctx.initialized = 1;
+    LOG_INFO("UART%d ready on %s at %u baud", port, uart_ctx.device_path, config->baud_rate);
+    return HAL_OK;
+}
+
+hal_status_t uart_set_device_path(uart_port_t port, const char *path)
+{
+    if (port != UART_PORT_1 || path == NULL || strlen(path) >= sizeof(uart_ctx.device_path)) {
+        return HAL_INVALID_PARAM;
+    }
+
+    if (uart_ctx.initialized) {
+        return HAL_BUSY;
+    }
+
+    strcpy(uart_ctx.device_path, path);
+    return HAL_OK;
+}
+
+hal_status_t uart_send(uart_port_t port, const uint8_t *data, uint32_t length)
+{
+    if (port != UART_PORT_1 || data == NULL) {
+        return HAL_INVALID_PARAM;
+    }
+
+    if (!uart_ctx.initialized) {
+        return HAL_NOT_READY;
+    }
+
+    while (length > 0) {
+        ssize_t written = write(uart_ctx.fd, data, length);
+        if (written > 0) {
+            data += written;
+            length -= (uint32_t)written;
+            continue;
+        }
+
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0 && errno != EAGAIN) {
+            return HAL_ERROR;
+        }
+
+        /* Kernel TX buffer full: wait for room */
+        struct pollfd pfd = { .fd = uart_ctx.fd, .events = POLLOUT };
+        if (poll(&pfd, 1, 1000) == 0) {
+            return HAL_TIMEOUT;
+        }
+    }
+
+    return HAL_OK;
+}
+
+hal_status_t uart_send_byte(uart_port_t port, uint8_t byte)
+{
+    return uart_send(port, &byte, 1);
+}
+
+hal_status_t uart_receive(uart_port_t port, uint8_t *data, uint32_t length, uint32_t timeout_ms)
+{
+    if (port != UART_PORT_1 || data == NULL) {
+        return HAL_INVALID_PARAM;
+    }
+
+    if (!uart_ctx.initialized) {
+        return HAL_NOT_READY;
+    }
+
+    struct timespec deadline;
+    if (timeout_ms > 0) {
+        uart_deadline(&deadline, timeout_ms);
+    }
+
+    uint32_t received = 0;
+    while (received < length) {
+        received += uart_rx_pop(data + received, length - received);
+        if (received == length) {
+            break;
+        }
+
+        hal_status_t status = uart_rx_wait(timeout_ms > 0 ? &deadline : NULL);
+        if (status != HAL_OK) {
+            return status;
+        }
+    }
+
+    return HAL_OK;
+}
+
+hal_status_t uart_receive_byte(uart_port_t port, uint8_t *byte, uint32_t timeout_ms)
+{
+    return uart_receive(port, byte, 1, timeout_ms);
+}
+
+uint32_t uart_read(uart_port_t port, uint8_t *data, uint32_t max_length)
+{
+    if (port != UART_PORT_1 || data == NULL || !uart_ctx.initialized) {
+        return 0;
+    }
+
+    return uart_rx_pop(data, max_length);
+}
+
+hal_status_t uart_wait_available(uart_port_t port, uint32_t timeout_ms)
+{
+    if (port != UART_PORT_1) {
+        return HAL_INVALID_PARAM;
+    }
+
+    if (!uart_ctx.initialized) {
+        return HAL_NOT_READY;
+    }
+
+    if (uart_rx_count() > 0) {
+        return HAL_OK;
+    }
+
+    struct timespec deadline;
+    if (timeout_ms > 0) {
+        uart_deadline(&deadline, timeout_ms);
+    }
+    return uart_rx_wait(timeout_ms > 0 ? &deadline : NULL);
+}
+
+uint32_t uart_available(uart_port_t port)
+{
+    if (port != UART_PORT_1 || !uart_ctx.initialized) {
+        return 0;
+    }
+
+    return uart_rx_count();
+}
+
+hal_status_t uart_set_rx_callback(uart_port_t port, uart_rx_callback_t callback)
+{
+    if (port != UART_PORT_1) {
+        return HAL_INVALID_PARAM;
+    }
+
+    atomic_store(&uart_ctx.rx_callback, callback);
+    return HAL_OK;
+}
+
+hal_status_t uart_set_rx_notify(uart_port_t port, uart_rx_notify_t notify, void *context)
+{
+    if (port != UART_PORT_1) {
+        return HAL_INVALID_PARAM;
+    }
+
+    atomic_store(&uart_ctx.rx_notify_context, context);
+    atomic_store(&uart_ctx.rx_notify, notify);
+    return HAL_OK;
+}
+
+hal_status_t uart_set_baud_rate(uart_port_t port, uint32_t baud_rate)
+{
+    if (port != UART_PORT_1) {
+        return HAL_INVALID_PARAM;
+    }
+
+    speed_t speed = uart_baud_to_speed(baud_rate);
+    if (speed == 0) {
+        return HAL_INVALID_PARAM;
+    }
+
+    if (!uart_ctx.initialized) {
+        return HAL_NOT_READY;
+    }
+
+    struct termios tio;
+    if (tcdrain(uart_ctx.fd) != 0 || tcgetattr(uart_ctx.fd, &tio) != 0) {
+        return HAL_ERROR;
+    }
+
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(uart_ctx.fd, TCSADRAIN, &tio) != 0) {
+        return HAL_ERROR;
+    }
+
+    LOG_INFO("UART%d now at %u baud", port, baud_rate);
+    return HAL_OK;
+}
+
+hal_status_t uart_flush(uart_port_t port)
+{
+    if (port != UART_PORT_1) {
+        return HAL_INVALID_PARAM;
+    }
+
+    if (!uart_ctx.initialized) {
+        return HAL_NOT_READY;
+    }
+
+    tcflush(uart_ctx.fd, TCIFLUSH);
+
+    /* Receiver owns tail, so discarding is just catching up with head */
+    uint8_t discard[UART_READ_CHUNK];
+    while (uart_rx_pop(discard, sizeof(discard)) > 0) {
+    }
+
+    return HAL_OK;
+}
+
+hal_status_t uart_deinit(uart_port_t port)
+{
+    if (port != UART_PORT_1) {
+        return HAL_INVALID_PARAM;
+    }
+
+    if (!uart_ctx.initialized) {
+        return HAL_OK;
+    }
+
+    /* Stop the reader, including one parked on a full ring */
+    atomic_store(&uart_ctx.running, false);
+    uint64_t one = 1;
+    ssize_t ignored = write(uart_ctx.wake_fd, &one, sizeof(one));
+    (void)ignored;
+
+    pthread_mutex_lock(&uart_ctx.lock);
+    pthread_cond_broadcast(&uart_ctx.space_ready);
+    pthread_cond_broadcast(&uart_ctx.data_ready);
+    pthread_mutex_unlock(&uart_ctx.lock);
+
+    pthread_join(uart_ctx.reader, NULL);
+    pthread_cond_destroy(&uart_ctx.data_ready);
+
+    uart_close_fds();
+    uart_ctx.initialized = 0;
+    return HAL_OK;
+}
@@ -4,6 +4,10 @@
 /**
  * UART Hardware Abstraction Layer for Orange Pi Zero 2W
  * Supports UART1 for Flipper Zero communication
+ *
+ * A dedicated reader thread blocks in epoll on the tty and fills a
+ * lock-free single-producer/single-consumer ring buffer; the receive
+ * functions drain that ring without system calls when data is present.
  */
 
 #include "types.h"
@@ -17,17 +21,30 @@ typedef enum {
 /* ===== CALLBACKS ===== */
 typedef void (*uart_rx_callback_t)(uint8_t byte);
 typedef void (*uart_tx_complete_callback_t)(void);
+typedef void (*uart_rx_notify_t)(void *context);
 
 /* ===== PUBLIC API ===== */
 
 /**
- * Initialize UART port
+ * Initialize UART port and start its reader thread
  * @param[in] port UART port number
  * @param[in] config UART configuration
  * @return HAL_OK on success
  */
 hal_status_t uart_init(uart_port_t port, const uart_config_t *config);
 
+/**
+ * Open a different tty than UART1_DEVICE_PATH (before uart_init())
+ *
+ * Lets the stack run against a pseudo-terminal, e.g. the Flipper
+ * simulator in tools/.
+ *
+ * @param[in] port UART port number
+ * @param[in] path Device path (copied)
+ * @return HAL_OK on success, HAL_BUSY if the port is already open
+ */
+hal_status_t uart_set_device_path(uart_port_t port, const char *path);
+
 /**
  * Send data via UART (blocking)
  * @param[in] port UART port number
@@ -51,7 +68,7 @@ hal_status_t uart_send_byte(uart_port_t port, uint8_t byte);
  * @param[out] data Pointer to receive buffer
  * @param[in] length Number of bytes to receive
  * @param[in] timeout_ms Timeout in milliseconds (0 = wait forever)
- * @return HAL_OK on success, HAL_TIMEOUT if no data received
+ * @return HAL_OK on success, HAL_TIMEOUT if no data received, HAL_ERROR if the tty hung up
  */
 hal_status_t uart_receive(uart_port_t port, uint8_t *data, uint32_t length, uint32_t timeout_ms);
 
@@ -60,120 +77,72 @@ hal_status_t uart_receive(uart_port_t port, uint8_t *data, uint32_t length, uint
  * @param[in] port UART port number
  * @param[out] byte Pointer to receive byte
  * @param[in] timeout_ms Timeout in milliseconds
- * @return HAL_OK on success, HAL_TIMEOUT if no data received
+ * @return HAL_OK on success, HAL_TIMEOUT if no data received, HAL_ERROR if the tty hung up
  */
 hal_status_t uart_receive_byte(uart_port_t port, uint8_t *byte, uint32_t timeout_ms);
 
 /**
- * Get number of bytes available in receive buffer
- * @param[in] port UART port number
- * @return Number of bytes available
- */
-uint32_t uart_available(uart_port_t port);
-
-/**
- * Set receive callback for non-blocking operation
+ * Copy whatever is already buffered (never blocks)
  * @param[in] port UART port number
- * @param[in] callback Callback function pointer
- * @return HAL_OK on success
- */
-hal_status_t uart_set_rx_callback(uart_port_t port, uart_rx_callback_t callback);
-
-/**
- * Flush UART receive buffer
- * @param[in] port UART port number
- * @return HAL_OK on success
+ * @param[out] data Pointer to receive buffer
+ * @param[in] max_length Size of receive buffer
+ * @return Number of bytes copied
  */
-hal_status_t uart_flush(uart_port_t port);
+uint32_t uart_read(uart_port_t port, uint8_t *data, uint32_t max_length);
 
 /**
- * Deinitialize UART port
+ * Wait until at least one byte is buffered
  * @param[in] port UART port number
- * @return HAL_OK on success
+ * @param[in] timeout_ms Timeout in milliseconds (0 = wait forever)
+ * @return HAL_OK when data is available, HAL_TIMEOUT if none came, HAL_ERROR if the tty hung up
  */
-hal_status_t uart_deinit(uart_port_t port);
-
-#endif /* UART_H */
-#ifndef UART_H
-#define UART_H
+hal_status_t uart_wait_available(uart_port_t port, uint32_t timeout_ms);
 
 /**
- * UART Hardware Abstraction Layer for Orange Pi Zero 2W
- * Supports UART1 for Flipper Zero communication
- */
-
-#include "types.h"
-
-/* ===== UART DEFINITIONS ===== */
-typedef enum {
-    UART_PORT_1 = 1,  /* Flipper Zero communication */
-    UART_PORT_COUNT = 1,
-} uart_port_t;
-
-/* ===== CALLBACKS ===== */
-typedef void (*uart_rx_callback_t)(uint8_t byte);
-typedef void (*uart_tx_complete_callback_t)(void);
-
-/* ===== PUBLIC API ===== */
-
-/**
- * Initialize UART port
+ * Get number of bytes available in receive buffer
  * @param[in] port UART port number
- * @param[in] config UART configuration
- * @return HAL_OK on success
+ * @return Number of bytes available
  */
-hal_status_t uart_init(uart_port_t port, const uart_config_t *config);
+uint32_t uart_available(uart_port_t port);
 
 /**
- * Send data via UART (blocking)
+ * Set receive callback for non-blocking operation
+ *
+ * The callback runs on the reader thread. While one is registered,
+ * received bytes go to the callback instead of the receive buffer.
+ *
  * @param[in] port UART port number
- * @param[in] data Pointer to data buffer
- * @param[in] length Number of bytes to send
+ * @param[in] callback Callback function pointer (NULL to remove)
  * @return HAL_OK on success
  */
-hal_status_t uart_send(uart_port_t port, const uint8_t *data, uint32_t length);
+hal_status_t uart_set_rx_callback(uart_port_t port, uart_rx_callback_t callback);
 
 /**
- * Send single byte via UART (blocking)
+ * Register a wakeup hook for newly buffered data
+ *
+ * The hook runs on the reader thread after each batch of bytes lands in
+ * the receive buffer, so a consumer can react without polling. It may
+ * drain the buffer itself (uart_read()); it must not block for long.
+ *
  * @param[in] port UART port number
- * @param[in] byte Byte to send
+ * @param[in] notify Hook (NULL to remove)
+ * @param[in] context Passed to the hook
  * @return HAL_OK on success
  */
-hal_status_t uart_send_byte(uart_port_t port, uint8_t byte);
+hal_status_t uart_set_rx_notify(uart_port_t port, uart_rx_notify_t notify, void *context);
 
 /**
- * Receive data from UART (blocking with timeout)
+ * Change the line rate of an open port
+ *
+ * Waits for queued TX bytes to leave at the old rate first. Bytes that
+ * arrive while the rate changes are likely garbage; callers that switch
+ * in step with a peer should flush afterwards.
+ *
  * @param[in] port UART port number
- * @param[out] data Pointer to receive buffer
- * @param[in] length Number of bytes to receive
- * @param[in] timeout_ms Timeout in milliseconds (0 = wait forever)
- * @return HAL_OK on success, HAL_TIMEOUT if no data received
+ * @param[in] baud_rate New rate (9600 .. 3000000, standard values only)
+ * @return HAL_OK on success, HAL_INVALID_PARAM for unsupported rates
  */
-hal_status_t uart_receive(uart_port_t port, uint8_t *data, uint32_t length, uint32_t timeout_ms);
-
-/**
- * Receive single byte from UART (blocking with timeout)
- * @param[in] port UART port number
- * @param[out] byte Pointer to receive byte
- * @param[in] timeout_ms Timeout in milliseconds
- * @return HAL_OK on success, HAL_TIMEOUT if no data received
- */
-hal_status_t uart_receive_byte(uart_port_t port, uint8_t *byte, uint32_t timeout_ms);
-
-/**
- * Get number of bytes available in receive buffer
- * @param[in] port UART port number
- * @return Number of bytes available
- */
-uint32_t uart_available(uart_port_t port);
-
-/**
- * Set receive callback for non-blocking operation
- * @param[in] port UART port number
- * @param[in] callback Callback function pointer
- * @return HAL_OK on success
- */
-hal_status_t uart_set_rx_callback(uart_port_t port, uart_rx_callback_t callback);
+hal_status_t uart_set_baud_rate(uart_port_t port, uint32_t baud_rate);
 
 /**
  * Flush UART receive buffer